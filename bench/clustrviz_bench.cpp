@@ -0,0 +1,459 @@
+// Benchmarks for the clustRviz solvers
+//
+// Usage: clustrviz_bench [--quick] [--filter <benchmark>] [--output <file>]
+//
+// Times the hot spots of the solvers -- a single ADMM step, the row-wise prox
+// operators and cluster assignment -- along with full CARP and CBASS paths, over a
+// grid of synthetic workloads (see workloads.h), problem sizes, k-NN graph densities
+// and norms, and the construction of exact and approximate (NN-descent) k-NN graphs
+// and out-of-sample (nearest-centroid) assignment on larger inputs. Results are
+// written as JSON (to stdout unless --output is given) so that runs can be compared
+// automatically; progress is reported on stderr.
+//
+// Peak memory is the high-water mark of the process (getrusage), recorded after
+// each benchmark. Problem sizes are visited in increasing order, so this tracks the
+// peak of the largest problem solved so far.
+
+#include "clustRviz_core.h"
+#include "workloads.h"
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct BenchConfig {
+  std::string workload;
+  int n;
+  int p;
+  int k;   // Number of clusters in the workload
+  int knn; // Requested neighbors in the weight graph
+  bool l1;
+};
+
+struct BenchResult {
+  std::string benchmark;
+  BenchConfig config;
+  int knn_used;           // Neighbors actually used (increased if needed for a connected graph)
+  Eigen::Index num_edges;
+  int reps;
+  double seconds;         // Per repetition
+  double throughput;
+  std::string unit;
+  Eigen::Index path_length; // Stored iterates (path benchmarks only)
+  double recall;            // Estimated k-NN recall (approx_knn only, NaN otherwise)
+  double peak_rss_mb;
+};
+
+// Escape a string for use inside a JSON string literal
+static std::string json_escape(const std::string& str){
+  std::string result;
+  result.reserve(str.size());
+  for(std::size_t i = 0; i < str.size(); i++){
+    const char c = str[i];
+    switch(c){
+      case '"':  result += "\\\""; break;
+      case '\\': result += "\\\\"; break;
+      case '\n': result += "\\n"; break;
+      case '\r': result += "\\r"; break;
+      case '\t': result += "\\t"; break;
+      default:
+        if(static_cast<unsigned char>(c) < 0x20){
+          char escaped[8];
+          std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned int>(static_cast<unsigned char>(c)));
+          result += escaped;
+        } else {
+          result += c;
+        }
+    }
+  }
+  return result;
+}
+
+static double peak_rss_mb(){
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+  return usage.ru_maxrss / (1024.0 * 1024.0); // bytes
+#else
+  return usage.ru_maxrss / 1024.0;            // kilobytes
+#endif
+}
+
+// Run f repeatedly until at least min_time seconds have passed (or max_reps runs),
+// returning the average time per run
+template <typename F>
+static double time_reps(F f, double min_time, int max_reps, int& reps){
+  typedef std::chrono::steady_clock clock;
+
+  reps = 0;
+  const clock::time_point start = clock::now();
+  double elapsed = 0;
+  do {
+    f();
+    reps++;
+    elapsed = std::chrono::duration<double>(clock::now() - start).count();
+  } while((elapsed < min_time) && (reps < max_reps));
+
+  return elapsed / reps;
+}
+
+// k-NN RBF weights with (at least) knn neighbors: if that doesn't give a connected
+// graph, the smallest k that does is used instead
+static KNNWeightGraph bench_weight_graph(const Eigen::MatrixXd& X, int knn){
+  const int n = X.rows();
+  KNNWeightGraph graph = knn_rbf_graph(X, 0, 0); // Automatic k => smallest connected graph
+
+  if(knn > graph.k){
+    graph = knn_rbf_graph(X, std::min(knn, n - 1), 0);
+  }
+
+  return graph;
+}
+
+class BenchRunner {
+public:
+  BenchRunner(bool quick_, const std::string& filter_):
+  quick(quick_),
+  filter(filter_),
+  min_time(quick_ ? 0.01 : 0.25),
+  max_path_reps(quick_ ? 1 : 3) {}
+
+  // Failures (e.g., running out of memory on the largest problems) are recorded
+  // and the remaining configurations are still run
+  void run(const BenchConfig& config){
+    try {
+      run_config(config);
+    } catch(std::exception& e){
+      errors.push_back(std::make_pair(config, std::string(e.what())));
+      std::fprintf(stderr, "%-20s %-16s %s n = %4d p = %3d: failed (%s)\n",
+                   "", config.workload.c_str(), config.l1 ? "L1" : "L2", config.n, config.p, e.what());
+    }
+  }
+
+  void run_config(const BenchConfig& config){
+    const Eigen::MatrixXd X  = make_workload(config.workload, config.n, config.p, config.k, 1234);
+    const Eigen::ArrayXXd M  = Eigen::ArrayXXd::Ones(config.n, config.p);
+    const KNNWeightGraph row_graph = bench_weight_graph(X, config.knn);
+    const KNNWeightGraph col_graph = bench_weight_graph(X.transpose(), config.knn);
+
+    if(config.l1){
+      run_norm<L1Norm>(config, X, M, row_graph, col_graph);
+    } else {
+      run_norm<L2Norm>(config, X, M, row_graph, col_graph);
+    }
+  }
+
+  void write_json(std::ostream& out) const {
+    int threads = 1;
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+
+    out << "{\n";
+    out << "  \"suite\": \"clustrviz_bench\",\n";
+    out << "  \"quick\": " << (quick ? "true" : "false") << ",\n";
+    out << "  \"threads\": " << threads << ",\n";
+    out << "  \"results\": [";
+    for(std::size_t r = 0; r < results.size(); r++){
+      const BenchResult& result = results[r];
+      out << (r > 0 ? "," : "") << "\n    {";
+      out << "\"benchmark\": \"" << result.benchmark << "\", ";
+      out << "\"workload\": \"" << json_escape(result.config.workload) << "\", ";
+      out << "\"norm\": \"" << (result.config.l1 ? "L1" : "L2") << "\", ";
+      out << "\"n\": " << result.config.n << ", ";
+      out << "\"p\": " << result.config.p << ", ";
+      out << "\"clusters\": " << result.config.k << ", ";
+      out << "\"knn\": " << result.config.knn << ", ";
+      out << "\"knn_used\": " << result.knn_used << ", ";
+      out << "\"edges\": " << result.num_edges << ", ";
+      out << "\"reps\": " << result.reps << ", ";
+      out << "\"seconds\": " << result.seconds << ", ";
+      out << "\"throughput\": " << result.throughput << ", ";
+      out << "\"unit\": \"" << result.unit << "\", ";
+      out << "\"path_length\": " << result.path_length << ", ";
+      if(std::isnan(result.recall)){
+        out << "\"recall\": null, ";
+      } else {
+        out << "\"recall\": " << result.recall << ", ";
+      }
+      out << "\"peak_rss_mb\": " << result.peak_rss_mb << "}";
+    }
+    out << "\n  ],\n";
+    out << "  \"errors\": [";
+    for(std::size_t r = 0; r < errors.size(); r++){
+      const BenchConfig& config = errors[r].first;
+      out << (r > 0 ? "," : "") << "\n    {";
+      out << "\"workload\": \"" << json_escape(config.workload) << "\", ";
+      out << "\"norm\": \"" << (config.l1 ? "L1" : "L2") << "\", ";
+      out << "\"n\": " << config.n << ", ";
+      out << "\"p\": " << config.p << ", ";
+      out << "\"knn\": " << config.knn << ", ";
+      out << "\"error\": \"" << json_escape(errors[r].second) << "\"}";
+    }
+    out << "\n  ]\n}\n";
+  }
+
+  // Weight graph construction alone, on inputs too large for the solver benchmarks:
+  // the exact search (only up to max_exact_n rows) and NN-descent
+  void run_graph(const BenchConfig& config, int max_exact_n){
+    try {
+      const Eigen::MatrixXd X = make_workload(config.workload, config.n, config.p, config.k, 1234);
+      int reps;
+
+      if(selected("knn_graph") && (config.n <= max_exact_n)){
+        KNNWeightGraph graph;
+        const double seconds = time_reps([&](){ graph = knn_rbf_graph(X, config.knn, 0); },
+                                         min_time, max_path_reps, reps);
+        record("knn_graph", config, graph, reps, seconds, config.n, "rows/s");
+      }
+
+      if(selected("approx_knn")){
+        KNNWeightGraph graph;
+        ApproxKNNStats stats;
+        const double seconds = time_reps([&](){ graph = approx_knn_rbf_graph(X, config.knn, 0, 0.9, 50, 1234, &stats); },
+                                         min_time, max_path_reps, reps);
+        record("approx_knn", config, graph, reps, seconds, config.n, "rows/s", 0, stats.recall);
+      }
+    } catch(std::exception& e){
+      errors.push_back(std::make_pair(config, std::string(e.what())));
+      std::fprintf(stderr, "%-20s %-16s n = %4d p = %3d: failed (%s)\n",
+                   "", config.workload.c_str(), config.n, config.p, e.what());
+    }
+  }
+
+  // Out-of-sample assignment (predict): the rows of X are assigned to the nearest of
+  // n / PREDICT_ROWS_PER_CENTROID centroids (a subset of the rows), as for a partition
+  // part way along a CARP path; the index is built on each repetition
+  void run_predict(const BenchConfig& config){
+    static const int PREDICT_ROWS_PER_CENTROID = 20;
+
+    if(!selected("predict")){
+      return;
+    }
+
+    try {
+      const Eigen::MatrixXd X = make_workload(config.workload, config.n, config.p, config.k, 1234);
+      const Eigen::Index num_centroids = std::max(1, config.n / PREDICT_ROWS_PER_CENTROID);
+      Eigen::MatrixXd centroids(num_centroids, config.p);
+      for(Eigen::Index c = 0; c < num_centroids; c++){
+        centroids.row(c) = X.row(c * PREDICT_ROWS_PER_CENTROID);
+      }
+
+      Eigen::VectorXi cluster;
+      Eigen::VectorXd distance;
+      int reps;
+      const double seconds = time_reps([&](){
+        const CentroidIndex index(centroids);
+        index.assign(X, cluster, distance);
+      }, min_time, max_path_reps, reps);
+      record("predict", config, KNNWeightGraph(), reps, seconds, config.n, "rows/s");
+    } catch(std::exception& e){
+      errors.push_back(std::make_pair(config, std::string(e.what())));
+      std::fprintf(stderr, "%-20s %-16s n = %4d p = %3d: failed (%s)\n",
+                   "", config.workload.c_str(), config.n, config.p, e.what());
+    }
+  }
+
+  std::size_t num_results() const {
+    return results.size() + errors.size();
+  }
+
+  bool failed() const {
+    return !errors.empty();
+  }
+
+private:
+  const bool quick;
+  const std::string filter;
+  const double min_time;
+  const int max_path_reps;
+  std::vector<BenchResult> results;
+  std::vector<std::pair<BenchConfig, std::string> > errors;
+
+  bool selected(const std::string& benchmark) const {
+    return filter.empty() || (filter == benchmark);
+  }
+
+  void record(const std::string& benchmark,
+              const BenchConfig& config,
+              const KNNWeightGraph& graph,
+              int reps,
+              double seconds,
+              double work,
+              const std::string& unit,
+              Eigen::Index path_length = 0,
+              double recall = std::numeric_limits<double>::quiet_NaN()){
+    BenchResult result;
+    result.benchmark   = benchmark;
+    result.config      = config;
+    result.knn_used    = graph.k;
+    result.num_edges   = graph.edge_list.rows();
+    result.reps        = reps;
+    result.seconds     = seconds;
+    result.throughput  = work / seconds;
+    result.unit        = unit;
+    result.path_length = path_length;
+    result.recall      = recall;
+    result.peak_rss_mb = peak_rss_mb();
+    results.push_back(result);
+
+    std::fprintf(stderr, "%-20s %-16s %s n = %4d p = %3d knn = %2d: %10.3g %s\n",
+                 benchmark.c_str(), config.workload.c_str(), config.l1 ? "L1" : "L2",
+                 config.n, config.p, graph.k, result.throughput, unit.c_str());
+  }
+
+  template <class NORM>
+  void run_norm(const BenchConfig& config,
+                const Eigen::MatrixXd& X,
+                const Eigen::ArrayXXd& M,
+                const KNNWeightGraph& row_graph,
+                const KNNWeightGraph& col_graph){
+    const Eigen::SparseMatrix<double> D = incidence_matrix<double>(row_graph.edge_list, config.n);
+    const Eigen::Index num_edges = row_graph.edge_list.rows();
+    int reps;
+
+    if(selected("admm_step")){
+      ConvexClustering<NORM, double> problem(X, M, D, row_graph.weights, 1.0, false);
+      problem.gamma = 0.01;
+
+      const double seconds = time_reps([&](){ problem.admm_step(); }, min_time, 1000000, reps);
+      record("admm_step", config, row_graph, reps, seconds, 1, "steps/s");
+    }
+
+    if(selected("row_prox")){
+      const RowProxKernel<double> row_prox = select_row_prox_kernel<NORM, double>(config.p);
+      const Eigen::MatrixXd DX = D * X;
+      Eigen::MatrixXd V(num_edges, config.p);
+      Eigen::ArrayXi zeros(num_edges);
+
+      const double seconds = time_reps([&](){ row_prox(DX, 0.01, row_graph.weights, V, zeros); },
+                                       min_time, 1000000, reps);
+      record("row_prox", config, row_graph, reps, seconds, num_edges, "rows/s");
+    }
+
+    if(selected("carp_path") || selected("cluster_assignments")){
+      ClusteringPath<double> path;
+      const double seconds = time_reps([&](){
+        path = CARP_path<NORM, double>(X, M, D, row_graph.weights,
+                                       1e-6, 1.05, 1.0, CLUSTRVIZ_DEFAULT_STOP_PRECISION,
+                                       5000000, 2500, 50, 0.5, 10, 15, 1.1, 1.01,
+                                       false, false, false, 0, 0);
+      }, min_time, max_path_reps, reps);
+      const Eigen::Index path_length = path.gamma_path.size();
+
+      if(selected("carp_path")){
+        record("carp_path", config, row_graph, reps, seconds, 1, "paths/s", path_length);
+      }
+
+      if(selected("cluster_assignments")){
+        const double assign_seconds = time_reps([&](){
+          for(Eigen::Index k = 0; k < path_length; k++){
+            get_cluster_assignments_impl(row_graph.edge_list, path.v_zero_inds.col(k), config.n);
+          }
+        }, min_time, 1000000, reps);
+        record("cluster_assignments", config, row_graph, reps, assign_seconds, path_length, "iterates/s", path_length);
+      }
+    }
+
+    if(selected("cbass_path")){
+      const Eigen::SparseMatrix<double> D_col = incidence_matrix<double>(col_graph.edge_list, config.p).transpose();
+      BiClusteringPath<double> path;
+
+      const double seconds = time_reps([&](){
+        ConvexBiClustering<NORM, double> problem(X, M, D, D_col, row_graph.weights, col_graph.weights, 1.0, false);
+        AlgorithmicRegularizationFixedStepSizePolicy<ConvexBiClustering<NORM, double> > cbass(problem, 1e-6, 1.05, 5000000, 50, 10);
+        path = cbass.extract_path();
+      }, min_time, max_path_reps, reps);
+      record("cbass_path", config, row_graph, reps, seconds, 1, "paths/s", path.gamma_path.size());
+    }
+  }
+};
+
+static void usage(){
+  std::fprintf(stderr, "Usage: clustrviz_bench [--quick] [--filter <benchmark>] [--output <file>]\n");
+  std::fprintf(stderr, "Benchmarks: admm_step, row_prox, carp_path, cluster_assignments, cbass_path,\n");
+  std::fprintf(stderr, "            knn_graph, approx_knn, predict\n");
+}
+
+int main(int argc, char** argv){
+  bool quick = false;
+  std::string filter;
+  std::string output;
+
+  for(int i = 1; i < argc; i++){
+    if(std::strcmp(argv[i], "--quick") == 0){
+      quick = true;
+    } else if((std::strcmp(argv[i], "--filter") == 0) && (i + 1 < argc)){
+      filter = argv[++i];
+    } else if((std::strcmp(argv[i], "--output") == 0) && (i + 1 < argc)){
+      output = argv[++i];
+    } else {
+      usage();
+      return 2;
+    }
+  }
+
+  // Sizes are visited in increasing order, so peak memory tracks the largest problem
+  const std::vector<std::string> workloads = {"gaussian_mixture", "sparse_counts"};
+  const std::vector<int> ns   = quick ? std::vector<int>{40}    : std::vector<int>{100, 200, 400};
+  const std::vector<int> ps   = quick ? std::vector<int>{4}     : std::vector<int>{5, 25};
+  const std::vector<int> knns = quick ? std::vector<int>{3}     : std::vector<int>{5, 15};
+  const int clusters = 5;
+
+  BenchRunner runner(quick, filter);
+
+  for(int n : ns){
+    for(int p : ps){
+      for(int knn : knns){
+        for(const std::string& workload : workloads){
+          for(bool l1 : {false, true}){
+            runner.run(BenchConfig{workload, n, p, clusters, knn, l1});
+          }
+        }
+      }
+    }
+  }
+
+  // Graph construction: exact k-NN is quadratic in n, so is only run on the smaller sizes
+  const std::vector<int> graph_ns = quick ? std::vector<int>{2000} : std::vector<int>{10000, 100000};
+  const int graph_p = 10, max_exact_n = 10000;
+  for(int n : graph_ns){
+    for(int knn : knns){
+      for(const std::string& workload : workloads){
+        runner.run_graph(BenchConfig{workload, n, graph_p, clusters, knn, false}, max_exact_n);
+      }
+    }
+    for(const std::string& workload : workloads){
+      runner.run_predict(BenchConfig{workload, n, graph_p, clusters, 0, false});
+    }
+  }
+
+  if(runner.num_results() == 0){
+    std::fprintf(stderr, "No benchmarks matched filter '%s'\n", filter.c_str());
+    usage();
+    return 2;
+  }
+
+  if(output.empty()){
+    runner.write_json(std::cout);
+  } else {
+    std::ofstream out(output.c_str());
+    runner.write_json(out);
+    if(!out){
+      std::fprintf(stderr, "Could not write results to %s\n", output.c_str());
+      return 1;
+    }
+  }
+
+  return runner.failed() ? 1 : 0;
+}
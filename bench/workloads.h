@@ -0,0 +1,79 @@
+#ifndef CLUSTRVIZ_BENCH_WORKLOADS_H
+#define CLUSTRVIZ_BENCH_WORKLOADS_H 1
+
+#include <Eigen/Dense>
+#include <algorithm>
+#include <random>
+#include <string>
+
+// Synthetic workloads for the benchmarks
+//
+// Both generators draw n observations from k well-defined clusters (assigned
+// round-robin), so that the solution paths have a known amount of structure, and
+// are deterministic given the seed. As in CARP() and CBASS(), the data are centered
+// column-wise before clustering.
+
+// Gaussian mixture: cluster centers are drawn from N(0, separation^2) in the first
+// (up to) five features and are zero in the rest, and each observation is its center
+// plus N(0, I) noise. Keeping the signal in a few features (as in most real data)
+// means the k-NN graphs stay connected at moderate k as p grows
+inline Eigen::MatrixXd gaussian_mixture(int n, int p, int k, double separation, unsigned int seed){
+  std::mt19937 rng(seed);
+  std::normal_distribution<double> normal(0, 1);
+
+  const int informative = std::min(p, 5);
+  Eigen::MatrixXd centers = Eigen::MatrixXd::Zero(k, p);
+  for(int j = 0; j < informative; j++){
+    for(int c = 0; c < k; c++){
+      centers(c, j) = separation * normal(rng);
+    }
+  }
+
+  Eigen::MatrixXd X(n, p);
+  for(int j = 0; j < p; j++){
+    for(int i = 0; i < n; i++){
+      X(i, j) = centers(i % k, j) + normal(rng);
+    }
+  }
+
+  return X;
+}
+
+// Sparse counts (e.g., term frequencies): each cluster is active on a random
+// `density` fraction of the features, where counts are Poisson with a (cluster-specific)
+// mean between 1 and 5. Inactive features only see occasional background counts,
+// so most cells are zero
+inline Eigen::MatrixXd sparse_counts(int n, int p, int k, double density, unsigned int seed){
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> uniform(0, 1);
+
+  Eigen::MatrixXd rates(k, p);
+  for(int j = 0; j < p; j++){
+    for(int c = 0; c < k; c++){
+      rates(c, j) = (uniform(rng) < density) ? 1 + 4 * uniform(rng) : 0.25;
+    }
+  }
+
+  Eigen::MatrixXd X(n, p);
+  for(int j = 0; j < p; j++){
+    for(int i = 0; i < n; i++){
+      std::poisson_distribution<int> poisson(rates(i % k, j));
+      X(i, j) = poisson(rng);
+    }
+  }
+
+  return X;
+}
+
+inline Eigen::MatrixXd center_columns(const Eigen::MatrixXd& X){
+  return X.rowwise() - X.colwise().mean();
+}
+
+inline Eigen::MatrixXd make_workload(const std::string& workload, int n, int p, int k, unsigned int seed){
+  if(workload == "sparse_counts"){
+    return center_columns(sparse_counts(n, p, k, 0.2, seed));
+  }
+  return center_columns(gaussian_mixture(n, p, k, 1.5, seed));
+}
+
+#endif
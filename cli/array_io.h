@@ -0,0 +1,284 @@
+#ifndef CLUSTRVIZ_CLI_ARRAY_IO_H
+#define CLUSTRVIZ_CLI_ARRAY_IO_H 1
+
+#include "clustRviz_core.h"
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Array files for the command-line driver
+//
+// Input arrays are read from either
+//
+//  - .npy files (as written by numpy.save): little-endian float64, float32, int32 or
+//    int64, one- or two-dimensional, in C or Fortran order; or
+//  - raw files of float64 values in native byte order and row-major (C) order, as
+//    written by numpy's tofile(), whose shape must be given separately.
+//
+// Results are written to a single "fit" file holding a sequence of named arrays:
+//
+//   - the magic string "CRVFIT01" and the number of arrays (int64);
+//   - for each array: the length of its name (int32), the name, its type ('d' for
+//     float64, 'i' for int32), the number of dimensions (int32), the dimensions
+//     (int64) and the values in column-major (Fortran / R) order.
+//
+// As with path files (see path_store.h), fit files use native byte order.
+
+#define CLUSTRVIZ_FIT_FILE_MAGIC "CRVFIT01"
+
+// Read values of the file's type into a buffer, then convert
+template <typename T>
+void read_npy_values(std::istream& in, Eigen::MatrixXd& values){
+  std::vector<T> buffer(values.size());
+  in.read(reinterpret_cast<char*>(buffer.data()), buffer.size() * sizeof(T));
+  for(Eigen::Index i = 0; i < values.size(); i++){
+    values(i) = static_cast<double>(buffer[i]);
+  }
+}
+
+// Read a (one- or two-dimensional) .npy array as a matrix -- vectors are returned
+// as a single column
+inline Eigen::MatrixXd read_npy(const std::string& file_name){
+  std::ifstream in(file_name.c_str(), std::ios::binary);
+  if(!in){
+    throw ClustRVizError("Could not open " + file_name + " for reading.");
+  }
+
+  char magic[8];
+  in.read(magic, 8);
+  if(!in || (std::memcmp(magic, "\x93NUMPY", 6) != 0)){
+    throw ClustRVizError(file_name + " is not a .npy file.");
+  }
+
+  // Version 1 files have a 2-byte header length, later versions 4 bytes
+  uint32_t header_length = 0;
+  if(magic[6] == 1){
+    uint16_t length16;
+    in.read(reinterpret_cast<char*>(&length16), sizeof(length16));
+    header_length = length16;
+  } else {
+    in.read(reinterpret_cast<char*>(&header_length), sizeof(header_length));
+  }
+
+  std::string header(header_length, ' ');
+  in.read(&header[0], header_length);
+  if(!in){
+    throw ClustRVizError("Could not read the header of " + file_name + ".");
+  }
+
+  // The header is a Python dict literal, e.g.
+  //   {'descr': '<f8', 'fortran_order': False, 'shape': (100, 5), }
+  const std::string malformed = "Malformed .npy header in " + file_name + ".";
+  auto dict_value = [&](const std::string& key) -> std::string {
+    std::size_t pos = header.find("'" + key + "'");
+    if(pos == std::string::npos){
+      throw ClustRVizError(malformed);
+    }
+    pos = header.find(':', pos);
+    if(pos == std::string::npos){
+      throw ClustRVizError(malformed);
+    }
+    const std::size_t start = header.find_first_not_of(" ", pos + 1);
+    if(start == std::string::npos){
+      throw ClustRVizError(malformed);
+    }
+    std::size_t end = (header[start] == '(') ? header.find(')', start) : header.find(',', start);
+    if(end == std::string::npos){
+      throw ClustRVizError(malformed);
+    }
+    if(header[start] == '('){
+      end++;
+    }
+    return header.substr(start, end - start);
+  };
+
+  std::string descr = dict_value("descr");
+  if((descr.size() < 2) || (descr[0] != '\'') || (descr[descr.size() - 1] != '\'')){
+    throw ClustRVizError(malformed);
+  }
+  descr = descr.substr(1, descr.size() - 2); // Strip quotes
+  const bool fortran_order = (dict_value("fortran_order") == "True");
+
+  std::vector<Eigen::Index> shape;
+  std::string shape_s = dict_value("shape");
+  std::istringstream shape_in(shape_s.substr(1, shape_s.size() - 2));
+  std::string dim;
+  while(std::getline(shape_in, dim, ',')){
+    if(dim.find_first_not_of(" ") == std::string::npos){
+      continue;
+    }
+    std::istringstream dim_in(dim);
+    long long extent;
+    if(!(dim_in >> extent) || !(dim_in >> std::ws).eof()){
+      throw ClustRVizError(malformed);
+    }
+    if(extent <= 0){
+      throw ClustRVizError(file_name + " has an empty or negative dimension.");
+    }
+    shape.push_back(extent);
+  }
+
+  if((shape.size() < 1) || (shape.size() > 2)){
+    throw ClustRVizError(file_name + " must hold a one- or two-dimensional array.");
+  }
+
+  std::size_t value_size;
+  if((descr == "<f8") || (descr == "=f8") || (descr == "<i8") || (descr == "=i8")){
+    value_size = 8;
+  } else if((descr == "<f4") || (descr == "=f4") || (descr == "<i4") || (descr == "=i4")){
+    value_size = 4;
+  } else {
+    throw ClustRVizError(file_name + " has unsupported type " + descr + " (float64, float32, int32 or int64 expected).");
+  }
+
+  // The values must fill the rest of the file exactly (which also bounds the size
+  // we allocate, whatever the header claims)
+  const std::streampos data_start = in.tellg();
+  in.seekg(0, std::ios::end);
+  const std::streamoff data_bytes = in.tellg() - data_start;
+  in.seekg(data_start);
+
+  const Eigen::Index rows = shape[0];
+  const Eigen::Index cols = (shape.size() == 2) ? shape[1] : 1;
+  const std::streamoff row_bytes = static_cast<std::streamoff>(value_size);
+  if((data_bytes <= 0) || (rows > data_bytes / row_bytes) || (cols > data_bytes / (rows * row_bytes)) ||
+     (rows * cols * row_bytes != data_bytes)){
+    throw ClustRVizError("The shape in the header of " + file_name + " does not match its size.");
+  }
+  const Eigen::Index size = rows * cols;
+
+  Eigen::MatrixXd values(size, 1);
+  if((descr == "<f8") || (descr == "=f8")){
+    read_npy_values<double>(in, values);
+  } else if((descr == "<f4") || (descr == "=f4")){
+    read_npy_values<float>(in, values);
+  } else if((descr == "<i4") || (descr == "=i4")){
+    read_npy_values<int32_t>(in, values);
+  } else {
+    read_npy_values<int64_t>(in, values);
+  }
+
+  if(!in){
+    throw ClustRVizError(file_name + " is truncated.");
+  }
+
+  if(fortran_order){
+    return Eigen::Map<Eigen::MatrixXd>(values.data(), rows, cols);
+  }
+  return Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> >(values.data(), rows, cols);
+}
+
+// Read a raw row-major float64 file with the given shape
+inline Eigen::MatrixXd read_raw(const std::string& file_name, Eigen::Index rows, Eigen::Index cols){
+  std::ifstream in(file_name.c_str(), std::ios::binary | std::ios::ate);
+  if(!in){
+    throw ClustRVizError("Could not open " + file_name + " for reading.");
+  }
+
+  if((rows <= 0) || (cols <= 0)){
+    throw ClustRVizError("The shape of " + file_name + " must be positive.");
+  }
+
+  const std::streamoff expected = static_cast<std::streamoff>(rows * cols * sizeof(double));
+  if(in.tellg() != expected){
+    std::ostringstream msg;
+    msg << file_name << " does not hold a " << rows << "-by-" << cols << " float64 matrix.";
+    throw ClustRVizError(msg.str());
+  }
+  in.seekg(0);
+
+  Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> values(rows, cols);
+  in.read(reinterpret_cast<char*>(values.data()), expected);
+  if(!in){
+    throw ClustRVizError("Could not read " + file_name + ".");
+  }
+
+  return values;
+}
+
+// Writes a fit file: arrays are added one at a time and the array count is
+// filled in by close()
+class FitFileWriter {
+public:
+  explicit FitFileWriter(const std::string& file_name_):
+    file_name(file_name_),
+    out(file_name_.c_str(), std::ios::binary),
+    num_arrays(0) {
+    if(!out){
+      throw ClustRVizError("Could not open " + file_name + " for writing.");
+    }
+
+    out.write(CLUSTRVIZ_FIT_FILE_MAGIC, 8);
+    write_value(num_arrays);
+  }
+
+  void add(const std::string& name, const double* values, const std::vector<int64_t>& dims){
+    write_array_header(name, 'd', dims);
+    out.write(reinterpret_cast<const char*>(values), num_values(dims) * sizeof(double));
+  }
+
+  void add(const std::string& name, const int32_t* values, const std::vector<int64_t>& dims){
+    write_array_header(name, 'i', dims);
+    out.write(reinterpret_cast<const char*>(values), num_values(dims) * sizeof(int32_t));
+  }
+
+  void add(const std::string& name, const Eigen::MatrixXd& values){
+    add(name, values.data(), {values.rows(), values.cols()});
+  }
+
+  void add(const std::string& name, const Eigen::MatrixXi& values){
+    add(name, values.data(), {values.rows(), values.cols()});
+  }
+
+  void add(const std::string& name, const Eigen::VectorXd& values){
+    add(name, values.data(), {values.size()});
+  }
+
+  void add(const std::string& name, const Eigen::VectorXi& values){
+    add(name, values.data(), {values.size()});
+  }
+
+  void close(){
+    out.seekp(8);
+    write_value(num_arrays);
+    out.close();
+
+    if(!out){
+      throw ClustRVizError("Could not write " + file_name + ".");
+    }
+  }
+
+private:
+  std::string file_name;
+  std::ofstream out;
+  int64_t num_arrays;
+
+  template <typename T>
+  void write_value(T value){
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+  }
+
+  static int64_t num_values(const std::vector<int64_t>& dims){
+    int64_t size = 1;
+    for(int64_t dim : dims){
+      size *= dim;
+    }
+    return size;
+  }
+
+  void write_array_header(const std::string& name, char type, const std::vector<int64_t>& dims){
+    write_value(static_cast<int32_t>(name.size()));
+    out.write(name.data(), name.size());
+    out.write(&type, 1);
+    write_value(static_cast<int32_t>(dims.size()));
+    for(int64_t dim : dims){
+      write_value(dim);
+    }
+    num_arrays++;
+  }
+};
+
+#endif
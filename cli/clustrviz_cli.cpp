@@ -0,0 +1,722 @@
+// Command-line driver for the clustRviz solvers
+//
+// Usage: clustrviz [options] --input <X> --output <fit file>
+//        clustrviz [options] --manifest <file> [--jobs <workers>]
+//
+// Computes a convex clustering (CARP) or biclustering (CBASS) path for a data matrix
+// without R, and writes the path, the cluster memberships along it and the
+// dendrogram to a single fit file (see array_io.h for both file formats). As in
+// CARP() and CBASS(), X is centered (column-wise for clustering, globally for
+// biclustering) before weights are computed, and weights default to sparse RBF kernel
+// weights with k and phi chosen automatically.
+//
+// A manifest lists one job per line, each given by the same options as a single run
+// (separated by white space; blank lines and lines starting with # are skipped).
+// Options on the command line are defaults for every job. Jobs are spread over a
+// pool of --jobs worker threads, as in CARPBatchcpp(), and a failed job does not
+// stop the others; the exit status is non-zero if any job failed.
+
+#include "clustRviz_core.h"
+#include "array_io.h"
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+static const char* USAGE =
+  "Usage: clustrviz [options] --input <X> --output <fit file>\n"
+  "       clustrviz [options] --manifest <file> [--jobs <workers>]\n"
+  "\n"
+  "Input:\n"
+  "  --input <file>             Data matrix: .npy, or raw row-major float64 with --raw\n"
+  "  --raw <rows> <cols>        Shape of a raw input file\n"
+  "  --weights <file>           Dense (n-by-n) weight matrix\n"
+  "  --edges <file>             Edge list (m-by-2, zero-based), with --edge-weights\n"
+  "  --edge-weights <file>      Weights for --edges (length m)\n"
+  "  --knn <k>                  Neighbors for default RBF weights (default: automatic)\n"
+  "  --phi <phi>                Scale for default RBF weights (default: automatic)\n"
+  "  --col-weights, --col-edges, --col-edge-weights, --col-knn, --col-phi\n"
+  "                             Column weights, as above (biclustering only)\n"
+  "  --no-center                Do not center X\n"
+  "  --scale                    Scale the columns of X to unit variance\n"
+  "  --collapse <tol>           Solve on one row per group of duplicate rows (0) or\n"
+  "                             rows in the same grid cell of width <tol>, weighted\n"
+  "                             by group size, with RBF weights between the group\n"
+  "                             means (clustering with RBF weights and no missing\n"
+  "                             data only; not with --policy tree-path)\n"
+  "\n"
+  "Solver:\n"
+  "  --biclustering             Compute a CBASS (rather than CARP) path\n"
+  "  --policy <policy>          carp (default), carp-viz, admm, admm-viz, grid or\n"
+  "                             tree-path (exact path: L1 norm, tree weights and\n"
+  "                             no missing data only)\n"
+  "  --lambda-grid <values>     Comma-separated grid (or a .npy file) for --policy grid\n"
+  "  --norm <l1|l2>             Fusion norm (default: l2)\n"
+  "  --epsilon, --t, --rho, --thresh, --max-iter, --max-inner-iter, --burn-in,\n"
+  "  --back, --keep, --viz-max-inner-iter, --viz-initial-step, --viz-small-step\n"
+  "                             Solver parameters, as in clustRviz_options()\n"
+  "  --screen-interval <steps>  Gap-safe edge screening every <steps> ADMM steps\n"
+  "                             (admm, admm-viz and grid only; default: off)\n"
+  "\n"
+  "Output:\n"
+  "  --output <file>            Fit file to write\n"
+  "  --no-u-path                Omit the U path from the fit file\n"
+  "  --progress                 Show progress (single runs only)\n"
+  "\n"
+  "Batch:\n"
+  "  --manifest <file>          Run the jobs listed in <file>\n"
+  "  --jobs <workers>           Number of worker threads (default: all cores)\n";
+
+// Graph (weights) specification for the rows or columns of X
+struct GraphOptions {
+  std::string weights_file;
+  std::string edges_file;
+  std::string edge_weights_file;
+  int knn;
+  double phi;
+
+  GraphOptions(): knn(0), phi(0) {}
+};
+
+struct JobOptions {
+  std::string input;
+  std::string output;
+  Eigen::Index raw_rows;
+  Eigen::Index raw_cols;
+  GraphOptions row_graph;
+  GraphOptions col_graph;
+  bool center;
+  bool scale;
+  double collapse; // Negative if rows are not collapsed
+
+  bool biclustering;
+  std::string policy;
+  std::vector<double> lambda_grid;
+  bool l1;
+  double epsilon;
+  double t;
+  double rho;
+  double thresh;
+  int max_iter;
+  int max_inner_iter;
+  int burn_in;
+  double back;
+  int keep;
+  int viz_max_inner_iter;
+  double viz_initial_step;
+  double viz_small_step;
+
+  bool write_u_path;
+  bool show_progress;
+  int screen_interval; // Set from the global --screen-interval
+
+  // Defaults match CARP() / CBASS() and clustRviz_default_options
+  JobOptions():
+    raw_rows(-1),
+    raw_cols(-1),
+    center(true),
+    scale(false),
+    collapse(-1),
+    biclustering(false),
+    policy("carp"),
+    l1(false),
+    epsilon(1e-6),
+    t(1.05),
+    rho(1.0),
+    thresh(CLUSTRVIZ_DEFAULT_STOP_PRECISION),
+    max_iter(5000000),
+    max_inner_iter(2500),
+    burn_in(50),
+    back(0.5),
+    keep(10),
+    viz_max_inner_iter(15),
+    viz_initial_step(1.1),
+    viz_small_step(1.01),
+    write_u_path(true),
+    show_progress(false),
+    screen_interval(0) {}
+};
+
+struct GlobalOptions {
+  std::string manifest;
+  int num_workers;
+  int screen_interval;
+
+  GlobalOptions(): num_workers(0), screen_interval(0) {}
+};
+
+static bool ends_with(const std::string& str, const std::string& suffix){
+  return (str.size() >= suffix.size()) && (str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0);
+}
+
+static double parse_double(const std::string& option, const std::string& value){
+  char* end;
+  double result = std::strtod(value.c_str(), &end);
+  if(value.empty() || (*end != '\0')){
+    throw ClustRVizError("Invalid value '" + value + "' for " + option + ".");
+  }
+  return result;
+}
+
+static int parse_int(const std::string& option, const std::string& value){
+  char* end;
+  long result = std::strtol(value.c_str(), &end, 10);
+  if(value.empty() || (*end != '\0')){
+    throw ClustRVizError("Invalid value '" + value + "' for " + option + ".");
+  }
+  return static_cast<int>(result);
+}
+
+static std::vector<double> parse_lambda_grid(const std::string& value){
+  std::vector<double> grid;
+
+  if(ends_with(value, ".npy")){
+    Eigen::MatrixXd values = read_npy(value);
+    grid.assign(values.data(), values.data() + values.size());
+  } else {
+    std::istringstream in(value);
+    std::string item;
+    while(std::getline(in, item, ',')){
+      grid.push_back(parse_double("--lambda-grid", item));
+    }
+  }
+
+  return grid;
+}
+
+// Parse job (and, if global is not NULL, batch) options from a list of arguments
+static void parse_options(const std::vector<std::string>& args, JobOptions& job, GlobalOptions* global){
+  for(std::size_t i = 0; i < args.size(); i++){
+    const std::string& option = args[i];
+
+    auto value = [&]() -> std::string {
+      if(i + 1 >= args.size()){
+        throw ClustRVizError("Missing value for " + option + ".");
+      }
+      return args[++i];
+    };
+
+    if(option == "--input"){
+      job.input = value();
+    } else if(option == "--output"){
+      job.output = value();
+    } else if(option == "--raw"){
+      job.raw_rows = parse_int(option, value());
+      job.raw_cols = parse_int(option, value());
+    } else if(option == "--weights"){
+      job.row_graph.weights_file = value();
+    } else if(option == "--edges"){
+      job.row_graph.edges_file = value();
+    } else if(option == "--edge-weights"){
+      job.row_graph.edge_weights_file = value();
+    } else if(option == "--knn"){
+      job.row_graph.knn = parse_int(option, value());
+    } else if(option == "--phi"){
+      job.row_graph.phi = parse_double(option, value());
+    } else if(option == "--col-weights"){
+      job.col_graph.weights_file = value();
+    } else if(option == "--col-edges"){
+      job.col_graph.edges_file = value();
+    } else if(option == "--col-edge-weights"){
+      job.col_graph.edge_weights_file = value();
+    } else if(option == "--col-knn"){
+      job.col_graph.knn = parse_int(option, value());
+    } else if(option == "--col-phi"){
+      job.col_graph.phi = parse_double(option, value());
+    } else if(option == "--no-center"){
+      job.center = false;
+    } else if(option == "--scale"){
+      job.scale = true;
+    } else if(option == "--collapse"){
+      job.collapse = parse_double(option, value());
+      if(!(job.collapse >= 0)){
+        throw ClustRVizError("--collapse must be non-negative.");
+      }
+    } else if(option == "--biclustering"){
+      job.biclustering = true;
+    } else if(option == "--policy"){
+      job.policy = value();
+    } else if(option == "--lambda-grid"){
+      job.lambda_grid = parse_lambda_grid(value());
+    } else if(option == "--norm"){
+      const std::string norm = value();
+      if((norm != "l1") && (norm != "l2")){
+        throw ClustRVizError("--norm must be l1 or l2.");
+      }
+      job.l1 = (norm == "l1");
+    } else if(option == "--epsilon"){
+      job.epsilon = parse_double(option, value());
+    } else if(option == "--t"){
+      job.t = parse_double(option, value());
+    } else if(option == "--rho"){
+      job.rho = parse_double(option, value());
+    } else if(option == "--thresh"){
+      job.thresh = parse_double(option, value());
+    } else if(option == "--max-iter"){
+      job.max_iter = parse_int(option, value());
+    } else if(option == "--max-inner-iter"){
+      job.max_inner_iter = parse_int(option, value());
+    } else if(option == "--burn-in"){
+      job.burn_in = parse_int(option, value());
+    } else if(option == "--back"){
+      job.back = parse_double(option, value());
+    } else if(option == "--keep"){
+      job.keep = parse_int(option, value());
+    } else if(option == "--viz-max-inner-iter"){
+      job.viz_max_inner_iter = parse_int(option, value());
+    } else if(option == "--viz-initial-step"){
+      job.viz_initial_step = parse_double(option, value());
+    } else if(option == "--viz-small-step"){
+      job.viz_small_step = parse_double(option, value());
+    } else if(option == "--no-u-path"){
+      job.write_u_path = false;
+    } else if(option == "--progress"){
+      job.show_progress = true;
+    } else if(global && (option == "--manifest")){
+      global->manifest = value();
+    } else if(global && (option == "--jobs")){
+      global->num_workers = parse_int(option, value());
+    } else if(global && (option == "--screen-interval")){
+      global->screen_interval = parse_int(option, value());
+    } else {
+      throw ClustRVizError("Unknown option " + option + ".");
+    }
+  }
+}
+
+static std::vector<std::string> read_manifest(const std::string& file_name){
+  std::ifstream in(file_name.c_str());
+  if(!in){
+    throw ClustRVizError("Could not open manifest " + file_name + ".");
+  }
+
+  std::vector<std::string> lines;
+  std::string line;
+  while(std::getline(in, line)){
+    std::size_t start = line.find_first_not_of(" \t\r");
+    if((start != std::string::npos) && (line[start] != '#')){
+      lines.push_back(line);
+    }
+  }
+
+  return lines;
+}
+
+static std::vector<std::string> split_words(const std::string& line){
+  std::istringstream in(line);
+  std::vector<std::string> words;
+  std::string word;
+  while(in >> word){
+    words.push_back(word);
+  }
+  return words;
+}
+
+// Input data and graphs
+//
+// All input is validated here, by throwing: the solvers' own checks report errors
+// through the logger, which is silent on worker threads
+static Eigen::MatrixXd read_data(const JobOptions& job){
+  if(job.input.empty()){
+    throw ClustRVizError("No input file given (--input).");
+  }
+
+  Eigen::MatrixXd X = (job.raw_rows >= 0) ? read_raw(job.input, job.raw_rows, job.raw_cols) : read_npy(job.input);
+
+  if(X.rows() < 2){
+    throw ClustRVizError(job.input + ": at least two observations are required.");
+  }
+
+  return X;
+}
+
+// Missing values (NaN) are masked out of the loss and filled with column means, as
+// a starting point for the solver
+static Eigen::ArrayXXd missing_data_mask(Eigen::MatrixXd& X){
+  Eigen::ArrayXXd M = (X.array() == X.array()).cast<double>();
+
+  for(Eigen::Index j = 0; j < X.cols(); j++){
+    const double num_observed = M.col(j).sum();
+    if(num_observed == 0){
+      throw ClustRVizError("Column " + std::to_string(j + 1) + " of X has no observed values.");
+    }
+
+    const double mean = (M.col(j) > 0).select(X.col(j).array(), 0).sum() / num_observed;
+    X.col(j) = (M.col(j) > 0).select(X.col(j).array(), mean).matrix();
+  }
+
+  return M;
+}
+
+static void preprocess(Eigen::MatrixXd& X, const JobOptions& job){
+  if(job.biclustering){
+    if(job.center){
+      X.array() -= X.mean();
+    }
+    return;
+  }
+
+  for(Eigen::Index j = 0; j < X.cols(); j++){
+    if(job.center){
+      X.col(j).array() -= X.col(j).mean();
+    }
+    if(job.scale && (X.rows() > 1)){
+      const double sd = std::sqrt((X.col(j).array() - X.col(j).mean()).square().sum() / (X.rows() - 1));
+      if(sd > 0){
+        X.col(j) /= sd;
+      }
+    }
+  }
+}
+
+// Build the weight graph for the rows of X (pass X^T for columns)
+static KNNWeightGraph build_graph(const Eigen::MatrixXd& X, const GraphOptions& options, const char* what){
+  const Eigen::Index n = X.rows();
+  KNNWeightGraph graph;
+  graph.phi = options.phi;
+  graph.k   = options.knn;
+
+  if(!options.weights_file.empty()){
+    Eigen::MatrixXd W = read_npy(options.weights_file);
+    if((W.rows() != n) || (W.cols() != n)){
+      throw ClustRVizError(options.weights_file + " must be a " + std::to_string(n) + "-by-" + std::to_string(n) + " matrix.");
+    }
+    if((W.array() < 0).any() || (W.array() != W.array()).any()){
+      throw ClustRVizError("All fusion weights must be positive or zero.");
+    }
+    weight_matrix_edges(W, graph.edge_list, graph.weights);
+  } else if(!options.edges_file.empty()){
+    if(options.edge_weights_file.empty()){
+      throw ClustRVizError("An edge list requires edge weights.");
+    }
+
+    Eigen::MatrixXd edges   = read_npy(options.edges_file);
+    Eigen::MatrixXd weights = read_npy(options.edge_weights_file);
+    if((edges.cols() != 2) || (weights.size() != edges.rows())){
+      throw ClustRVizError(options.edges_file + " must have two columns and one row per edge weight.");
+    }
+    if((edges.array() < 0).any() || (edges.array() >= n).any()){
+      throw ClustRVizError(options.edges_file + " has vertices outside 0, ..., " + std::to_string(n - 1) + ".");
+    }
+    if((weights.array() < 0).any()){
+      throw ClustRVizError("All fusion weights must be positive or zero.");
+    }
+
+    graph.edge_list = edges.cast<int>();
+    graph.weights   = Eigen::Map<Eigen::VectorXd>(weights.data(), weights.size());
+  } else {
+    if(options.knn >= n){
+      throw ClustRVizError("--knn should be less than the number of " + std::string(what) + ".");
+    }
+    graph = knn_rbf_graph(X, options.knn, options.phi);
+  }
+
+  if(!edge_list_is_connected(graph.edge_list, n)){
+    throw ClustRVizError(std::string("Weights for the ") + what + " do not imply a connected graph. Clustering will not succeed.");
+  }
+
+  return graph;
+}
+
+// Solve, for any of the problem types, and return the path
+template <class PROBLEM_TYPE>
+typename PROBLEM_TYPE::PathType solve_path(const PROBLEM_TYPE& problem, const JobOptions& job){
+  if(job.policy == "grid"){
+    if(job.lambda_grid.empty()){
+      throw ClustRVizError("--policy grid requires --lambda-grid.");
+    }
+    UserGridADMMPolicy<PROBLEM_TYPE> solver(problem, job.lambda_grid, job.thresh, job.max_iter, job.max_inner_iter);
+    return solver.extract_path();
+  }
+
+  const bool exact      = (job.policy == "admm") || (job.policy == "admm-viz");
+  const bool back_track = (job.policy == "carp-viz") || (job.policy == "admm-viz");
+
+  return clustering_path(problem, job.epsilon, job.t, job.thresh, job.max_iter, job.max_inner_iter,
+                         job.burn_in, job.back, job.keep, job.viz_max_inner_iter, job.viz_initial_step,
+                         job.viz_small_step, back_track, exact);
+}
+
+// Memberships (zero-based labels, one column per iterate) and cluster counts
+static void write_memberships(FitFileWriter& out,
+                              const std::string& prefix,
+                              const Eigen::MatrixXi& edge_list,
+                              const Eigen::MatrixXi& v_zero_inds,
+                              const Eigen::VectorXd& gamma_path,
+                              int n){
+  const Eigen::Index num_iters = v_zero_inds.cols();
+  Eigen::MatrixXi membership(n, num_iters);
+  Eigen::VectorXi num_clusters(num_iters);
+
+  for(Eigen::Index k = 0; k < num_iters; k++){
+    ClusterAssignment assignment = get_cluster_assignments_impl(edge_list, v_zero_inds.col(k), n);
+    membership.col(k) = assignment.membership;
+    num_clusters(k)   = assignment.num_clusters;
+  }
+
+  Dendrogram dendrogram = dendrogram_impl(edge_list, v_zero_inds, gamma_path, n);
+
+  out.add(prefix + "membership", membership);
+  out.add(prefix + "num_clusters", num_clusters);
+  out.add(prefix + "merge", dendrogram.merge);
+  out.add(prefix + "height", dendrogram.height);
+}
+
+static void write_u_path(FitFileWriter& out, const Eigen::MatrixXd& u_path, Eigen::Index n, Eigen::Index p){
+  out.add("u_path", u_path.data(), {n, p, u_path.cols()});
+}
+
+// Clustering of one row per group of (near-)duplicate rows, weighted by group size,
+// written out for the original rows (see row_collapse.h). The edges within each group
+// have infinite weight: their rows are fused for any positive gamma
+template <class NORM>
+static Eigen::Index run_collapsed_clustering(const JobOptions& job,
+                                             const Eigen::MatrixXd& X,
+                                             const Eigen::ArrayXXd& M,
+                                             FitFileWriter& out){
+  if(job.policy == "tree-path"){
+    throw ClustRVizError("--policy tree-path does not support --collapse.");
+  }
+  if((M != 1).any()){
+    throw ClustRVizError("--collapse does not support missing data.");
+  }
+  if(!job.row_graph.weights_file.empty() || !job.row_graph.edges_file.empty()){
+    throw ClustRVizError("--collapse requires the default RBF weights.");
+  }
+
+  const RowCollapse collapse = collapse_rows(X, job.collapse);
+  if(collapse.num_groups() < 2){
+    throw ClustRVizError("All rows were collapsed into a single group.");
+  }
+
+  const KNNWeightGraph graph = build_graph(collapse.X, job.row_graph, "rows");
+  const Eigen::SparseMatrix<double> D = incidence_matrix<double>(graph.edge_list, collapse.num_groups());
+  const Eigen::ArrayXXd M_groups = Eigen::ArrayXXd::Ones(collapse.num_groups(), X.cols());
+
+  ConvexClustering<NORM, double> problem(collapse.X, M_groups, D, graph.weights, job.rho, job.show_progress,
+                                         std::string(), collapse.multiplicity);
+  const ClusteringPath<double> group_path = solve_path(problem, job);
+
+  Eigen::VectorXi source;
+  const Eigen::MatrixXi edge_list = expanded_edge_list(collapse, graph.edge_list, source);
+  const ClusteringPath<double> path = expand_clustering_path(group_path, collapse, X, edge_list, source);
+
+  Eigen::VectorXd weights(edge_list.rows());
+  for(Eigen::Index e = 0; e < edge_list.rows(); e++){
+    weights(e) = (source(e) >= 0) ? graph.weights(source(e)) : std::numeric_limits<double>::infinity();
+  }
+
+  out.add("gamma_path", path.gamma_path);
+  if(job.write_u_path){
+    write_u_path(out, path.u_path, path.n, path.p);
+  }
+  out.add("edge_list", edge_list);
+  out.add("weights", weights);
+  out.add("collapse_group", collapse.group);
+  write_memberships(out, "", edge_list, path.v_zero_inds, path.gamma_path, X.rows());
+
+  return path.gamma_path.size();
+}
+
+template <class NORM>
+static Eigen::Index run_clustering(const JobOptions& job,
+                                   const Eigen::MatrixXd& X,
+                                   const Eigen::ArrayXXd& M,
+                                   FitFileWriter& out){
+  if(job.collapse >= 0){
+    return run_collapsed_clustering<NORM>(job, X, M, out);
+  }
+
+  const KNNWeightGraph graph = build_graph(X, job.row_graph, "rows");
+  const Eigen::SparseMatrix<double> D = incidence_matrix<double>(graph.edge_list, X.rows());
+
+  ClusteringPath<double> path;
+  if(job.policy == "tree-path"){
+    if(!std::is_same<NORM, L1Norm>::value){
+      throw ClustRVizError("--policy tree-path requires --norm l1.");
+    }
+    if((M != 1).any()){
+      throw ClustRVizError("--policy tree-path does not support missing data.");
+    }
+    if(!ExactTreePathPolicy<double>::is_tree(D)){
+      throw ClustRVizError("--policy tree-path requires the weights to imply a tree.");
+    }
+    ExactTreePathPolicy<double> tree_path(X, D, graph.weights);
+    path = tree_path.extract_path();
+  } else {
+    ConvexClustering<NORM, double> problem(X, M, D, graph.weights, job.rho, job.show_progress);
+    problem.set_screen_interval(job.screen_interval);
+    path = solve_path(problem, job);
+  }
+
+  out.add("gamma_path", path.gamma_path);
+  if(job.write_u_path){
+    write_u_path(out, path.u_path, path.n, path.p);
+  }
+  out.add("edge_list", graph.edge_list);
+  out.add("weights", graph.weights);
+  write_memberships(out, "", graph.edge_list, path.v_zero_inds, path.gamma_path, X.rows());
+
+  return path.gamma_path.size();
+}
+
+template <class NORM>
+static Eigen::Index run_biclustering(const JobOptions& job,
+                                     const Eigen::MatrixXd& X,
+                                     const Eigen::ArrayXXd& M,
+                                     FitFileWriter& out){
+  const KNNWeightGraph row_graph = build_graph(X, job.row_graph, "rows");
+  const KNNWeightGraph col_graph = build_graph(X.transpose(), job.col_graph, "columns");
+  const Eigen::SparseMatrix<double> D_row = incidence_matrix<double>(row_graph.edge_list, X.rows());
+  const Eigen::SparseMatrix<double> D_col = incidence_matrix<double>(col_graph.edge_list, X.cols()).transpose();
+
+  ConvexBiClustering<NORM, double> problem(X, M, D_row, D_col, row_graph.weights, col_graph.weights,
+                                           job.rho, job.show_progress);
+  BiClusteringPath<double> path = solve_path(problem, job);
+
+  out.add("gamma_path", path.gamma_path);
+  if(job.write_u_path){
+    write_u_path(out, path.u_path, path.n, path.p);
+  }
+  out.add("row_edge_list", row_graph.edge_list);
+  out.add("row_weights", row_graph.weights);
+  out.add("col_edge_list", col_graph.edge_list);
+  out.add("col_weights", col_graph.weights);
+  write_memberships(out, "row_", row_graph.edge_list, path.v_row_zero_inds, path.gamma_path, X.rows());
+  write_memberships(out, "col_", col_graph.edge_list, path.v_col_zero_inds, path.gamma_path, X.cols());
+
+  return path.gamma_path.size();
+}
+
+// Run one job, returning the length of its path
+static Eigen::Index run_job(const JobOptions& job){
+  if((job.policy != "carp") && (job.policy != "carp-viz") && (job.policy != "admm") &&
+     (job.policy != "admm-viz") && (job.policy != "grid") && (job.policy != "tree-path")){
+    throw ClustRVizError("Unknown policy '" + job.policy + "'.");
+  }
+  if(job.biclustering && (job.policy == "tree-path")){
+    throw ClustRVizError("--policy tree-path is not available for biclustering.");
+  }
+  if(job.biclustering && (job.collapse >= 0)){
+    throw ClustRVizError("--collapse is not available for biclustering.");
+  }
+  if(job.output.empty()){
+    throw ClustRVizError("No output file given (--output).");
+  }
+
+  Eigen::MatrixXd X = read_data(job);
+  const Eigen::ArrayXXd M = missing_data_mask(X);
+  preprocess(X, job);
+
+  FitFileWriter out(job.output);
+  Eigen::Index path_length;
+
+  if(job.biclustering){
+    path_length = job.l1 ? run_biclustering<L1Norm>(job, X, M, out) : run_biclustering<L2Norm>(job, X, M, out);
+  } else {
+    path_length = job.l1 ? run_clustering<L1Norm>(job, X, M, out) : run_clustering<L2Norm>(job, X, M, out);
+  }
+
+  out.close();
+  return path_length;
+}
+
+static int run_manifest(const GlobalOptions& global, const JobOptions& defaults){
+  const std::vector<std::string> lines = read_manifest(global.manifest);
+  const int num_jobs = lines.size();
+  int num_failed = 0;
+
+  int num_workers = global.num_workers;
+#ifdef _OPENMP
+  if(num_workers <= 0){
+    num_workers = omp_get_max_threads();
+  }
+#else
+  num_workers = 1;
+#endif
+
+  auto tic = std::chrono::steady_clock::now();
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1) num_threads(num_workers) reduction(+:num_failed)
+#endif
+  for(int j = 0; j < num_jobs; j++){
+    std::string status;
+    try {
+      JobOptions job = defaults;
+      job.show_progress = false;
+      parse_options(split_words(lines[j]), job, NULL);
+      status = "done (" + std::to_string(run_job(job)) + " iterates): " + job.output;
+    } catch(const std::exception& e){
+      status = std::string("FAILED: ") + e.what();
+      num_failed++;
+    }
+
+    std::fprintf(stderr, "Job %d/%d %s\n", j + 1, num_jobs, status.c_str());
+  }
+
+  auto toc = std::chrono::steady_clock::now();
+  double elapsed = std::chrono::duration<double>(toc - tic).count();
+
+  std::fprintf(stderr, "%d of %d jobs succeeded in %.3g seconds (%d workers)\n",
+               num_jobs - num_failed, num_jobs, elapsed, num_workers);
+
+  return (num_failed > 0) ? 1 : 0;
+}
+
+// CTRL-C stops single runs (and the jobs on the main thread) at their next
+// progress poll, rather than killing the process part way through writing output
+static volatile std::sig_atomic_t interrupted = 0;
+
+static void on_interrupt(int){
+  interrupted = 1;
+}
+
+static void check_interrupt(){
+  if(interrupted){
+    throw ClustRVizError("Interrupted.");
+  }
+}
+
+int main(int argc, char** argv){
+  JobOptions defaults;
+  GlobalOptions global;
+
+  try {
+    std::vector<std::string> args(argv + 1, argv + argc);
+    if(args.empty() || (args[0] == "--help")){
+      std::fputs(USAGE, args.empty() ? stderr : stdout);
+      return args.empty() ? 2 : 0;
+    }
+    parse_options(args, defaults, &global);
+  } catch(const std::exception& e){
+    std::fprintf(stderr, "%s\n\n%s", e.what(), USAGE);
+    return 2;
+  }
+
+  std::signal(SIGINT, on_interrupt);
+  clustRviz_hooks().check_interrupt = check_interrupt;
+  defaults.screen_interval = std::max(global.screen_interval, 0);
+
+  try {
+    if(!global.manifest.empty()){
+      return run_manifest(global, defaults);
+    }
+
+    run_job(defaults);
+  } catch(const std::exception& e){
+    std::fprintf(stderr, "Error: %s\n", e.what());
+    return 1;
+  }
+
+  return 0;
+}
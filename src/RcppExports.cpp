@@ -6,14 +6,73 @@
 
 using namespace Rcpp;
 
+// CARPBatchcpp
+Rcpp::List CARPBatchcpp(Rcpp::List X_list, Rcpp::List weight_list, double epsilon, double t, double rho, double thresh, int max_iter, int max_inner_iter, int burn_in, double back, int keep, int viz_max_inner_iter, double viz_initial_step, double viz_small_step, bool l1, bool back_track, bool exact, int num_threads, int screen_interval);
+RcppExport SEXP _clustRviz_CARPBatchcpp(SEXP X_listSEXP, SEXP weight_listSEXP, SEXP epsilonSEXP, SEXP tSEXP, SEXP rhoSEXP, SEXP threshSEXP, SEXP max_iterSEXP, SEXP max_inner_iterSEXP, SEXP burn_inSEXP, SEXP backSEXP, SEXP keepSEXP, SEXP viz_max_inner_iterSEXP, SEXP viz_initial_stepSEXP, SEXP viz_small_stepSEXP, SEXP l1SEXP, SEXP back_trackSEXP, SEXP exactSEXP, SEXP num_threadsSEXP, SEXP screen_intervalSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< Rcpp::List >::type X_list(X_listSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type weight_list(weight_listSEXP);
+    Rcpp::traits::input_parameter< double >::type epsilon(epsilonSEXP);
+    Rcpp::traits::input_parameter< double >::type t(tSEXP);
+    Rcpp::traits::input_parameter< double >::type rho(rhoSEXP);
+    Rcpp::traits::input_parameter< double >::type thresh(threshSEXP);
+    Rcpp::traits::input_parameter< int >::type max_iter(max_iterSEXP);
+    Rcpp::traits::input_parameter< int >::type max_inner_iter(max_inner_iterSEXP);
+    Rcpp::traits::input_parameter< int >::type burn_in(burn_inSEXP);
+    Rcpp::traits::input_parameter< double >::type back(backSEXP);
+    Rcpp::traits::input_parameter< int >::type keep(keepSEXP);
+    Rcpp::traits::input_parameter< int >::type viz_max_inner_iter(viz_max_inner_iterSEXP);
+    Rcpp::traits::input_parameter< double >::type viz_initial_step(viz_initial_stepSEXP);
+    Rcpp::traits::input_parameter< double >::type viz_small_step(viz_small_stepSEXP);
+    Rcpp::traits::input_parameter< bool >::type l1(l1SEXP);
+    Rcpp::traits::input_parameter< bool >::type back_track(back_trackSEXP);
+    Rcpp::traits::input_parameter< bool >::type exact(exactSEXP);
+    Rcpp::traits::input_parameter< int >::type num_threads(num_threadsSEXP);
+    Rcpp::traits::input_parameter< int >::type screen_interval(screen_intervalSEXP);
+    rcpp_result_gen = Rcpp::wrap(CARPBatchcpp(X_list, weight_list, epsilon, t, rho, thresh, max_iter, max_inner_iter, burn_in, back, keep, viz_max_inner_iter, viz_initial_step, viz_small_step, l1, back_track, exact, num_threads, screen_interval));
+    return rcpp_result_gen;
+END_RCPP
+}
+// CARPMulticpp
+Rcpp::List CARPMulticpp(const Eigen::MatrixXd& X, const Eigen::ArrayXXd& M, const Eigen::MatrixXi& edge_list, const Eigen::VectorXd& weights, const Eigen::VectorXi& block_sizes, double epsilon, double t, double rho, double thresh, int max_iter, int max_inner_iter, int burn_in, double back, int keep, int viz_max_inner_iter, double viz_initial_step, double viz_small_step, bool l1, bool show_progress, bool back_track, bool exact, bool single_precision);
+RcppExport SEXP _clustRviz_CARPMulticpp(SEXP XSEXP, SEXP MSEXP, SEXP edge_listSEXP, SEXP weightsSEXP, SEXP block_sizesSEXP, SEXP epsilonSEXP, SEXP tSEXP, SEXP rhoSEXP, SEXP threshSEXP, SEXP max_iterSEXP, SEXP max_inner_iterSEXP, SEXP burn_inSEXP, SEXP backSEXP, SEXP keepSEXP, SEXP viz_max_inner_iterSEXP, SEXP viz_initial_stepSEXP, SEXP viz_small_stepSEXP, SEXP l1SEXP, SEXP show_progressSEXP, SEXP back_trackSEXP, SEXP exactSEXP, SEXP single_precisionSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type X(XSEXP);
+    Rcpp::traits::input_parameter< const Eigen::ArrayXXd& >::type M(MSEXP);
+    Rcpp::traits::input_parameter< const Eigen::MatrixXi& >::type edge_list(edge_listSEXP);
+    Rcpp::traits::input_parameter< const Eigen::VectorXd& >::type weights(weightsSEXP);
+    Rcpp::traits::input_parameter< const Eigen::VectorXi& >::type block_sizes(block_sizesSEXP);
+    Rcpp::traits::input_parameter< double >::type epsilon(epsilonSEXP);
+    Rcpp::traits::input_parameter< double >::type t(tSEXP);
+    Rcpp::traits::input_parameter< double >::type rho(rhoSEXP);
+    Rcpp::traits::input_parameter< double >::type thresh(threshSEXP);
+    Rcpp::traits::input_parameter< int >::type max_iter(max_iterSEXP);
+    Rcpp::traits::input_parameter< int >::type max_inner_iter(max_inner_iterSEXP);
+    Rcpp::traits::input_parameter< int >::type burn_in(burn_inSEXP);
+    Rcpp::traits::input_parameter< double >::type back(backSEXP);
+    Rcpp::traits::input_parameter< int >::type keep(keepSEXP);
+    Rcpp::traits::input_parameter< int >::type viz_max_inner_iter(viz_max_inner_iterSEXP);
+    Rcpp::traits::input_parameter< double >::type viz_initial_step(viz_initial_stepSEXP);
+    Rcpp::traits::input_parameter< double >::type viz_small_step(viz_small_stepSEXP);
+    Rcpp::traits::input_parameter< bool >::type l1(l1SEXP);
+    Rcpp::traits::input_parameter< bool >::type show_progress(show_progressSEXP);
+    Rcpp::traits::input_parameter< bool >::type back_track(back_trackSEXP);
+    Rcpp::traits::input_parameter< bool >::type exact(exactSEXP);
+    Rcpp::traits::input_parameter< bool >::type single_precision(single_precisionSEXP);
+    rcpp_result_gen = Rcpp::wrap(CARPMulticpp(X, M, edge_list, weights, block_sizes, epsilon, t, rho, thresh, max_iter, max_inner_iter, burn_in, back, keep, viz_max_inner_iter, viz_initial_step, viz_small_step, l1, show_progress, back_track, exact, single_precision));
+    return rcpp_result_gen;
+END_RCPP
+}
 // CARPcpp
-Rcpp::List CARPcpp(const Eigen::MatrixXd& X, const Eigen::ArrayXXd& M, const Eigen::MatrixXd& D, const Eigen::VectorXd& weights, double epsilon, double t, double rho, double thresh, int max_iter, int max_inner_iter, int burn_in, double back, int keep, int viz_max_inner_iter, double viz_initial_step, double viz_small_step, bool l1, bool show_progress, bool back_track, bool exact);
-RcppExport SEXP _clustRviz_CARPcpp(SEXP XSEXP, SEXP MSEXP, SEXP DSEXP, SEXP weightsSEXP, SEXP epsilonSEXP, SEXP tSEXP, SEXP rhoSEXP, SEXP threshSEXP, SEXP max_iterSEXP, SEXP max_inner_iterSEXP, SEXP burn_inSEXP, SEXP backSEXP, SEXP keepSEXP, SEXP viz_max_inner_iterSEXP, SEXP viz_initial_stepSEXP, SEXP viz_small_stepSEXP, SEXP l1SEXP, SEXP show_progressSEXP, SEXP back_trackSEXP, SEXP exactSEXP) {
+Rcpp::List CARPcpp(const Eigen::MatrixXd& X, const Eigen::ArrayXXd& M, const Eigen::MatrixXi& edge_list, const Eigen::VectorXd& weights, double epsilon, double t, double rho, double thresh, int max_iter, int max_inner_iter, int burn_in, double back, int keep, int viz_max_inner_iter, double viz_initial_step, double viz_small_step, bool l1, bool show_progress, bool back_track, bool exact, bool tree_path, bool single_precision, Rcpp::IntegerVector row_groups, int trace_length, int screen_interval);
+RcppExport SEXP _clustRviz_CARPcpp(SEXP XSEXP, SEXP MSEXP, SEXP edge_listSEXP, SEXP weightsSEXP, SEXP epsilonSEXP, SEXP tSEXP, SEXP rhoSEXP, SEXP threshSEXP, SEXP max_iterSEXP, SEXP max_inner_iterSEXP, SEXP burn_inSEXP, SEXP backSEXP, SEXP keepSEXP, SEXP viz_max_inner_iterSEXP, SEXP viz_initial_stepSEXP, SEXP viz_small_stepSEXP, SEXP l1SEXP, SEXP show_progressSEXP, SEXP back_trackSEXP, SEXP exactSEXP, SEXP tree_pathSEXP, SEXP single_precisionSEXP, SEXP row_groupsSEXP, SEXP trace_lengthSEXP, SEXP screen_intervalSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type X(XSEXP);
     Rcpp::traits::input_parameter< const Eigen::ArrayXXd& >::type M(MSEXP);
-    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type D(DSEXP);
+    Rcpp::traits::input_parameter< const Eigen::MatrixXi& >::type edge_list(edge_listSEXP);
     Rcpp::traits::input_parameter< const Eigen::VectorXd& >::type weights(weightsSEXP);
     Rcpp::traits::input_parameter< double >::type epsilon(epsilonSEXP);
     Rcpp::traits::input_parameter< double >::type t(tSEXP);
@@ -31,19 +90,24 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< bool >::type show_progress(show_progressSEXP);
     Rcpp::traits::input_parameter< bool >::type back_track(back_trackSEXP);
     Rcpp::traits::input_parameter< bool >::type exact(exactSEXP);
-    rcpp_result_gen = Rcpp::wrap(CARPcpp(X, M, D, weights, epsilon, t, rho, thresh, max_iter, max_inner_iter, burn_in, back, keep, viz_max_inner_iter, viz_initial_step, viz_small_step, l1, show_progress, back_track, exact));
+    Rcpp::traits::input_parameter< bool >::type tree_path(tree_pathSEXP);
+    Rcpp::traits::input_parameter< bool >::type single_precision(single_precisionSEXP);
+    Rcpp::traits::input_parameter< Rcpp::IntegerVector >::type row_groups(row_groupsSEXP);
+    Rcpp::traits::input_parameter< int >::type trace_length(trace_lengthSEXP);
+    Rcpp::traits::input_parameter< int >::type screen_interval(screen_intervalSEXP);
+    rcpp_result_gen = Rcpp::wrap(CARPcpp(X, M, edge_list, weights, epsilon, t, rho, thresh, max_iter, max_inner_iter, burn_in, back, keep, viz_max_inner_iter, viz_initial_step, viz_small_step, l1, show_progress, back_track, exact, tree_path, single_precision, row_groups, trace_length, screen_interval));
     return rcpp_result_gen;
 END_RCPP
 }
 // CBASScpp
-Rcpp::List CBASScpp(const Eigen::MatrixXd& X, const Eigen::ArrayXXd& M, const Eigen::MatrixXd& D_row, const Eigen::MatrixXd& D_col, const Eigen::VectorXd& weights_row, const Eigen::VectorXd& weights_col, double epsilon, double t, double thresh, double rho, int max_iter, int max_inner_iter, int burn_in, double back, int keep, int viz_max_inner_iter, double viz_initial_step, double viz_small_step, bool l1, bool show_progress, bool back_track, bool exact);
-RcppExport SEXP _clustRviz_CBASScpp(SEXP XSEXP, SEXP MSEXP, SEXP D_rowSEXP, SEXP D_colSEXP, SEXP weights_rowSEXP, SEXP weights_colSEXP, SEXP epsilonSEXP, SEXP tSEXP, SEXP threshSEXP, SEXP rhoSEXP, SEXP max_iterSEXP, SEXP max_inner_iterSEXP, SEXP burn_inSEXP, SEXP backSEXP, SEXP keepSEXP, SEXP viz_max_inner_iterSEXP, SEXP viz_initial_stepSEXP, SEXP viz_small_stepSEXP, SEXP l1SEXP, SEXP show_progressSEXP, SEXP back_trackSEXP, SEXP exactSEXP) {
+Rcpp::List CBASScpp(const Eigen::MatrixXd& X, const Eigen::ArrayXXd& M, const Eigen::MatrixXi& row_edge_list, const Eigen::MatrixXi& col_edge_list, const Eigen::VectorXd& weights_row, const Eigen::VectorXd& weights_col, double epsilon, double t, double thresh, double rho, int max_iter, int max_inner_iter, int burn_in, double back, int keep, int viz_max_inner_iter, double viz_initial_step, double viz_small_step, bool l1, bool show_progress, bool back_track, bool exact, bool single_precision, int trace_length);
+RcppExport SEXP _clustRviz_CBASScpp(SEXP XSEXP, SEXP MSEXP, SEXP row_edge_listSEXP, SEXP col_edge_listSEXP, SEXP weights_rowSEXP, SEXP weights_colSEXP, SEXP epsilonSEXP, SEXP tSEXP, SEXP threshSEXP, SEXP rhoSEXP, SEXP max_iterSEXP, SEXP max_inner_iterSEXP, SEXP burn_inSEXP, SEXP backSEXP, SEXP keepSEXP, SEXP viz_max_inner_iterSEXP, SEXP viz_initial_stepSEXP, SEXP viz_small_stepSEXP, SEXP l1SEXP, SEXP show_progressSEXP, SEXP back_trackSEXP, SEXP exactSEXP, SEXP single_precisionSEXP, SEXP trace_lengthSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type X(XSEXP);
     Rcpp::traits::input_parameter< const Eigen::ArrayXXd& >::type M(MSEXP);
-    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type D_row(D_rowSEXP);
-    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type D_col(D_colSEXP);
+    Rcpp::traits::input_parameter< const Eigen::MatrixXi& >::type row_edge_list(row_edge_listSEXP);
+    Rcpp::traits::input_parameter< const Eigen::MatrixXi& >::type col_edge_list(col_edge_listSEXP);
     Rcpp::traits::input_parameter< const Eigen::VectorXd& >::type weights_row(weights_rowSEXP);
     Rcpp::traits::input_parameter< const Eigen::VectorXd& >::type weights_col(weights_colSEXP);
     Rcpp::traits::input_parameter< double >::type epsilon(epsilonSEXP);
@@ -62,18 +126,20 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< bool >::type show_progress(show_progressSEXP);
     Rcpp::traits::input_parameter< bool >::type back_track(back_trackSEXP);
     Rcpp::traits::input_parameter< bool >::type exact(exactSEXP);
-    rcpp_result_gen = Rcpp::wrap(CBASScpp(X, M, D_row, D_col, weights_row, weights_col, epsilon, t, thresh, rho, max_iter, max_inner_iter, burn_in, back, keep, viz_max_inner_iter, viz_initial_step, viz_small_step, l1, show_progress, back_track, exact));
+    Rcpp::traits::input_parameter< bool >::type single_precision(single_precisionSEXP);
+    Rcpp::traits::input_parameter< int >::type trace_length(trace_lengthSEXP);
+    rcpp_result_gen = Rcpp::wrap(CBASScpp(X, M, row_edge_list, col_edge_list, weights_row, weights_col, epsilon, t, thresh, rho, max_iter, max_inner_iter, burn_in, back, keep, viz_max_inner_iter, viz_initial_step, viz_small_step, l1, show_progress, back_track, exact, single_precision, trace_length));
     return rcpp_result_gen;
 END_RCPP
 }
 // ConvexClusteringCPP
-Rcpp::List ConvexClusteringCPP(const Eigen::MatrixXd& X, const Eigen::ArrayXXd& M, const Eigen::MatrixXd& D, const Eigen::VectorXd& weights, const std::vector<double> lambda_grid, double rho, double thresh, int max_iter, int max_inner_iter, bool l1, bool show_progress);
-RcppExport SEXP _clustRviz_ConvexClusteringCPP(SEXP XSEXP, SEXP MSEXP, SEXP DSEXP, SEXP weightsSEXP, SEXP lambda_gridSEXP, SEXP rhoSEXP, SEXP threshSEXP, SEXP max_iterSEXP, SEXP max_inner_iterSEXP, SEXP l1SEXP, SEXP show_progressSEXP) {
+Rcpp::List ConvexClusteringCPP(const Eigen::MatrixXd& X, const Eigen::ArrayXXd& M, const Eigen::MatrixXi& edge_list, const Eigen::VectorXd& weights, const std::vector<double> lambda_grid, double rho, double thresh, int max_iter, int max_inner_iter, bool l1, bool show_progress, std::string path_file, int screen_interval);
+RcppExport SEXP _clustRviz_ConvexClusteringCPP(SEXP XSEXP, SEXP MSEXP, SEXP edge_listSEXP, SEXP weightsSEXP, SEXP lambda_gridSEXP, SEXP rhoSEXP, SEXP threshSEXP, SEXP max_iterSEXP, SEXP max_inner_iterSEXP, SEXP l1SEXP, SEXP show_progressSEXP, SEXP path_fileSEXP, SEXP screen_intervalSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type X(XSEXP);
     Rcpp::traits::input_parameter< const Eigen::ArrayXXd& >::type M(MSEXP);
-    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type D(DSEXP);
+    Rcpp::traits::input_parameter< const Eigen::MatrixXi& >::type edge_list(edge_listSEXP);
     Rcpp::traits::input_parameter< const Eigen::VectorXd& >::type weights(weightsSEXP);
     Rcpp::traits::input_parameter< const std::vector<double> >::type lambda_grid(lambda_gridSEXP);
     Rcpp::traits::input_parameter< double >::type rho(rhoSEXP);
@@ -82,19 +148,21 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< int >::type max_inner_iter(max_inner_iterSEXP);
     Rcpp::traits::input_parameter< bool >::type l1(l1SEXP);
     Rcpp::traits::input_parameter< bool >::type show_progress(show_progressSEXP);
-    rcpp_result_gen = Rcpp::wrap(ConvexClusteringCPP(X, M, D, weights, lambda_grid, rho, thresh, max_iter, max_inner_iter, l1, show_progress));
+    Rcpp::traits::input_parameter< std::string >::type path_file(path_fileSEXP);
+    Rcpp::traits::input_parameter< int >::type screen_interval(screen_intervalSEXP);
+    rcpp_result_gen = Rcpp::wrap(ConvexClusteringCPP(X, M, edge_list, weights, lambda_grid, rho, thresh, max_iter, max_inner_iter, l1, show_progress, path_file, screen_interval));
     return rcpp_result_gen;
 END_RCPP
 }
 // ConvexBiClusteringCPP
-Rcpp::List ConvexBiClusteringCPP(const Eigen::MatrixXd& X, const Eigen::ArrayXXd& M, const Eigen::MatrixXd& D_row, const Eigen::MatrixXd& D_col, const Eigen::VectorXd& weights_row, const Eigen::VectorXd& weights_col, const std::vector<double> lambda_grid, double rho, double thresh, int max_iter, int max_inner_iter, bool l1, bool show_progress);
-RcppExport SEXP _clustRviz_ConvexBiClusteringCPP(SEXP XSEXP, SEXP MSEXP, SEXP D_rowSEXP, SEXP D_colSEXP, SEXP weights_rowSEXP, SEXP weights_colSEXP, SEXP lambda_gridSEXP, SEXP rhoSEXP, SEXP threshSEXP, SEXP max_iterSEXP, SEXP max_inner_iterSEXP, SEXP l1SEXP, SEXP show_progressSEXP) {
+Rcpp::List ConvexBiClusteringCPP(const Eigen::MatrixXd& X, const Eigen::ArrayXXd& M, const Eigen::MatrixXi& row_edge_list, const Eigen::MatrixXi& col_edge_list, const Eigen::VectorXd& weights_row, const Eigen::VectorXd& weights_col, const std::vector<double> lambda_grid, double rho, double thresh, int max_iter, int max_inner_iter, bool l1, bool show_progress);
+RcppExport SEXP _clustRviz_ConvexBiClusteringCPP(SEXP XSEXP, SEXP MSEXP, SEXP row_edge_listSEXP, SEXP col_edge_listSEXP, SEXP weights_rowSEXP, SEXP weights_colSEXP, SEXP lambda_gridSEXP, SEXP rhoSEXP, SEXP threshSEXP, SEXP max_iterSEXP, SEXP max_inner_iterSEXP, SEXP l1SEXP, SEXP show_progressSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type X(XSEXP);
     Rcpp::traits::input_parameter< const Eigen::ArrayXXd& >::type M(MSEXP);
-    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type D_row(D_rowSEXP);
-    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type D_col(D_colSEXP);
+    Rcpp::traits::input_parameter< const Eigen::MatrixXi& >::type row_edge_list(row_edge_listSEXP);
+    Rcpp::traits::input_parameter< const Eigen::MatrixXi& >::type col_edge_list(col_edge_listSEXP);
     Rcpp::traits::input_parameter< const Eigen::VectorXd& >::type weights_row(weights_rowSEXP);
     Rcpp::traits::input_parameter< const Eigen::VectorXd& >::type weights_col(weights_colSEXP);
     Rcpp::traits::input_parameter< const std::vector<double> >::type lambda_grid(lambda_gridSEXP);
@@ -104,7 +172,7 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< int >::type max_inner_iter(max_inner_iterSEXP);
     Rcpp::traits::input_parameter< bool >::type l1(l1SEXP);
     Rcpp::traits::input_parameter< bool >::type show_progress(show_progressSEXP);
-    rcpp_result_gen = Rcpp::wrap(ConvexBiClusteringCPP(X, M, D_row, D_col, weights_row, weights_col, lambda_grid, rho, thresh, max_iter, max_inner_iter, l1, show_progress));
+    rcpp_result_gen = Rcpp::wrap(ConvexBiClusteringCPP(X, M, row_edge_list, col_edge_list, weights_row, weights_col, lambda_grid, rho, thresh, max_iter, max_inner_iter, l1, show_progress));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -148,6 +216,53 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// soft_impute_matrix
+Eigen::MatrixXd soft_impute_matrix(const Eigen::MatrixXd& X, int rank, double lambda, int max_iter, double tol, int power_iter);
+RcppExport SEXP _clustRviz_soft_impute_matrix(SEXP XSEXP, SEXP rankSEXP, SEXP lambdaSEXP, SEXP max_iterSEXP, SEXP tolSEXP, SEXP power_iterSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type X(XSEXP);
+    Rcpp::traits::input_parameter< int >::type rank(rankSEXP);
+    Rcpp::traits::input_parameter< double >::type lambda(lambdaSEXP);
+    Rcpp::traits::input_parameter< int >::type max_iter(max_iterSEXP);
+    Rcpp::traits::input_parameter< double >::type tol(tolSEXP);
+    Rcpp::traits::input_parameter< int >::type power_iter(power_iterSEXP);
+    rcpp_result_gen = Rcpp::wrap(soft_impute_matrix(X, rank, lambda, max_iter, tol, power_iter));
+    return rcpp_result_gen;
+END_RCPP
+}
+// knn_impute_matrix
+Eigen::MatrixXd knn_impute_matrix(const Eigen::MatrixXd& X, int k);
+RcppExport SEXP _clustRviz_knn_impute_matrix(SEXP XSEXP, SEXP kSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type X(XSEXP);
+    Rcpp::traits::input_parameter< int >::type k(kSEXP);
+    rcpp_result_gen = Rcpp::wrap(knn_impute_matrix(X, k));
+    return rcpp_result_gen;
+END_RCPP
+}
+// path_store_info
+Rcpp::List path_store_info(std::string path_file);
+RcppExport SEXP _clustRviz_path_store_info(SEXP path_fileSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< std::string >::type path_file(path_fileSEXP);
+    rcpp_result_gen = Rcpp::wrap(path_store_info(path_file));
+    return rcpp_result_gen;
+END_RCPP
+}
+// path_store_read
+Rcpp::NumericVector path_store_read(std::string path_file, const Eigen::VectorXi& indices);
+RcppExport SEXP _clustRviz_path_store_read(SEXP path_fileSEXP, SEXP indicesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< std::string >::type path_file(path_fileSEXP);
+    Rcpp::traits::input_parameter< const Eigen::VectorXi& >::type indices(indicesSEXP);
+    rcpp_result_gen = Rcpp::wrap(path_store_read(path_file, indices));
+    return rcpp_result_gen;
+END_RCPP
+}
 // MatrixRowProx
 Eigen::MatrixXd MatrixRowProx(const Eigen::MatrixXd& X, double lambda, const Eigen::VectorXd& weights, bool l1);
 RcppExport SEXP _clustRviz_MatrixRowProx(SEXP XSEXP, SEXP lambdaSEXP, SEXP weightsSEXP, SEXP l1SEXP) {
@@ -174,6 +289,31 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// MissingMaskImpute
+Rcpp::List MissingMaskImpute(const Eigen::MatrixXd& X, const Eigen::ArrayXXd& M, Rcpp::List U_list);
+RcppExport SEXP _clustRviz_MissingMaskImpute(SEXP XSEXP, SEXP MSEXP, SEXP U_listSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type X(XSEXP);
+    Rcpp::traits::input_parameter< const Eigen::ArrayXXd& >::type M(MSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type U_list(U_listSEXP);
+    rcpp_result_gen = Rcpp::wrap(MissingMaskImpute(X, M, U_list));
+    return rcpp_result_gen;
+END_RCPP
+}
+// LaplacianSolve
+Rcpp::List LaplacianSolve(const Eigen::SparseMatrix<double>& D, double rho, const Eigen::MatrixXd& B, const Eigen::VectorXd& mass);
+RcppExport SEXP _clustRviz_LaplacianSolve(SEXP DSEXP, SEXP rhoSEXP, SEXP BSEXP, SEXP massSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< const Eigen::SparseMatrix<double>& >::type D(DSEXP);
+    Rcpp::traits::input_parameter< double >::type rho(rhoSEXP);
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type B(BSEXP);
+    Rcpp::traits::input_parameter< const Eigen::VectorXd& >::type mass(massSEXP);
+    rcpp_result_gen = Rcpp::wrap(LaplacianSolve(D, rho, B, mass));
+    return rcpp_result_gen;
+END_RCPP
+}
 // check_weight_matrix
 void check_weight_matrix(const Eigen::MatrixXd& weight_matrix);
 RcppExport SEXP _clustRviz_check_weight_matrix(SEXP weight_matrixSEXP) {
@@ -194,32 +334,172 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// smooth_u_centroids
+Rcpp::List smooth_u_centroids(Rcpp::NumericVector U_old, Rcpp::List cluster_info_list);
+RcppExport SEXP _clustRviz_smooth_u_centroids(SEXP U_oldSEXP, SEXP cluster_info_listSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type U_old(U_oldSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type cluster_info_list(cluster_info_listSEXP);
+    rcpp_result_gen = Rcpp::wrap(smooth_u_centroids(U_old, cluster_info_list));
+    return rcpp_result_gen;
+END_RCPP
+}
+// centroid_path_slices
+Rcpp::NumericVector centroid_path_slices(const Eigen::MatrixXd& centroids, const Eigen::VectorXi& offsets, const Eigen::MatrixXi& membership, const Eigen::VectorXi& slices, const Eigen::VectorXi& cols);
+RcppExport SEXP _clustRviz_centroid_path_slices(SEXP centroidsSEXP, SEXP offsetsSEXP, SEXP membershipSEXP, SEXP slicesSEXP, SEXP colsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type centroids(centroidsSEXP);
+    Rcpp::traits::input_parameter< const Eigen::VectorXi& >::type offsets(offsetsSEXP);
+    Rcpp::traits::input_parameter< const Eigen::MatrixXi& >::type membership(membershipSEXP);
+    Rcpp::traits::input_parameter< const Eigen::VectorXi& >::type slices(slicesSEXP);
+    Rcpp::traits::input_parameter< const Eigen::VectorXi& >::type cols(colsSEXP);
+    rcpp_result_gen = Rcpp::wrap(centroid_path_slices(centroids, offsets, membership, slices, cols));
+    return rcpp_result_gen;
+END_RCPP
+}
+// centroid_path_projection
+Rcpp::NumericVector centroid_path_projection(const Eigen::MatrixXd& centroids, const Eigen::VectorXi& offsets, const Eigen::MatrixXi& membership, const Eigen::MatrixXd& Y, const Eigen::VectorXi& slices);
+RcppExport SEXP _clustRviz_centroid_path_projection(SEXP centroidsSEXP, SEXP offsetsSEXP, SEXP membershipSEXP, SEXP YSEXP, SEXP slicesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type centroids(centroidsSEXP);
+    Rcpp::traits::input_parameter< const Eigen::VectorXi& >::type offsets(offsetsSEXP);
+    Rcpp::traits::input_parameter< const Eigen::MatrixXi& >::type membership(membershipSEXP);
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type Y(YSEXP);
+    Rcpp::traits::input_parameter< const Eigen::VectorXi& >::type slices(slicesSEXP);
+    rcpp_result_gen = Rcpp::wrap(centroid_path_projection(centroids, offsets, membership, Y, slices));
+    return rcpp_result_gen;
+END_RCPP
+}
+// centroid_path_assign
+Rcpp::List centroid_path_assign(const Eigen::MatrixXd& centroids, const Eigen::VectorXi& offsets, int slice, const Eigen::MatrixXd& X);
+RcppExport SEXP _clustRviz_centroid_path_assign(SEXP centroidsSEXP, SEXP offsetsSEXP, SEXP sliceSEXP, SEXP XSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type centroids(centroidsSEXP);
+    Rcpp::traits::input_parameter< const Eigen::VectorXi& >::type offsets(offsetsSEXP);
+    Rcpp::traits::input_parameter< int >::type slice(sliceSEXP);
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type X(XSEXP);
+    rcpp_result_gen = Rcpp::wrap(centroid_path_assign(centroids, offsets, slice, X));
+    return rcpp_result_gen;
+END_RCPP
+}
 // tensor_projection
-Rcpp::NumericVector tensor_projection(Rcpp::NumericVector X, const Eigen::MatrixXd& Y);
-RcppExport SEXP _clustRviz_tensor_projection(SEXP XSEXP, SEXP YSEXP) {
+Rcpp::NumericVector tensor_projection(Rcpp::NumericVector X, const Eigen::MatrixXd& Y, Rcpp::IntegerVector slices);
+RcppExport SEXP _clustRviz_tensor_projection(SEXP XSEXP, SEXP YSEXP, SEXP slicesSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::traits::input_parameter< Rcpp::NumericVector >::type X(XSEXP);
     Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type Y(YSEXP);
-    rcpp_result_gen = Rcpp::wrap(tensor_projection(X, Y));
+    Rcpp::traits::input_parameter< Rcpp::IntegerVector >::type slices(slicesSEXP);
+    rcpp_result_gen = Rcpp::wrap(tensor_projection(X, Y, slices));
+    return rcpp_result_gen;
+END_RCPP
+}
+// collapse_duplicate_rows
+Rcpp::List collapse_duplicate_rows(const Eigen::MatrixXd& X, double tol);
+RcppExport SEXP _clustRviz_collapse_duplicate_rows(SEXP XSEXP, SEXP tolSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type X(XSEXP);
+    Rcpp::traits::input_parameter< double >::type tol(tolSEXP);
+    rcpp_result_gen = Rcpp::wrap(collapse_duplicate_rows(X, tol));
+    return rcpp_result_gen;
+END_RCPP
+}
+// knn_rbf_weights
+Rcpp::List knn_rbf_weights(const Eigen::MatrixXd& X, int k, double phi);
+RcppExport SEXP _clustRviz_knn_rbf_weights(SEXP XSEXP, SEXP kSEXP, SEXP phiSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type X(XSEXP);
+    Rcpp::traits::input_parameter< int >::type k(kSEXP);
+    Rcpp::traits::input_parameter< double >::type phi(phiSEXP);
+    rcpp_result_gen = Rcpp::wrap(knn_rbf_weights(X, k, phi));
+    return rcpp_result_gen;
+END_RCPP
+}
+// approx_knn_rbf_weights
+Rcpp::List approx_knn_rbf_weights(const Eigen::MatrixXd& X, int k, double phi, double recall, int max_iter, int seed);
+RcppExport SEXP _clustRviz_approx_knn_rbf_weights(SEXP XSEXP, SEXP kSEXP, SEXP phiSEXP, SEXP recallSEXP, SEXP max_iterSEXP, SEXP seedSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type X(XSEXP);
+    Rcpp::traits::input_parameter< int >::type k(kSEXP);
+    Rcpp::traits::input_parameter< double >::type phi(phiSEXP);
+    Rcpp::traits::input_parameter< double >::type recall(recallSEXP);
+    Rcpp::traits::input_parameter< int >::type max_iter(max_iterSEXP);
+    Rcpp::traits::input_parameter< int >::type seed(seedSEXP);
+    rcpp_result_gen = Rcpp::wrap(approx_knn_rbf_weights(X, k, phi, recall, max_iter, seed));
+    return rcpp_result_gen;
+END_RCPP
+}
+// dense_weight_edges
+Rcpp::List dense_weight_edges(const Eigen::MatrixXd& weight_matrix);
+RcppExport SEXP _clustRviz_dense_weight_edges(SEXP weight_matrixSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type weight_matrix(weight_matrixSEXP);
+    rcpp_result_gen = Rcpp::wrap(dense_weight_edges(weight_matrix));
+    return rcpp_result_gen;
+END_RCPP
+}
+// sparse_weight_edges
+Rcpp::List sparse_weight_edges(const Eigen::SparseMatrix<double>& weight_matrix);
+RcppExport SEXP _clustRviz_sparse_weight_edges(SEXP weight_matrixSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< const Eigen::SparseMatrix<double>& >::type weight_matrix(weight_matrixSEXP);
+    rcpp_result_gen = Rcpp::wrap(sparse_weight_edges(weight_matrix));
+    return rcpp_result_gen;
+END_RCPP
+}
+// is_connected_edge_list
+bool is_connected_edge_list(const Eigen::MatrixXi& edge_list, int n);
+RcppExport SEXP _clustRviz_is_connected_edge_list(SEXP edge_listSEXP, SEXP nSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< const Eigen::MatrixXi& >::type edge_list(edge_listSEXP);
+    Rcpp::traits::input_parameter< int >::type n(nSEXP);
+    rcpp_result_gen = Rcpp::wrap(is_connected_edge_list(edge_list, n));
     return rcpp_result_gen;
 END_RCPP
 }
 
 static const R_CallMethodDef CallEntries[] = {
-    {"_clustRviz_CARPcpp", (DL_FUNC) &_clustRviz_CARPcpp, 20},
-    {"_clustRviz_CBASScpp", (DL_FUNC) &_clustRviz_CBASScpp, 22},
-    {"_clustRviz_ConvexClusteringCPP", (DL_FUNC) &_clustRviz_ConvexClusteringCPP, 11},
+    {"_clustRviz_CARPBatchcpp", (DL_FUNC) &_clustRviz_CARPBatchcpp, 19},
+    {"_clustRviz_CARPMulticpp", (DL_FUNC) &_clustRviz_CARPMulticpp, 22},
+    {"_clustRviz_CARPcpp", (DL_FUNC) &_clustRviz_CARPcpp, 25},
+    {"_clustRviz_CBASScpp", (DL_FUNC) &_clustRviz_CBASScpp, 24},
+    {"_clustRviz_ConvexClusteringCPP", (DL_FUNC) &_clustRviz_ConvexClusteringCPP, 13},
     {"_clustRviz_ConvexBiClusteringCPP", (DL_FUNC) &_clustRviz_ConvexBiClusteringCPP, 13},
     {"_clustRviz_clustRviz_set_logger_level_cpp", (DL_FUNC) &_clustRviz_clustRviz_set_logger_level_cpp, 1},
     {"_clustRviz_clustRviz_get_logger_level_cpp", (DL_FUNC) &_clustRviz_clustRviz_get_logger_level_cpp, 0},
     {"_clustRviz_clustRviz_log_cpp", (DL_FUNC) &_clustRviz_clustRviz_log_cpp, 2},
     {"_clustRviz_get_cluster_assignments", (DL_FUNC) &_clustRviz_get_cluster_assignments, 3},
+    {"_clustRviz_soft_impute_matrix", (DL_FUNC) &_clustRviz_soft_impute_matrix, 6},
+    {"_clustRviz_knn_impute_matrix", (DL_FUNC) &_clustRviz_knn_impute_matrix, 2},
+    {"_clustRviz_path_store_info", (DL_FUNC) &_clustRviz_path_store_info, 1},
+    {"_clustRviz_path_store_read", (DL_FUNC) &_clustRviz_path_store_read, 2},
     {"_clustRviz_MatrixRowProx", (DL_FUNC) &_clustRviz_MatrixRowProx, 4},
     {"_clustRviz_MatrixColProx", (DL_FUNC) &_clustRviz_MatrixColProx, 4},
+    {"_clustRviz_MissingMaskImpute", (DL_FUNC) &_clustRviz_MissingMaskImpute, 3},
+    {"_clustRviz_LaplacianSolve", (DL_FUNC) &_clustRviz_LaplacianSolve, 4},
     {"_clustRviz_check_weight_matrix", (DL_FUNC) &_clustRviz_check_weight_matrix, 1},
     {"_clustRviz_smooth_u_clustering", (DL_FUNC) &_clustRviz_smooth_u_clustering, 2},
-    {"_clustRviz_tensor_projection", (DL_FUNC) &_clustRviz_tensor_projection, 2},
+    {"_clustRviz_smooth_u_centroids", (DL_FUNC) &_clustRviz_smooth_u_centroids, 2},
+    {"_clustRviz_centroid_path_slices", (DL_FUNC) &_clustRviz_centroid_path_slices, 5},
+    {"_clustRviz_centroid_path_projection", (DL_FUNC) &_clustRviz_centroid_path_projection, 5},
+    {"_clustRviz_centroid_path_assign", (DL_FUNC) &_clustRviz_centroid_path_assign, 4},
+    {"_clustRviz_tensor_projection", (DL_FUNC) &_clustRviz_tensor_projection, 3},
+    {"_clustRviz_collapse_duplicate_rows", (DL_FUNC) &_clustRviz_collapse_duplicate_rows, 2},
+    {"_clustRviz_knn_rbf_weights", (DL_FUNC) &_clustRviz_knn_rbf_weights, 3},
+    {"_clustRviz_approx_knn_rbf_weights", (DL_FUNC) &_clustRviz_approx_knn_rbf_weights, 6},
+    {"_clustRviz_dense_weight_edges", (DL_FUNC) &_clustRviz_dense_weight_edges, 1},
+    {"_clustRviz_sparse_weight_edges", (DL_FUNC) &_clustRviz_sparse_weight_edges, 1},
+    {"_clustRviz_is_connected_edge_list", (DL_FUNC) &_clustRviz_is_connected_edge_list, 2},
     {NULL, NULL, 0}
 };
 
@@ -3,6 +3,8 @@
 
 #include "clustRviz_base.h"
 #include "clustRviz_logging.h"
+#include "profile.h"
+#include "trace.h"
 
 template <class PROBLEM_TYPE>
 class AlgorithmicRegularizationFixedStepSizePolicy {
@@ -31,11 +33,11 @@ public:
     problem.gamma = epsilon;
 
     while( (iter < max_iter) & (!problem.is_complete()) ){
-      ClustRVizLogger::info("Beginning iteration k = ") << iter + 1;
-      ClustRVizLogger::debug("gamma = ") << problem.gamma;
-
+      CLUSTRVIZ_PROFILE_NEW_GAMMA(problem.profile);
       problem.save_fusions();
       problem.admm_step();
+      CLUSTRVIZ_PROFILE_INNER_ITERATION(problem.profile);
+      CLUSTRVIZ_TRACE(problem, TRACE_STEP, iter + 1, 1, TRACE_NO_CHANGE);
 
       // Store interesting iterations, but otherwise ignore the burn-in phase
       if( problem.is_interesting_iter() | ((iter % keep == 0) & (iter > burn_in)) ){
@@ -58,10 +60,10 @@ public:
     solved = true;
   }
 
-  Rcpp::List build_return_object(){
+  typename PROBLEM_TYPE::PathType extract_path(){
     if(!solved) solve();
 
-    return problem.build_return_object();
+    return problem.extract_path();
   }
 private:
   PROBLEM_TYPE problem;
@@ -116,10 +118,8 @@ public:
     t = viz_initial_step;
 
     while( (iter < max_iter) & (!problem.is_complete()) ){
-      ClustRVizLogger::info("Beginning iteration k = ") << iter + 1;
-      ClustRVizLogger::info("gamma = ") << problem.gamma;
-
       // Pre-load V_old, Z_old, etc. so we have them for the 'load_old_variables' step below
+      CLUSTRVIZ_PROFILE_NEW_GAMMA(problem.profile);
       problem.save_fusions();
       problem.save_old_values();
 
@@ -133,8 +133,10 @@ public:
         problem.load_old_variables();
         problem.gamma = gamma;
         problem.admm_step();
+        CLUSTRVIZ_PROFILE_INNER_ITERATION(problem.profile);
 
         try_iter++;
+        CLUSTRVIZ_TRACE(problem, TRACE_STEP, iter + 1, try_iter, TRACE_NO_CHANGE);
 
         if(try_iter > viz_max_inner_iter){
           break;
@@ -150,7 +152,7 @@ public:
           // no need to back-track (we didn't miss any fusions) so we can go immediately
           // to the next iteration.
           rep_iter = false;
-          ClustRVizLogger::info("No fusions identified -- continuing to next step.");
+          CLUSTRVIZ_TRACE(problem, TRACE_NO_FUSIONS, iter + 1, try_iter, TRACE_NO_CHANGE);
         } else if(problem.multiple_fusions()){
           // If we see two (or more) new fusions, we need to back-track and figure
           // out which one occured first
@@ -161,19 +163,21 @@ public:
             gamma_upper = gamma;
             gamma = 0.5 * (gamma_lower + gamma_upper);
           }
-          ClustRVizLogger::info("Too many fusions -- backtracking.");
+          CLUSTRVIZ_PROFILE_BACKTRACK_RETRY(problem.profile);
+          CLUSTRVIZ_TRACE(problem, TRACE_BACKTRACK, iter + 1, try_iter, TRACE_NO_CHANGE);
         } else if(!problem.is_interesting_iter()){
           // If we don't observe any new fusions, we move our regularization level
           // up to try to find one
           problem.load_old_fusions();
           gamma_lower = gamma;
           gamma = 0.5 * (gamma_lower + gamma_upper);
-          ClustRVizLogger::info("Fusion not isolated -- moving forward.");
+          CLUSTRVIZ_PROFILE_BACKTRACK_RETRY(problem.profile);
+          CLUSTRVIZ_TRACE(problem, TRACE_FORWARD, iter + 1, try_iter, TRACE_NO_CHANGE);
         } else {
           // If we see exactly one new fusion, we have a good step size and exit
           // the inner back-tracking loop
           rep_iter = false;
-          ClustRVizLogger::info("Good iteration - continuing to next step.");
+          CLUSTRVIZ_TRACE(problem, TRACE_ACCEPT, iter + 1, try_iter, TRACE_NO_CHANGE);
         }
 
         // The progress bar class also checks for user interrupts on ticks
@@ -210,10 +214,10 @@ public:
     solved = true;
   }
 
-  Rcpp::List build_return_object(){
+  typename PROBLEM_TYPE::PathType extract_path(){
     if(!solved) solve();
 
-    return problem.build_return_object();
+    return problem.extract_path();
   }
 
 private:
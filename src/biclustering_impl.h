@@ -4,32 +4,55 @@
 #include "clustRviz_base.h"
 #include "clustRviz_logging.h"
 #include "status.h"
+#include "norm_policies.h"
+#include "profile.h"
+#include "trace.h"
+
+// Solution path for convex biclustering, stored as plain Eigen objects so that it
+// can be built without touching R (e.g., from a worker thread)
+template <typename Scalar>
+struct BiClusteringPath {
+  Eigen::Index n;          // Dimensions of each (vectorized) iterate in u_path
+  Eigen::Index p;
+  MatrixXs<Scalar> u_path;
+  MatrixXs<Scalar> v_row_path;
+  MatrixXs<Scalar> v_col_path;
+  Eigen::MatrixXi v_row_zero_inds;
+  Eigen::MatrixXi v_col_zero_inds;
+  Eigen::VectorXd gamma_path;
+  SolverProfile profile;
+  SolverTrace trace;
+};
 
+template <class NORM, typename Scalar>
 class ConvexBiClustering {
 public:
-  double gamma; // Current regularization level - need to be able to manipulate this externally
+  typedef BiClusteringPath<Scalar> PathType;
 
-  ConvexBiClustering(const Eigen::MatrixXd& X_,
-                     const Eigen::ArrayXXd& M_,
-                     const Eigen::MatrixXd& D_row_,
-                     const Eigen::MatrixXd& D_col_,
-                     const Eigen::VectorXd& weights_row_,
-                     const Eigen::VectorXd& weights_col_,
+  double gamma; // Current regularization level - need to be able to manipulate this externally
+  SolverProfile profile; // Per-phase timings and counters (see profile.h) - updated by the policies too
+  SolverTrace trace;     // Iteration trace (see trace.h) - recorded by the policies
+
+  ConvexBiClustering(const MatrixXs<Scalar>& X_,
+                     const ArrayXXs<Scalar>& M_,
+                     const SpMatrixXs<Scalar>& D_row_,
+                     const SpMatrixXs<Scalar>& D_col_,
+                     const VectorXs<Scalar>& weights_row_,
+                     const VectorXs<Scalar>& weights_col_,
                      const double rho_,
-                     const bool l1_,
                      const bool show_progress_):
     X(X_),
-    M(M_),
+    missing(M_),
     D_row(D_row_),
     D_col(D_col_),
     weights_row(weights_row_),
     weights_col(weights_col_),
     rho(rho_),
-    l1(l1_),
     n(X_.rows()),
     p(X_.cols()),
     num_row_edges(D_row_.rows()),
     num_col_edges(D_col_.cols()),
+    row_prox(select_row_prox_kernel<NORM, Scalar>(X_.cols())),
     sp(show_progress_, D_row_.rows() + D_col_.cols()),
     DDT_col(D_col_ * D_col_.transpose()),
     DTD_row(D_row_.transpose() * D_row_) {
@@ -37,19 +60,21 @@ public:
       // Set initial values for optimization variables
       U = X;
       V_row = D_row * U;
-      Z_row = Eigen::MatrixXd::Zero(V_row.rows(), V_row.cols());
+      Z_row = MatrixXs<Scalar>::Zero(V_row.rows(), V_row.cols());
       V_col = U * D_col;
-      Z_col = Eigen::MatrixXd::Zero(V_col.rows(), V_col.cols());
+      Z_col = MatrixXs<Scalar>::Zero(V_col.rows(), V_col.cols());
 
 
       v_row_zeros = Eigen::ArrayXi::Zero(num_row_edges);
       v_col_zeros = Eigen::ArrayXi::Zero(num_col_edges);
       gamma = 0;
+      last_u_change = TRACE_NO_CHANGE;
 
       //compute alpha
       //TODO: implement a tighter alpha calculation
-      double row_max_deg = D_row.cwiseAbs().colwise().sum().maxCoeff();
-      double col_max_deg = D_col.cwiseAbs().rowwise().sum().maxCoeff();
+      //(The diagonals of the graph Laplacians D^TD are the vertex degrees)
+      double row_max_deg = DTD_row.diagonal().maxCoeff();
+      double col_max_deg = DDT_col.diagonal().maxCoeff();
       alpha = 2 * (row_max_deg  * col_max_deg);
 
 
@@ -87,7 +112,9 @@ public:
   }
 
   void admm_step(){
-    Eigen::MatrixXd X_imputed = M * X.array() + (1.0 - M) * U.array();
+    CLUSTRVIZ_PROFILE_TIMER(profile);
+
+    const MatrixXs<Scalar>& X_imputed = missing.impute(X, U, imputation_buffer);
     // U-update
     U = (X_imputed + alpha * U + rho * (
         D_row.transpose() * (V_row - Z_row) +
@@ -96,64 +123,35 @@ public:
         U * DDT_col
       )) / (1 + alpha);
 
-    Eigen::MatrixXd DrowU = D_row * U;
-    Eigen::MatrixXd UDcol = U * D_col;
-    ClustRVizLogger::debug("U = ") << U;
+    MatrixXs<Scalar> DrowU = D_row * U;
+    MatrixXs<Scalar> UDcol = U * D_col;
+    CLUSTRVIZ_PROFILE_LAP(PROFILE_U_SOLVE);
 
-    // V-updates
-    Eigen::MatrixXd DUZ = DrowU + Z_row; //DUZ = D_row * U + Z_row
-    V_row = MatrixRowProx(DUZ, gamma / rho, weights_row, l1);
-    ClustRVizLogger::debug("V_row = ") << V_row;
+    // V-updates (also identify row and column fusions)
+    MatrixXs<Scalar> DUZ = DrowU + Z_row; //DUZ = D_row * U + Z_row
+    nzeros_row = row_prox(DUZ, gamma / rho, weights_row, V_row, v_row_zeros);
 
 
-    Eigen::MatrixXd UDZ = UDcol + Z_col; //UDZ = (U * D_col + Z_col
-    V_col = MatrixColProx(UDZ, gamma / rho, weights_col, l1);
-    ClustRVizLogger::debug("V_col = ") << V_col;
+    MatrixXs<Scalar> UDZ = UDcol + Z_col; //UDZ = (U * D_col + Z_col
+    nzeros_col = NORM::template col_prox<Scalar>(UDZ, gamma / rho, weights_col, V_col, v_col_zeros);
+    CLUSTRVIZ_PROFILE_LAP(PROFILE_PROX);
 
 
     // Z-updates
     Z_row = Z_row + DrowU - V_row;
-    ClustRVizLogger::debug("Z_row = ") << Z_row;
-
     Z_col = Z_col + UDcol - V_col;
-    ClustRVizLogger::debug("Z_col = ") << Z_col;
-
+    CLUSTRVIZ_PROFILE_LAP(PROFILE_DUAL_UPDATE);
 
-    // Identify row fusions (rows of V_row which have gone to zero)
-    Eigen::VectorXd v_row_norms = V_row.rowwise().squaredNorm();
-
-    for(Eigen::Index i = 0; i < num_row_edges; i++){
-      v_row_zeros(i) = v_row_norms(i) == 0;
-    }
-
-    nzeros_row = v_row_zeros.sum();
-
-    // Identify column fusions (rows of V_col which have gone to zero)
-    Eigen::VectorXd v_col_norms = V_col.colwise().squaredNorm();
-
-    for(Eigen::Index i = 0; i < num_col_edges; i++){
-      v_col_zeros(i) = v_col_norms(i) == 0;
+    // The objective is only reported, never used, so skip it unless it will be logged
+    if(ClustRVizLogger::get_level() <= ClustRVizLoggerLevel::INFO){
+      double loss = 0.5 * (X - U).squaredNorm() + gamma * (
+        NORM::row_penalty(V_row, weights_row) + NORM::col_penalty(V_col, weights_col));
+      ClustRVizLogger::info("Objective function: ") <<  loss;
     }
-
-    nzeros_col = v_col_zeros.sum();
-
-    double loss;
-    if (l1) {
-      loss = 0.5 * (X - U).squaredNorm() + gamma * (
-        V_row.cwiseAbs().rowwise().sum().dot(weights_row) +
-        V_col.cwiseAbs().colwise().sum().dot(weights_col));
-    } else {
-      loss = 0.5 * (X - U).squaredNorm() + gamma * (
-        V_row.rowwise().norm().dot(weights_row) +
-        V_col.colwise().norm().dot(weights_col));
-    }
-    ClustRVizLogger::info("Objective function: ") <<  loss;
-
-
-    ClustRVizLogger::debug("Number of row fusions identified ") << nzeros_row;
-    ClustRVizLogger::debug("Number of column fusions identified ") << nzeros_col;
   }
 
+  // Edge screening (see screening.h) is only implemented for convex clustering
+  void screen_edges(int){}
 
   void save_fusions(){
     nzeros_row_old = nzeros_row;
@@ -190,15 +188,32 @@ public:
     return (nzeros_row > 0) | (nzeros_col > 0);
   }
 
+  int num_fusions() const {
+    return nzeros_row + nzeros_col;
+  }
+
+  // Change in U at the last convergence check (for the trace)
+  double u_change() const {
+    return last_u_change;
+  }
+
   bool admm_converged(double thresh = CLUSTRVIZ_DEFAULT_STOP_PRECISION){
-    return (scaled_squared_norm(U - U_old) < CLUSTRVIZ_DEFAULT_STOP_PRECISION) &&
-           (scaled_squared_norm(Z_row - Z_row_old) < CLUSTRVIZ_DEFAULT_STOP_PRECISION) &&
-           (scaled_squared_norm(Z_col - Z_col_old) < CLUSTRVIZ_DEFAULT_STOP_PRECISION) &&
-           (scaled_squared_norm(V_row - V_row_old) < CLUSTRVIZ_DEFAULT_STOP_PRECISION) &&
-           (scaled_squared_norm(V_col - V_col_old) < CLUSTRVIZ_DEFAULT_STOP_PRECISION);
+    CLUSTRVIZ_PROFILE_TIMER(profile);
+
+    last_u_change = scaled_squared_norm(U - U_old);
+    const bool converged = (last_u_change < CLUSTRVIZ_DEFAULT_STOP_PRECISION) &&
+                           (scaled_squared_norm(Z_row - Z_row_old) < CLUSTRVIZ_DEFAULT_STOP_PRECISION) &&
+                           (scaled_squared_norm(Z_col - Z_col_old) < CLUSTRVIZ_DEFAULT_STOP_PRECISION) &&
+                           (scaled_squared_norm(V_row - V_row_old) < CLUSTRVIZ_DEFAULT_STOP_PRECISION) &&
+                           (scaled_squared_norm(V_col - V_col_old) < CLUSTRVIZ_DEFAULT_STOP_PRECISION);
+
+    CLUSTRVIZ_PROFILE_LAP(PROFILE_CONVERGENCE_CHECK);
+    return converged;
   }
 
   void store_values(){
+    CLUSTRVIZ_PROFILE_TIMER(profile);
+
     if(storage_index >= buffer_size){
       ClustRVizLogger::info("Resizing storage from ") << buffer_size << " to " << 2 * buffer_size << " iterations.";
       buffer_size *= 2; // Double our buffer sizes
@@ -211,98 +226,111 @@ public:
     }
 
     // Store values
-    UPath.col(storage_index)        = Eigen::Map<Eigen::VectorXd>(U.data(), n * p);
-    V_rowPath.col(storage_index)    = Eigen::Map<Eigen::VectorXd>(V_row.data(), p * num_row_edges);
-    V_colPath.col(storage_index)    = Eigen::Map<Eigen::VectorXd>(V_col.data(), n * num_col_edges);
+    UPath.col(storage_index)        = Eigen::Map<VectorXs<Scalar> >(U.data(), n * p);
+    V_rowPath.col(storage_index)    = Eigen::Map<VectorXs<Scalar> >(V_row.data(), p * num_row_edges);
+    V_colPath.col(storage_index)    = Eigen::Map<VectorXs<Scalar> >(V_col.data(), n * num_col_edges);
     gamma_path(storage_index)       = gamma;
     v_row_zeros_path.col(storage_index) = v_row_zeros;
     v_col_zeros_path.col(storage_index) = v_col_zeros;
 
     storage_index++;
+    CLUSTRVIZ_PROFILE_LAP(PROFILE_STORE_VALUES);
   }
 
-  Rcpp::List build_return_object(){
+  PathType extract_path(){
+    sp.finish(); // Stop progress printing
+
     // When we are done, we can "drop" unused buffer space before returning to R
     //
     // storage_index is the zero-based index of the next column we would use for storage,
     // but it is also the (one-based) _number_ of columns we want to save so no need
     // to adjust. (NB: conservativeResize takes the target size, not the columns to keep
-    // as an argument)
-    UPath.conservativeResize(UPath.rows(), storage_index);
-    V_rowPath.conservativeResize(V_rowPath.rows(), storage_index);
-    V_colPath.conservativeResize(V_colPath.rows(), storage_index);
+    // as an argument.) Since we only drop trailing columns, this shrinks the column-major
+    // buffers in place and the buffers are then handed off to the path without copying
+    UPath.conservativeResize(Eigen::NoChange, storage_index);
+    V_rowPath.conservativeResize(Eigen::NoChange, storage_index);
+    V_colPath.conservativeResize(Eigen::NoChange, storage_index);
     gamma_path.conservativeResize(storage_index);
-    v_row_zeros_path.conservativeResize(v_row_zeros_path.rows(), storage_index);
-    v_col_zeros_path.conservativeResize(v_col_zeros_path.rows(), storage_index);
-
-    return Rcpp::List::create(Rcpp::Named("u_path")          = UPath,
-                              Rcpp::Named("v_row_path")      = V_rowPath,
-                              Rcpp::Named("v_col_path")      = V_colPath,
-                              Rcpp::Named("v_row_zero_inds") = v_row_zeros_path,
-                              Rcpp::Named("v_col_zero_inds") = v_col_zeros_path,
-                              Rcpp::Named("gamma_path")      = gamma_path);
+    v_row_zeros_path.conservativeResize(Eigen::NoChange, storage_index);
+    v_col_zeros_path.conservativeResize(Eigen::NoChange, storage_index);
+
+    PathType path;
+    path.n = n;
+    path.p = p;
+    path.u_path.swap(UPath);
+    path.v_row_path.swap(V_rowPath);
+    path.v_col_path.swap(V_colPath);
+    path.v_row_zero_inds.swap(v_row_zeros_path);
+    path.v_col_zero_inds.swap(v_col_zeros_path);
+    path.gamma_path.swap(gamma_path);
+    path.profile = profile;
+    path.trace = trace;
+
+    return path;
   }
 
   void tick(unsigned int iter){
-    sp.update(nzeros_row + nzeros_col,
-              V_row.squaredNorm() + V_col.squaredNorm(),
-              iter,
-              gamma);
+    if(sp.needs_v_norm()){
+      sp.set_v_norm(V_row.squaredNorm() + V_col.squaredNorm());
+    }
+    sp.update(nzeros_row + nzeros_col, iter, gamma);
   }
 
 private:
   // Fixed (non-data-dependent) problem details
-  const Eigen::MatrixXd& X; // Data matrix (to be clustered)
-  const Eigen::ArrayXXd& M; // Missing data mask
-  const Eigen::MatrixXd& D_row; // Edge (differencing) matrix
-  const Eigen::MatrixXd& D_col;
-  const Eigen::VectorXd& weights_row; // Clustering weights
-  const Eigen::VectorXd& weights_col;
-  const double rho; // ADMM relaxation parameter -- TODO: Factor this out?
-  double alpha;
+  const MatrixXs<Scalar>& X; // Data matrix (to be clustered)
+  const MissingMask<Scalar> missing; // Missing data mask
+  const SpMatrixXs<Scalar>& D_row; // Edge (differencing) matrix
+  const SpMatrixXs<Scalar>& D_col;
+  const VectorXs<Scalar>& weights_row; // Clustering weights
+  const VectorXs<Scalar>& weights_col;
+  const Scalar rho; // ADMM relaxation parameter -- TODO: Factor this out?
+  Scalar alpha;
   // Theoretically, it's part of the algorithm, not the problem
   // but we need it in the steps...
-  bool  l1;         // Is the L1 (true) or L2 (false) norm being used?
   const int n;      // Problem dimensions
   const int p;
   const int num_row_edges;
   const int num_col_edges;
+  const RowProxKernel<Scalar> row_prox; // Prox for the row fusion penalty, specialized to p
 
   // Progress printer
   StatusPrinter sp;
 
   // Current copies of ADMM variables
-  Eigen::MatrixXd U;     // Primal Variable
-  Eigen::MatrixXd V_row; // Split Variable - row subproblem
-  Eigen::MatrixXd Z_row; // Dual Variable - row subproblem
-  Eigen::MatrixXd V_col; // Split Variable - column subproblem
-  Eigen::MatrixXd Z_col; // Dual Variable - column subproblem
+  MatrixXs<Scalar> U;     // Primal Variable
+  MatrixXs<Scalar> V_row; // Split Variable - row subproblem
+  MatrixXs<Scalar> Z_row; // Dual Variable - row subproblem
+  MatrixXs<Scalar> V_col; // Split Variable - column subproblem
+  MatrixXs<Scalar> Z_col; // Dual Variable - column subproblem
+  MatrixXs<Scalar> imputation_buffer; // X with missing cells imputed (only used if X has missing values)
   Eigen::ArrayXi v_row_zeros; // Fusion indicators
   Eigen::ArrayXi v_col_zeros;
   Eigen::Index nzeros_row; // Fusion counts
   Eigen::Index nzeros_col;
 
   // Precomputed products that are reused in U-update
-  const Eigen::MatrixXd DDT_col; // D_col * D_col^T
-  const Eigen::MatrixXd DTD_row; // D_row^T * D_row
+  const SpMatrixXs<Scalar> DDT_col; // D_col * D_col^T
+  const SpMatrixXs<Scalar> DTD_row; // D_row^T * D_row
 
   // Old versions (used for back-tracking and fusion counting)
   Eigen::Index nzeros_row_old;
   Eigen::Index nzeros_col_old;
-  Eigen::MatrixXd U_old;
-  Eigen::MatrixXd V_row_old;
-  Eigen::MatrixXd Z_row_old;
-  Eigen::MatrixXd V_col_old;
-  Eigen::MatrixXd Z_col_old;
+  double last_u_change; // Scaled squared change in U at the last convergence check
+  MatrixXs<Scalar> U_old;
+  MatrixXs<Scalar> V_row_old;
+  MatrixXs<Scalar> Z_row_old;
+  MatrixXs<Scalar> V_col_old;
+  MatrixXs<Scalar> Z_col_old;
   Eigen::ArrayXi  v_row_zeros_old;
   Eigen::ArrayXi  v_col_zeros_old;
 
   // Internal storage buffers
   Eigen::Index buffer_size;
   Eigen::Index storage_index;
-  Eigen::MatrixXd UPath;
-  Eigen::MatrixXd V_rowPath;
-  Eigen::MatrixXd V_colPath;
+  MatrixXs<Scalar> UPath;
+  MatrixXs<Scalar> V_rowPath;
+  MatrixXs<Scalar> V_colPath;
   Eigen::VectorXd gamma_path;
   Eigen::MatrixXi v_row_zeros_path;
   Eigen::MatrixXi v_col_zeros_path;
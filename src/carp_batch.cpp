@@ -0,0 +1,146 @@
+#include "clustRviz.h"
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Batched CARP
+//
+// Solves many small, independent convex clustering problems in one call. All
+// conversion from and to R objects happens on the main thread; the solves
+// themselves are spread over an OpenMP thread pool with dynamic scheduling, so
+// that threads which finish their (small) problems pick up more work rather than
+// waiting on a fixed partition.
+//
+// The edge list and weights of each problem are extracted (once) while validating
+// its weight matrix on the main thread. Each thread keeps a workspace (the triplet
+// buffer and storage of the edge matrix D) which is re-used for every problem it
+// solves; there is no missing data, so no missingness mask is built.
+//
+// Exceptions must not escape the parallel region (and R errors can only be raised
+// from the main thread), so an error in any problem is caught on its worker thread,
+// stored with the problem and reported once all problems are done.
+
+struct CARPBatchWorkspace {
+  std::vector<Eigen::Triplet<double> > D_entries;
+  Eigen::SparseMatrix<double> D;
+};
+
+// [[Rcpp::export(rng = false)]]
+Rcpp::List CARPBatchcpp(Rcpp::List X_list,
+                        Rcpp::List weight_list,
+                        double epsilon,
+                        double t,
+                        double rho              = 1,
+                        double thresh           = CLUSTRVIZ_DEFAULT_STOP_PRECISION,
+                        int max_iter            = 100000,
+                        int max_inner_iter      = 2500,
+                        int burn_in             = 50,
+                        double back             = 0.5,
+                        int keep                = 10,
+                        int viz_max_inner_iter  = 15,
+                        double viz_initial_step = 1.1,
+                        double viz_small_step   = 1.01,
+                        bool l1                 = false,
+                        bool back_track         = false,
+                        bool exact              = false,
+                        int num_threads         = 0,
+                        int screen_interval     = 0){
+
+  const int num_problems = X_list.size();
+
+  if(weight_list.size() != num_problems){
+    ClustRVizLogger::error("X_list and weight_list must have the same length.");
+  }
+
+  // Copy everything out of R (and validate it) before we go parallel
+  std::vector<Eigen::MatrixXd> X(num_problems);
+  std::vector<Eigen::MatrixXi> edge_lists(num_problems);
+  std::vector<Eigen::VectorXd> weights(num_problems);
+
+  for(int k = 0; k < num_problems; k++){
+    X[k] = Rcpp::as<Eigen::MatrixXd>(X_list[k]);
+    const Eigen::MatrixXd W = Rcpp::as<Eigen::MatrixXd>(weight_list[k]);
+
+    if((W.rows() != X[k].rows()) || (W.cols() != X[k].rows())){
+      ClustRVizLogger::error("Weight matrix for problem ") << k + 1 << " must be " <<
+        X[k].rows() << "-by-" << X[k].rows() << ".";
+    }
+
+    weight_matrix_edges(W, edge_lists[k], weights[k]);
+
+    if(!edge_list_is_connected(edge_lists[k], X[k].rows())){
+      ClustRVizLogger::error("Weights for problem ") << k + 1 <<
+        " do not imply a connected graph. Clustering will not succeed.";
+    }
+  }
+
+  std::vector<ClusteringPath<double> > paths(num_problems);
+  std::vector<std::string> errors(num_problems);
+
+#ifdef _OPENMP
+  if(num_threads <= 0){
+    num_threads = omp_get_max_threads();
+  }
+#else
+  num_threads = 1;
+#endif
+
+  const Eigen::ArrayXXd no_missing; // An empty mask: no missing data (see MissingMask)
+
+  auto tic = std::chrono::steady_clock::now();
+
+#ifdef _OPENMP
+#pragma omp parallel num_threads(num_threads)
+#endif
+  {
+    CARPBatchWorkspace workspace;
+
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 1)
+#endif
+    for(int k = 0; k < num_problems; k++){
+      try {
+        incidence_matrix<double>(edge_lists[k], X[k].rows(), workspace.D_entries, workspace.D);
+
+        if(l1){
+          paths[k] = CARP_path<L1Norm, double>(X[k], no_missing, workspace.D, weights[k],
+                                               epsilon, t, rho, thresh, max_iter, max_inner_iter,
+                                               burn_in, back, keep, viz_max_inner_iter, viz_initial_step,
+                                               viz_small_step, false, back_track, exact, 0, screen_interval);
+        } else {
+          paths[k] = CARP_path<L2Norm, double>(X[k], no_missing, workspace.D, weights[k],
+                                               epsilon, t, rho, thresh, max_iter, max_inner_iter,
+                                               burn_in, back, keep, viz_max_inner_iter, viz_initial_step,
+                                               viz_small_step, false, back_track, exact, 0, screen_interval);
+        }
+      } catch(const std::exception& e){
+        errors[k] = e.what();
+        errors[k].erase(errors[k].find_last_not_of(" \n") + 1); // Logged errors end with a new line
+        if(errors[k].empty()){
+          errors[k] = "unknown error";
+        }
+      } catch(...){
+        errors[k] = "unknown error";
+      }
+    }
+  }
+
+  for(int k = 0; k < num_problems; k++){
+    if(!errors[k].empty()){
+      ClustRVizLogger::error("Problem ") << k + 1 << " failed: " << errors[k];
+    }
+  }
+
+  auto toc = std::chrono::steady_clock::now();
+  double elapsed = std::chrono::duration<double>(toc - tic).count();
+
+  Rcpp::List results(num_problems);
+  for(int k = 0; k < num_problems; k++){
+    results[k] = to_r(paths[k]);
+  }
+
+  return Rcpp::List::create(Rcpp::Named("paths")               = results,
+                            Rcpp::Named("elapsed")             = elapsed,
+                            Rcpp::Named("num_threads")         = num_threads,
+                            Rcpp::Named("problems_per_second") = num_problems / elapsed);
+}
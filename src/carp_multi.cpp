@@ -0,0 +1,83 @@
+#include "clustRviz.h"
+
+// Multi-data-set CARP
+//
+// Clusters several data sets which share observations and a weight graph (e.g.,
+// replicates or time slices) with a single ConvexClusteringMulti problem. The data
+// sets are passed in stacked column-wise, with block_sizes giving the number of
+// columns in each, and one path is returned per data set.
+template <class NORM, typename Scalar>
+Rcpp::List CARPMulti_impl(const Eigen::MatrixXd& X,
+                          const Eigen::ArrayXXd& M,
+                          const Eigen::MatrixXi& edge_list,
+                          const Eigen::VectorXd& weights,
+                          const Eigen::VectorXi& block_sizes,
+                          double epsilon,
+                          double t,
+                          double rho,
+                          double thresh,
+                          int max_iter,
+                          int max_inner_iter,
+                          int burn_in,
+                          double back,
+                          int keep,
+                          int viz_max_inner_iter,
+                          double viz_initial_step,
+                          double viz_small_step,
+                          bool show_progress,
+                          bool back_track,
+                          bool exact){
+
+  const MatrixXs<Scalar>& X_s       = X.template cast<Scalar>();
+  const ArrayXXs<Scalar>& M_s       = M.template cast<Scalar>();
+  const SpMatrixXs<Scalar> D_s       = incidence_matrix<Scalar>(from_r_edge_list(edge_list), X.rows());
+  const VectorXs<Scalar>& weights_s = weights.template cast<Scalar>();
+
+  ConvexClusteringMulti<NORM, Scalar> problem(X_s, M_s, D_s, weights_s, block_sizes, rho, show_progress);
+
+  return to_r(clustering_path(problem, epsilon, t, thresh, max_iter, max_inner_iter, burn_in, back, keep,
+                              viz_max_inner_iter, viz_initial_step, viz_small_step, back_track, exact));
+}
+
+// [[Rcpp::export(rng = false)]]
+Rcpp::List CARPMulticpp(const Eigen::MatrixXd& X,
+                        const Eigen::ArrayXXd& M,
+                        const Eigen::MatrixXi& edge_list,
+                        const Eigen::VectorXd& weights,
+                        const Eigen::VectorXi& block_sizes,
+                        double epsilon,
+                        double t,
+                        double rho              = 1,
+                        double thresh           = CLUSTRVIZ_DEFAULT_STOP_PRECISION,
+                        int max_iter            = 100000,
+                        int max_inner_iter      = 2500,
+                        int burn_in             = 50,
+                        double back             = 0.5,
+                        int keep                = 10,
+                        int viz_max_inner_iter  = 15,
+                        double viz_initial_step = 1.1,
+                        double viz_small_step   = 1.01,
+                        bool l1                 = false,
+                        bool show_progress      = true,
+                        bool back_track         = false,
+                        bool exact              = false,
+                        bool single_precision   = false){
+
+  if(single_precision){
+    if(l1){
+      return CARPMulti_impl<L1Norm, float>(X, M, edge_list, weights, block_sizes, epsilon, t, rho, thresh, max_iter, max_inner_iter, burn_in,
+                                           back, keep, viz_max_inner_iter, viz_initial_step, viz_small_step, show_progress, back_track, exact);
+    } else {
+      return CARPMulti_impl<L2Norm, float>(X, M, edge_list, weights, block_sizes, epsilon, t, rho, thresh, max_iter, max_inner_iter, burn_in,
+                                           back, keep, viz_max_inner_iter, viz_initial_step, viz_small_step, show_progress, back_track, exact);
+    }
+  }
+
+  if(l1){
+    return CARPMulti_impl<L1Norm, double>(X, M, edge_list, weights, block_sizes, epsilon, t, rho, thresh, max_iter, max_inner_iter, burn_in,
+                                          back, keep, viz_max_inner_iter, viz_initial_step, viz_small_step, show_progress, back_track, exact);
+  } else {
+    return CARPMulti_impl<L2Norm, double>(X, M, edge_list, weights, block_sizes, epsilon, t, rho, thresh, max_iter, max_inner_iter, burn_in,
+                                          back, keep, viz_max_inner_iter, viz_initial_step, viz_small_step, show_progress, back_track, exact);
+  }
+}
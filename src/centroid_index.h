@@ -0,0 +1,199 @@
+#ifndef CLUSTRVIZ_CENTROID_INDEX_H
+#define CLUSTRVIZ_CENTROID_INDEX_H 1
+
+#include "clustRviz_base.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+// Nearest-centroid search for out-of-sample cluster assignment
+//
+// A fitted (smoothed) CARP path is stored as the cluster centroids of each distinct
+// partition (see smooth_u_centroids), so a new observation is assigned to a cluster
+// of a given partition by finding its nearest centroid. The centroids of a partition
+// are organized in a kd-tree: each node splits its centroids at the median of the
+// coordinate with the largest spread, down to leaves of at most LEAF_SIZE centroids.
+// A query descends to the leaf containing it first and only visits the other side of
+// a split if the splitting plane is closer than the best centroid found so far, which
+// is sublinear in the number of clusters unless p is large relative to it.
+//
+// Centroids are stored column-wise (one column per centroid) in tree order, so leaves
+// are scanned contiguously. Queries are independent, so a batch is assigned in
+// parallel (see assign).
+class CentroidIndex {
+public:
+  static const Eigen::Index LEAF_SIZE = 8;
+
+  explicit CentroidIndex(const Eigen::MatrixXd& centroids):
+    p(centroids.cols()),
+    points(centroids.transpose()),
+    ids(centroids.rows()) {
+
+    if(centroids.rows() == 0){
+      ClustRVizLogger::error("Cannot build a centroid index without any centroids.");
+    }
+
+    for(Eigen::Index k = 0; k < centroids.rows(); k++){
+      ids[k] = k;
+    }
+    build();
+
+    // Reorder the centroids to match the tree
+    Eigen::MatrixXd ordered(p, ids.size());
+    for(std::size_t k = 0; k < ids.size(); k++){
+      ordered.col(k) = centroids.row(ids[k]).transpose();
+    }
+    points.swap(ordered);
+  }
+
+  Eigen::Index size() const {
+    return points.cols();
+  }
+
+  // Index (row of the centroid matrix) of the centroid nearest to x (of length p) and
+  // the squared distance to it
+  Eigen::Index nearest(const double* x, double& best_distance) const {
+    Eigen::Map<const Eigen::VectorXd> query(x, p);
+
+    Eigen::Index best = -1;
+    best_distance = std::numeric_limits<double>::infinity();
+
+    // Pending far sides, with the squared distance to their splitting plane
+    std::vector<std::pair<double, Eigen::Index> > stack;
+    stack.reserve(64);
+    stack.push_back(std::make_pair(0.0, static_cast<Eigen::Index>(0)));
+
+    while(!stack.empty()){
+      const double plane_distance = stack.back().first;
+      Eigen::Index node = stack.back().second;
+      stack.pop_back();
+
+      if(plane_distance >= best_distance){
+        continue;
+      }
+
+      // Descend to a leaf, remembering the far side of each split
+      while(nodes[node].split_dim >= 0){
+        const Node& split = nodes[node];
+        const double diff = x[split.split_dim] - split.split_value;
+        const Eigen::Index near_child = (diff <= 0) ? split.left : split.right;
+        const Eigen::Index far_child  = (diff <= 0) ? split.right : split.left;
+        stack.push_back(std::make_pair(diff * diff, far_child));
+        node = near_child;
+      }
+
+      for(Eigen::Index k = nodes[node].begin; k < nodes[node].end; k++){
+        const double distance = (points.col(k) - query).squaredNorm();
+        if(distance < best_distance){
+          best_distance = distance;
+          best = k;
+        }
+      }
+    }
+
+    return ids[best];
+  }
+
+  // Nearest centroid (row index) and Euclidean distance to it for each row of X
+  void assign(const Eigen::MatrixXd& X, Eigen::VectorXi& nearest_ids, Eigen::VectorXd& distances) const {
+    if(X.cols() != p){
+      ClustRVizLogger::error("New observations must have the same number of columns as the centroids.");
+    }
+
+    const Eigen::Index n = X.rows();
+    const Eigen::MatrixXd Xt = X.transpose(); // Rows of X, contiguously
+    nearest_ids.resize(n);
+    distances.resize(n);
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 64)
+#endif
+    for(Eigen::Index i = 0; i < n; i++){
+      double distance;
+      nearest_ids(i) = nearest(Xt.col(i).data(), distance);
+      distances(i)   = std::sqrt(distance);
+    }
+  }
+
+private:
+  // Internal nodes have split_dim >= 0 and children; leaves hold centroids begin to end - 1
+  struct Node {
+    Eigen::Index begin;
+    Eigen::Index end;
+    int split_dim;
+    double split_value;
+    Eigen::Index left;
+    Eigen::Index right;
+  };
+
+  const Eigen::Index p;
+  Eigen::MatrixXd points;         // Centroids (one per column); in tree order after build()
+  std::vector<Eigen::Index> ids;  // Original index of each centroid, in tree order
+  std::vector<Node> nodes;        // nodes[0] is the root
+
+  // Builds the tree over ids (points still in their original order)
+  void build(){
+    nodes.reserve(2 * (ids.size() / LEAF_SIZE) + 1);
+    nodes.push_back(make_leaf(0, ids.size()));
+
+    std::vector<Eigen::Index> pending(1, 0);
+    while(!pending.empty()){
+      const Eigen::Index node = pending.back();
+      pending.pop_back();
+
+      const Eigen::Index begin = nodes[node].begin;
+      const Eigen::Index end   = nodes[node].end;
+      if(end - begin <= LEAF_SIZE){
+        continue;
+      }
+
+      // Split on the coordinate with the largest spread
+      int split_dim = 0;
+      double max_spread = -1;
+      for(Eigen::Index j = 0; j < p; j++){
+        double lo = points(j, ids[begin]), hi = lo;
+        for(Eigen::Index k = begin + 1; k < end; k++){
+          lo = std::min(lo, points(j, ids[k]));
+          hi = std::max(hi, points(j, ids[k]));
+        }
+        if(hi - lo > max_spread){
+          max_spread = hi - lo;
+          split_dim  = j;
+        }
+      }
+      if(max_spread <= 0){
+        continue; // All centroids coincide: keep a (large) leaf
+      }
+
+      const Eigen::Index mid = begin + (end - begin) / 2;
+      std::nth_element(ids.begin() + begin, ids.begin() + mid, ids.begin() + end,
+                       [&](Eigen::Index a, Eigen::Index b){ return points(split_dim, a) < points(split_dim, b); });
+
+      // Centroids left of mid are <= the split value and those from mid on are >= it,
+      // so queries on the plane can go either way
+      nodes[node].split_dim   = split_dim;
+      nodes[node].split_value = points(split_dim, ids[mid]);
+      nodes[node].left        = nodes.size();
+      nodes.push_back(make_leaf(begin, mid));
+      nodes[node].right       = nodes.size();
+      nodes.push_back(make_leaf(mid, end));
+
+      pending.push_back(nodes[node].left);
+      pending.push_back(nodes[node].right);
+    }
+  }
+
+  static Node make_leaf(Eigen::Index begin, Eigen::Index end){
+    Node node;
+    node.begin       = begin;
+    node.end         = end;
+    node.split_dim   = -1;
+    node.split_value = 0;
+    node.left        = -1;
+    node.right       = -1;
+    return node;
+  }
+};
+
+#endif
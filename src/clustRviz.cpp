@@ -1,9 +1,202 @@
 #include "clustRviz.h"
 
+// The norm and scalar type are template parameters of the problem classes (so the
+// prox operators can be specialized at compile time), so the exported functions
+// below just pick the right instantiation once and hand off to these implementations
+//
+// The problem classes hold references to their inputs, so single precision copies
+// are made here and kept alive for the duration of the solve. (In double precision,
+// cast<double>() is a no-op returning a reference to the original.)
+//
+// Graphs are passed in from R as (one-based) edge lists, which are turned into
+// sparse edge (differencing) matrices here: the row (column) edge matrix of
+// CBASS is E_r-by-n (p-by-E_c) as before.
+template <class NORM, typename Scalar>
+Rcpp::List CARP_impl(const Eigen::MatrixXd& X,
+                     const Eigen::ArrayXXd& M,
+                     const Eigen::MatrixXi& edge_list,
+                     const Eigen::VectorXd& weights,
+                     double epsilon,
+                     double t,
+                     double rho,
+                     double thresh,
+                     int max_iter,
+                     int max_inner_iter,
+                     int burn_in,
+                     double back,
+                     int keep,
+                     int viz_max_inner_iter,
+                     double viz_initial_step,
+                     double viz_small_step,
+                     bool show_progress,
+                     bool back_track,
+                     bool exact,
+                     int trace_length,
+                     int screen_interval){
+
+  const MatrixXs<Scalar>& X_s       = X.template cast<Scalar>();
+  const ArrayXXs<Scalar>& M_s       = M.template cast<Scalar>();
+  const SpMatrixXs<Scalar> D_s       = incidence_matrix<Scalar>(from_r_edge_list(edge_list), X.rows());
+  const VectorXs<Scalar>& weights_s = weights.template cast<Scalar>();
+
+  return to_r(CARP_path<NORM, Scalar>(X_s, M_s, D_s, weights_s, epsilon, t, rho, thresh, max_iter, max_inner_iter,
+                                      burn_in, back, keep, viz_max_inner_iter, viz_initial_step, viz_small_step,
+                                      show_progress, back_track, exact, trace_length, screen_interval));
+}
+
+// Collapsed rows (see row_collapse.h): row_groups gives the group of each row of X
+// (zero-based) and the edge list joins groups. The problem is solved on the group
+// means with multiplicity weights, and the path is returned for the original rows,
+// along with the (one-based) edge list it refers to
+template <class NORM, typename Scalar>
+Rcpp::List CARP_collapsed_impl(const Eigen::MatrixXd& X,
+                               const Eigen::ArrayXXd& M,
+                               const Eigen::MatrixXi& edge_list,
+                               const Eigen::VectorXd& weights,
+                               const Eigen::VectorXi& row_groups,
+                               double epsilon,
+                               double t,
+                               double rho,
+                               double thresh,
+                               int max_iter,
+                               int max_inner_iter,
+                               int burn_in,
+                               double back,
+                               int keep,
+                               int viz_max_inner_iter,
+                               double viz_initial_step,
+                               double viz_small_step,
+                               bool show_progress,
+                               bool back_track,
+                               bool exact,
+                               int trace_length,
+                               int screen_interval){
+  if((M != 1).any()){
+    ClustRVizLogger::error("Rows with missing data cannot be collapsed.");
+  }
+
+  const RowCollapse collapse    = collapse_rows_by_group(X, row_groups);
+  const Eigen::MatrixXi E       = from_r_edge_list(edge_list);
+  if((E.array() < 0).any() || (E.array() >= collapse.num_groups()).any()){
+    ClustRVizLogger::error("The edge list must join groups of collapsed rows.");
+  }
+
+  const MatrixXs<Scalar>& X_s       = X.template cast<Scalar>();
+  const MatrixXs<Scalar> X_groups   = collapse.X.template cast<Scalar>();
+  const ArrayXXs<Scalar> M_groups   = ArrayXXs<Scalar>::Ones(collapse.num_groups(), X.cols());
+  const SpMatrixXs<Scalar> D_s       = incidence_matrix<Scalar>(E, collapse.num_groups());
+  const VectorXs<Scalar>& weights_s = weights.template cast<Scalar>();
+  const VectorXs<Scalar> m_s        = collapse.multiplicity.template cast<Scalar>();
+
+  ConvexClustering<NORM, Scalar> problem(X_groups, M_groups, D_s, weights_s, rho, show_progress, std::string(), m_s);
+  problem.trace = SolverTrace(trace_length);
+  problem.set_screen_interval(screen_interval);
+  const ClusteringPath<Scalar> path = clustering_path(problem, epsilon, t, thresh, max_iter, max_inner_iter, burn_in,
+                                                      back, keep, viz_max_inner_iter, viz_initial_step,
+                                                      viz_small_step, back_track, exact);
+
+  Eigen::VectorXi source;
+  const Eigen::MatrixXi expanded_edges = expanded_edge_list(collapse, E, source);
+
+  Rcpp::List result = to_r(expand_clustering_path(path, collapse, X_s, expanded_edges, source));
+  result.push_back(Eigen::MatrixXi(expanded_edges.array() + 1), "edge_list");
+  return result;
+}
+
+// Exact L1 path on a tree (see tree_path.h)
+template <typename Scalar>
+Rcpp::List CARP_tree_path_impl(const Eigen::MatrixXd& X,
+                               const Eigen::ArrayXXd& M,
+                               const Eigen::MatrixXi& edge_list,
+                               const Eigen::VectorXd& weights){
+  if((M != 1).any()){
+    ClustRVizLogger::error("The exact L1 path does not support missing data.");
+  }
+
+  const MatrixXs<Scalar>& X_s       = X.template cast<Scalar>();
+  const SpMatrixXs<Scalar> D_s       = incidence_matrix<Scalar>(from_r_edge_list(edge_list), X.rows());
+  const VectorXs<Scalar>& weights_s = weights.template cast<Scalar>();
+
+  ExactTreePathPolicy<Scalar> tree_path(X_s, D_s, weights_s);
+  return to_r(tree_path.extract_path());
+}
+
+template <class NORM, typename Scalar>
+Rcpp::List CBASS_impl(const Eigen::MatrixXd& X,
+                      const Eigen::ArrayXXd& M,
+                      const Eigen::MatrixXi& row_edge_list,
+                      const Eigen::MatrixXi& col_edge_list,
+                      const Eigen::VectorXd& weights_row,
+                      const Eigen::VectorXd& weights_col,
+                      double epsilon,
+                      double t,
+                      double thresh,
+                      double rho,
+                      int max_iter,
+                      int max_inner_iter,
+                      int burn_in,
+                      double back,
+                      int keep,
+                      int viz_max_inner_iter,
+                      double viz_initial_step,
+                      double viz_small_step,
+                      bool show_progress,
+                      bool back_track,
+                      bool exact,
+                      int trace_length){
+
+  const MatrixXs<Scalar>& X_s           = X.template cast<Scalar>();
+  const ArrayXXs<Scalar>& M_s           = M.template cast<Scalar>();
+  const SpMatrixXs<Scalar> D_row_s      = incidence_matrix<Scalar>(from_r_edge_list(row_edge_list), X.rows());
+  const SpMatrixXs<Scalar> D_col_s      = incidence_matrix<Scalar>(from_r_edge_list(col_edge_list), X.cols()).transpose();
+  const VectorXs<Scalar>& weights_row_s = weights_row.template cast<Scalar>();
+  const VectorXs<Scalar>& weights_col_s = weights_col.template cast<Scalar>();
+
+  ConvexBiClustering<NORM, Scalar> problem(X_s, M_s, D_row_s, D_col_s, weights_row_s, weights_col_s, rho, show_progress);
+  problem.trace = SolverTrace(trace_length);
+
+  if(exact){
+    if(back_track){
+      ConvexBiClusteringADMM_VIZ<NORM, Scalar> admm_viz(problem,
+                                                        epsilon,
+                                                        thresh,
+                                                        max_iter,
+                                                        max_inner_iter,
+                                                        burn_in,
+                                                        back,
+                                                        viz_max_inner_iter,
+                                                        viz_initial_step,
+                                                        viz_small_step);
+
+      return to_r(admm_viz.extract_path());
+    } else {
+      ConvexBiClusteringADMM<NORM, Scalar> admm(problem, epsilon, t, thresh, max_iter, max_inner_iter);
+      return to_r(admm.extract_path());
+    }
+  } else {
+    if(back_track){
+      CBASS_VIZ<NORM, Scalar> cbass_viz(problem,
+                                        epsilon,
+                                        max_iter,
+                                        burn_in,
+                                        back,
+                                        keep,
+                                        viz_max_inner_iter,
+                                        viz_initial_step,
+                                        viz_small_step);
+
+      return to_r(cbass_viz.extract_path());
+    }
+
+    CBASS<NORM, Scalar> cbass(problem, epsilon, t, max_iter, burn_in, keep);
+    return to_r(cbass.extract_path());
+  }
+}
+
 // [[Rcpp::export(rng = false)]]
 Rcpp::List CARPcpp(const Eigen::MatrixXd& X,
                    const Eigen::ArrayXXd& M,
-                   const Eigen::MatrixXd& D,
+                   const Eigen::MatrixXi& edge_list,
                    const Eigen::VectorXd& weights,
                    double epsilon,
                    double t,
@@ -20,53 +213,79 @@ Rcpp::List CARPcpp(const Eigen::MatrixXd& X,
                    bool l1                 = false,
                    bool show_progress      = true,
                    bool back_track         = false,
-                   bool exact              = false){
-
-  ConvexClustering problem(X, M, D, weights, rho, l1, show_progress);
+                   bool exact              = false,
+                   bool tree_path          = false,
+                   bool single_precision   = false,
+                   Rcpp::IntegerVector row_groups = Rcpp::IntegerVector(),
+                   int trace_length        = 0,
+                   int screen_interval     = 0){
 
-  if(exact){
-    if(back_track){
-      ConvexClusteringADMM_VIZ admm_viz(problem,
-                                        epsilon,
-                                        thresh,
-                                        max_iter,
-                                        max_inner_iter,
-                                        burn_in,
-                                        back,
-                                        viz_max_inner_iter,
-                                        viz_initial_step,
-                                        viz_small_step);
+  if(row_groups.size() > 0){
+    if(tree_path){
+      ClustRVizLogger::error("The exact tree path does not support collapsed rows.");
+    }
 
-      return admm_viz.build_return_object();
+    const Eigen::VectorXi groups = Rcpp::as<Eigen::VectorXi>(row_groups).array() - 1;
+    if(single_precision){
+      if(l1){
+        return CARP_collapsed_impl<L1Norm, float>(X, M, edge_list, weights, groups, epsilon, t, rho, thresh, max_iter, max_inner_iter,
+                                                  burn_in, back, keep, viz_max_inner_iter, viz_initial_step, viz_small_step,
+                                                  show_progress, back_track, exact, trace_length, screen_interval);
+      } else {
+        return CARP_collapsed_impl<L2Norm, float>(X, M, edge_list, weights, groups, epsilon, t, rho, thresh, max_iter, max_inner_iter,
+                                                  burn_in, back, keep, viz_max_inner_iter, viz_initial_step, viz_small_step,
+                                                  show_progress, back_track, exact, trace_length, screen_interval);
+      }
+    }
+    if(l1){
+      return CARP_collapsed_impl<L1Norm, double>(X, M, edge_list, weights, groups, epsilon, t, rho, thresh, max_iter, max_inner_iter,
+                                                 burn_in, back, keep, viz_max_inner_iter, viz_initial_step, viz_small_step,
+                                                 show_progress, back_track, exact, trace_length, screen_interval);
     } else {
-      ConvexClusteringADMM admm(problem, epsilon, t, thresh, max_iter, max_inner_iter);
-      return admm.build_return_object();
+      return CARP_collapsed_impl<L2Norm, double>(X, M, edge_list, weights, groups, epsilon, t, rho, thresh, max_iter, max_inner_iter,
+                                                 burn_in, back, keep, viz_max_inner_iter, viz_initial_step, viz_small_step,
+                                                 show_progress, back_track, exact, trace_length, screen_interval);
     }
-  } else {
-    if(back_track){
-      CARP_VIZ carp_viz(problem,
-                        epsilon,
-                        max_iter,
-                        burn_in,
-                        back,
-                        keep,
-                        viz_max_inner_iter,
-                        viz_initial_step,
-                        viz_small_step);
-
-      return carp_viz.build_return_object();
+  }
+
+  if(tree_path){
+    if(!l1){
+      ClustRVizLogger::error("The exact tree path is only available for the L1 norm.");
     }
+    if(single_precision){
+      return CARP_tree_path_impl<float>(X, M, edge_list, weights);
+    }
+    return CARP_tree_path_impl<double>(X, M, edge_list, weights);
+  }
+
+  if(single_precision){
+    if(l1){
+      return CARP_impl<L1Norm, float>(X, M, edge_list, weights, epsilon, t, rho, thresh, max_iter, max_inner_iter, burn_in, back, keep,
+                                      viz_max_inner_iter, viz_initial_step, viz_small_step, show_progress, back_track, exact,
+                                      trace_length, screen_interval);
+    } else {
+      return CARP_impl<L2Norm, float>(X, M, edge_list, weights, epsilon, t, rho, thresh, max_iter, max_inner_iter, burn_in, back, keep,
+                                      viz_max_inner_iter, viz_initial_step, viz_small_step, show_progress, back_track, exact,
+                                      trace_length, screen_interval);
+    }
+  }
 
-    CARP carp(problem, epsilon, t, max_iter, burn_in, keep);
-    return carp.build_return_object();
+  if(l1){
+    return CARP_impl<L1Norm, double>(X, M, edge_list, weights, epsilon, t, rho, thresh, max_iter, max_inner_iter, burn_in, back, keep,
+                                     viz_max_inner_iter, viz_initial_step, viz_small_step, show_progress, back_track, exact,
+                                     trace_length, screen_interval);
+  } else {
+    return CARP_impl<L2Norm, double>(X, M, edge_list, weights, epsilon, t, rho, thresh, max_iter, max_inner_iter, burn_in, back, keep,
+                                     viz_max_inner_iter, viz_initial_step, viz_small_step, show_progress, back_track, exact,
+                                     trace_length, screen_interval);
   }
 }
 
 // [[Rcpp::export(rng = false)]]
 Rcpp::List CBASScpp(const Eigen::MatrixXd& X,
                     const Eigen::ArrayXXd& M,
-                    const Eigen::MatrixXd& D_row,
-                    const Eigen::MatrixXd& D_col,
+                    const Eigen::MatrixXi& row_edge_list,
+                    const Eigen::MatrixXi& col_edge_list,
                     const Eigen::VectorXd& weights_row,
                     const Eigen::VectorXd& weights_col,
                     double epsilon,
@@ -84,52 +303,37 @@ Rcpp::List CBASScpp(const Eigen::MatrixXd& X,
                     bool l1                 = false,
                     bool show_progress      = true,
                     bool back_track         = false,
-                    bool exact              = false){
-
-  ConvexBiClustering problem(X, M, D_row, D_col, weights_row, weights_col, rho, l1, show_progress);
+                    bool exact              = false,
+                    bool single_precision   = false,
+                    int trace_length        = 0){
 
-  if(exact){
-    if(back_track){
-      ConvexBiClusteringADMM_VIZ admm_viz(problem,
-                                          epsilon,
-                                          thresh,
-                                          max_iter,
-                                          max_inner_iter,
-                                          burn_in,
-                                          back,
-                                          viz_max_inner_iter,
-                                          viz_initial_step,
-                                          viz_small_step);
-
-      return admm_viz.build_return_object();
+  if(single_precision){
+    if(l1){
+      return CBASS_impl<L1Norm, float>(X, M, row_edge_list, col_edge_list, weights_row, weights_col, epsilon, t, thresh, rho, max_iter, max_inner_iter,
+                                       burn_in, back, keep, viz_max_inner_iter, viz_initial_step, viz_small_step, show_progress,
+                                       back_track, exact, trace_length);
     } else {
-      ConvexBiClusteringADMM admm(problem, epsilon, t, thresh, max_iter, max_inner_iter);
-      return admm.build_return_object();
-    }
-  } else {
-    if(back_track){
-      CBASS_VIZ cbass_viz(problem,
-                          epsilon,
-                          max_iter,
-                          burn_in,
-                          back,
-                          keep,
-                          viz_max_inner_iter,
-                          viz_initial_step,
-                          viz_small_step);
-
-      return cbass_viz.build_return_object();
+      return CBASS_impl<L2Norm, float>(X, M, row_edge_list, col_edge_list, weights_row, weights_col, epsilon, t, thresh, rho, max_iter, max_inner_iter,
+                                       burn_in, back, keep, viz_max_inner_iter, viz_initial_step, viz_small_step, show_progress,
+                                       back_track, exact, trace_length);
     }
+  }
 
-    CBASS cbass(problem, epsilon, t, max_iter, burn_in, keep);
-    return cbass.build_return_object();
+  if(l1){
+    return CBASS_impl<L1Norm, double>(X, M, row_edge_list, col_edge_list, weights_row, weights_col, epsilon, t, thresh, rho, max_iter, max_inner_iter,
+                                      burn_in, back, keep, viz_max_inner_iter, viz_initial_step, viz_small_step, show_progress,
+                                      back_track, exact, trace_length);
+  } else {
+    return CBASS_impl<L2Norm, double>(X, M, row_edge_list, col_edge_list, weights_row, weights_col, epsilon, t, thresh, rho, max_iter, max_inner_iter,
+                                      burn_in, back, keep, viz_max_inner_iter, viz_initial_step, viz_small_step, show_progress,
+                                      back_track, exact, trace_length);
   }
 }
 
 // [[Rcpp::export(rng = false)]]
 Rcpp::List ConvexClusteringCPP(const Eigen::MatrixXd& X,
                                const Eigen::ArrayXXd& M,
-                               const Eigen::MatrixXd& D,
+                               const Eigen::MatrixXi& edge_list,
                                const Eigen::VectorXd& weights,
                                const std::vector<double> lambda_grid,
                                double rho         = 1,
@@ -137,19 +341,30 @@ Rcpp::List ConvexClusteringCPP(const Eigen::MatrixXd& X,
                                int max_iter       = 100000,
                                int max_inner_iter = 2500,
                                bool l1            = false,
-                               bool show_progress = true){
+                               bool show_progress = true,
+                               std::string path_file = "",
+                               int screen_interval = 0){
 
-  ConvexClustering problem(X, M, D, weights, rho, l1, show_progress);
-  UserGridConvexClusteringADMM solver(problem, lambda_grid, thresh, max_iter, max_inner_iter);
+  const SpMatrixXs<double> D = incidence_matrix<double>(from_r_edge_list(edge_list), X.rows());
 
-  return solver.build_return_object();
+  if(l1){
+    ConvexClustering<L1Norm, double> problem(X, M, D, weights, rho, show_progress, path_file);
+    problem.set_screen_interval(screen_interval);
+    UserGridConvexClusteringADMM<L1Norm, double> solver(problem, lambda_grid, thresh, max_iter, max_inner_iter);
+    return to_r(solver.extract_path());
+  } else {
+    ConvexClustering<L2Norm, double> problem(X, M, D, weights, rho, show_progress, path_file);
+    problem.set_screen_interval(screen_interval);
+    UserGridConvexClusteringADMM<L2Norm, double> solver(problem, lambda_grid, thresh, max_iter, max_inner_iter);
+    return to_r(solver.extract_path());
+  }
 }
 
 // [[Rcpp::export(rng = false)]]
 Rcpp::List ConvexBiClusteringCPP(const Eigen::MatrixXd& X,
                                  const Eigen::ArrayXXd& M,
-                                 const Eigen::MatrixXd& D_row,
-                                 const Eigen::MatrixXd& D_col,
+                                 const Eigen::MatrixXi& row_edge_list,
+                                 const Eigen::MatrixXi& col_edge_list,
                                  const Eigen::VectorXd& weights_row,
                                  const Eigen::VectorXd& weights_col,
                                  const std::vector<double> lambda_grid,
@@ -160,8 +375,16 @@ Rcpp::List ConvexBiClusteringCPP(const Eigen::MatrixXd& X,
                                  bool l1            = false,
                                  bool show_progress = true){
 
-  ConvexBiClustering problem(X, M, D_row, D_col, weights_row, weights_col, rho, l1, show_progress);
-  UserGridConvexBiClusteringADMM solver(problem, lambda_grid, thresh, max_iter, max_inner_iter);
+  const SpMatrixXs<double> D_row = incidence_matrix<double>(from_r_edge_list(row_edge_list), X.rows());
+  const SpMatrixXs<double> D_col = incidence_matrix<double>(from_r_edge_list(col_edge_list), X.cols()).transpose();
 
-  return solver.build_return_object();
+  if(l1){
+    ConvexBiClustering<L1Norm, double> problem(X, M, D_row, D_col, weights_row, weights_col, rho, show_progress);
+    UserGridConvexBiClusteringADMM<L1Norm, double> solver(problem, lambda_grid, thresh, max_iter, max_inner_iter);
+    return to_r(solver.extract_path());
+  } else {
+    ConvexBiClustering<L2Norm, double> problem(X, M, D_row, D_col, weights_row, weights_col, rho, show_progress);
+    UserGridConvexBiClusteringADMM<L2Norm, double> solver(problem, lambda_grid, thresh, max_iter, max_inner_iter);
+    return to_r(solver.extract_path());
+  }
 }
@@ -1,17 +1,11 @@
-#include "clustRviz_base.h"
-#include "clustRviz_logging.h"
-#include "clustering_impl.h"
-#include "biclustering_impl.h"
-#include "alg_reg_policies.h"
-#include "optim_policies.h"
+#ifndef CLUSTRVIZ_H
+#define CLUSTRVIZ_H 1
 
-typedef AlgorithmicRegularizationFixedStepSizePolicy<ConvexClustering> CARP;
-typedef AlgorithmicRegularizationBacktrackingPolicy<ConvexClustering> CARP_VIZ;
-typedef AlgorithmicRegularizationFixedStepSizePolicy<ConvexBiClustering> CBASS;
-typedef AlgorithmicRegularizationBacktrackingPolicy<ConvexBiClustering> CBASS_VIZ;
-typedef ADMMPolicy<ConvexClustering> ConvexClusteringADMM;
-typedef ADMMPolicy<ConvexBiClustering> ConvexBiClusteringADMM;
-typedef BackTrackingADMMPolicy<ConvexClustering> ConvexClusteringADMM_VIZ;
-typedef BackTrackingADMMPolicy<ConvexBiClustering> ConvexBiClusteringADMM_VIZ;
-typedef UserGridADMMPolicy<ConvexClustering> UserGridConvexClusteringADMM;
-typedef UserGridADMMPolicy<ConvexBiClustering> UserGridConvexBiClusteringADMM;
+// R interface to the solver core: the exported functions in this package
+// convert their arguments from R, call into the core (clustRviz_core.h) and
+// convert the results back with the helpers in r_adapter.h
+#include <RcppEigen.h>
+#include "clustRviz_core.h"
+#include "r_adapter.h"
+
+#endif
@@ -1,13 +1,35 @@
 #ifndef CLUSTRVIZ_BASE_H
 #define CLUSTRVIZ_BASE_H 1
 
-#include <RcppEigen.h>
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+#include <cmath>
 #include <vector>
 #include <set>
+#include <limits>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #define CLUSTRVIZ_STATUS_UPDATE_TIME_SECS 0.1  // Print status to screen every 0.1s
 #define CLUSTRVIZ_STATUS_WIDTH_CHECK 20        // Every 20 status updates * 0.1s => every 2s
+#define CLUSTRVIZ_INTERRUPT_CHECK_TICKS 64     // Without a status line, read the clock every 64 ticks
 #define CLUSTRVIZ_DEFAULT_STOP_PRECISION 1e-10 //Stop when cellwise diff between iters < val
+#define CLUSTRVIZ_DISTANCE_BLOCK_SIZE 256      // Rows per block when computing pairwise distances
+
+// Are we running inside an OpenMP parallel region?
+//
+// The host (e.g., R) API is generally not thread-safe, so code which might run on a
+// worker thread (logging, progress printing, interrupt checks) uses this to skip
+// calling the host hooks (see clustRviz_hooks.h)
+inline bool in_parallel_region(){
+#ifdef _OPENMP
+  return omp_in_parallel();
+#else
+  return false;
+#endif
+}
 
 // Helper to determine if STL set contains an element
 //
@@ -19,17 +41,160 @@ bool contains(const std::set<T>& container, T element){
   return it != container.end();
 }
 
-// Prototypes - utils.cpp
-Eigen::MatrixXd MatrixRowProx(const Eigen::MatrixXd&,
-                              double,
-                              const Eigen::VectorXd&,
-                              bool);
+// Dense Eigen types parameterized on the scalar type used by the solvers
+// (double by default, or float for the single precision mode)
+template <typename Scalar> using MatrixXs = Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>;
+template <typename Scalar> using VectorXs = Eigen::Matrix<Scalar, Eigen::Dynamic, 1>;
+template <typename Scalar> using ArrayXXs = Eigen::Array<Scalar, Eigen::Dynamic, Eigen::Dynamic>;
+template <typename Scalar> using SpMatrixXs = Eigen::SparseMatrix<Scalar>;
+
+// Edge-incidence (differencing) matrix of a graph on n vertices
+//
+// Row e of D is e_i - e_j for the e-th edge (i, j) of edge_list (zero-based
+// vertex indices), so that D * U gives the differences U_i - U_j directly and
+// D^T * D is the graph Laplacian
+//
+// The second form builds D in place, using (and keeping the capacity of) the given
+// triplet buffer, for callers which build many incidence matrices (see carp_batch.cpp)
+template <typename Scalar>
+void incidence_matrix(const Eigen::MatrixXi& edge_list,
+                      Eigen::Index n,
+                      std::vector<Eigen::Triplet<Scalar> >& entries,
+                      SpMatrixXs<Scalar>& D){
+  const Eigen::Index num_edges = edge_list.rows();
+
+  entries.clear();
+  entries.reserve(2 * num_edges);
+  for(Eigen::Index e = 0; e < num_edges; e++){
+    entries.push_back(Eigen::Triplet<Scalar>(e, edge_list(e, 0),  1));
+    entries.push_back(Eigen::Triplet<Scalar>(e, edge_list(e, 1), -1));
+  }
+
+  D.resize(num_edges, n);
+  D.setFromTriplets(entries.begin(), entries.end());
+}
+
+template <typename Scalar>
+SpMatrixXs<Scalar> incidence_matrix(const Eigen::MatrixXi& edge_list, Eigen::Index n){
+  std::vector<Eigen::Triplet<Scalar> > entries;
+  SpMatrixXs<Scalar> D;
+  incidence_matrix(edge_list, n, entries, D);
+  return D;
+}
+
+// Convert an (n_edges-by-2, one-based) edge list from R to the zero-based form used internally
+inline Eigen::MatrixXi from_r_edge_list(const Eigen::MatrixXi& edge_list){
+  return edge_list.array() - 1;
+}
+
+// Missing data mask
+//
+// The mask M (1 for observed cells, 0 for missing cells) is stored as a list of the
+// cells with M != 1, so that the imputation step of the U-update
+//
+//   X_imputed = M * X + (1 - M) * U
+//
+// only touches those cells: with no missing data, X is used directly, and otherwise
+// X is copied into a (re-used) buffer on first use and only the missing cells are
+// overwritten at each step. (A buffer must therefore only be used with one X.)
+template <typename Scalar>
+class MissingMask {
+public:
+  explicit MissingMask(const ArrayXXs<Scalar>& M){
+    for(Eigen::Index j = 0; j < M.cols(); j++){
+      for(Eigen::Index i = 0; i < M.rows(); i++){
+        if(M(i, j) != 1){
+          rows.push_back(i);
+          cols.push_back(j);
+          weights.push_back(M(i, j));
+        }
+      }
+    }
+  }
+
+  bool empty() const {
+    return rows.empty();
+  }
+
+  std::size_t size() const {
+    return rows.size();
+  }
+
+  const MatrixXs<Scalar>& impute(const MatrixXs<Scalar>& X,
+                                 const MatrixXs<Scalar>& U,
+                                 MatrixXs<Scalar>& buffer) const {
+    if(empty()){
+      return X;
+    }
+
+    if((buffer.rows() != X.rows()) || (buffer.cols() != X.cols())){
+      buffer = X;
+    }
+    for(std::size_t k = 0; k < rows.size(); k++){
+      const Eigen::Index i = rows[k];
+      const Eigen::Index j = cols[k];
+      buffer(i, j) = weights[k] * X(i, j) + (1 - weights[k]) * U(i, j);
+    }
+    return buffer;
+  }
+
+private:
+  std::vector<Eigen::Index> rows;
+  std::vector<Eigen::Index> cols;
+  std::vector<Scalar> weights; // M(i, j) (zero, unless M is a soft mask)
+};
+
+// Precision-dependent constants for the solvers
+//
+// fusion_tol() is the relative amount of shrinkage below which the prox operators
+// treat a difference as fused. In double precision we require exact zeros (as we
+// always have), but in single precision rounding leaves "almost zero" differences
+// which would otherwise take many more iterations to fuse
+template <typename Scalar> struct NumericTraits;
+
+template <> struct NumericTraits<double> {
+  static double fusion_tol(){ return 0; }
+};
+
+template <> struct NumericTraits<float> {
+  static float fusion_tol(){ return 8 * std::numeric_limits<float>::epsilon(); }
+};
+
+// Squared norm / number of cells gives average squared difference
+template <typename Derived>
+double scaled_squared_norm(const Eigen::MatrixBase<Derived>& mat) {
+  return static_cast<double>(mat.squaredNorm()) / (mat.rows() * mat.cols());
+}
+
+// Prototypes - weight_graphs.cpp
+//
+// Sparse (kNN) weight graph: edges (i, j) with i < j (zero-based), in lexicographic
+// order, and their weights
+struct KNNWeightGraph {
+  Eigen::MatrixXi edge_list;
+  Eigen::VectorXd weights;
+  double phi;
+  int k;
+};
+
+KNNWeightGraph knn_rbf_graph(const Eigen::MatrixXd&, int, double);
+
+// Approximate kNN graph (NN-descent) build statistics: recall is estimated on a
+// sample of rows, and components of the kNN graph are joined by num_bridges edges
+struct ApproxKNNStats {
+  double seconds;
+  int iterations;
+  double recall;
+  Eigen::Index num_components;
+  Eigen::Index num_bridges;
+};
+
+KNNWeightGraph approx_knn_rbf_graph(const Eigen::MatrixXd&, int, double, double, int, unsigned int, ApproxKNNStats*);
+
+void weight_matrix_edges(const Eigen::MatrixXd&, Eigen::MatrixXi&, Eigen::VectorXd&);
 
-Eigen::MatrixXd MatrixColProx(const Eigen::MatrixXd&,
-                              double,
-                              const Eigen::VectorXd&,
-                              bool);
+void sparse_weight_matrix_edges(const Eigen::SparseMatrix<double>&, Eigen::MatrixXi&, Eigen::VectorXd&);
 
-double scaled_squared_norm(const Eigen::MatrixXd&);
+bool edge_list_is_connected(const Eigen::MatrixXi&, Eigen::Index);
 
 #endif
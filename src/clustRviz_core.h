@@ -0,0 +1,152 @@
+#ifndef CLUSTRVIZ_CORE_H
+#define CLUSTRVIZ_CORE_H 1
+
+// clustRviz solver core
+//
+// Everything below depends only on Eigen (and optionally OpenMP): the host
+// environment is reached only through the hooks in clustRviz_hooks.h. The R
+// package includes this via clustRviz.h, which adds the Rcpp conversions
+// (r_adapter.h); standalone programs (see bench/) include it directly and link
+// against the clustrviz_core library (see CMakeLists.txt).
+#include "clustRviz_base.h"
+#include "clustRviz_hooks.h"
+#include "clustRviz_logging.h"
+#include "profile.h"
+#include "trace.h"
+#include "screening.h"
+#include "u_solvers.h"
+#include "norm_policies.h"
+#include "clustering_impl.h"
+#include "biclustering_impl.h"
+#include "multi_clustering_impl.h"
+#include "alg_reg_policies.h"
+#include "optim_policies.h"
+#include "tree_path.h"
+#include "row_collapse.h"
+#include "centroid_index.h"
+
+// Prototypes - cluster_assignments.cpp
+//
+// Cluster labels (zero-based, in order of each cluster's smallest member) and
+// sizes at one point of a solution path
+struct ClusterAssignment {
+  Eigen::VectorXi membership;
+  Eigen::VectorXi sizes;
+  int num_clusters;
+};
+
+ClusterAssignment get_cluster_assignments_impl(const Eigen::MatrixXi&, const Eigen::VectorXi&, int);
+
+// Dendrogram of a solution path, in the format of R's hclust: row j of merge records
+// the j-th merge, with -i denoting (one-based) observation i and +k the cluster
+// formed at the k-th merge; height is the value of gamma at which it first appears.
+// If the path stops before all observations are fused, there are fewer than n - 1
+// merges
+struct Dendrogram {
+  Eigen::MatrixXi merge;
+  Eigen::VectorXd height;
+};
+
+Dendrogram dendrogram_impl(const Eigen::MatrixXi&, const Eigen::MatrixXi&, const Eigen::VectorXd&, int);
+
+// Solver types are templated on the norm policy (L1Norm or L2Norm, see norm_policies.h)
+// and the scalar type (double or float)
+template <class NORM, typename Scalar> using CARP = AlgorithmicRegularizationFixedStepSizePolicy<ConvexClustering<NORM, Scalar> >;
+template <class NORM, typename Scalar> using CARP_VIZ = AlgorithmicRegularizationBacktrackingPolicy<ConvexClustering<NORM, Scalar> >;
+template <class NORM, typename Scalar> using CBASS = AlgorithmicRegularizationFixedStepSizePolicy<ConvexBiClustering<NORM, Scalar> >;
+template <class NORM, typename Scalar> using CBASS_VIZ = AlgorithmicRegularizationBacktrackingPolicy<ConvexBiClustering<NORM, Scalar> >;
+template <class NORM, typename Scalar> using ConvexClusteringADMM = ADMMPolicy<ConvexClustering<NORM, Scalar> >;
+template <class NORM, typename Scalar> using ConvexBiClusteringADMM = ADMMPolicy<ConvexBiClustering<NORM, Scalar> >;
+template <class NORM, typename Scalar> using ConvexClusteringADMM_VIZ = BackTrackingADMMPolicy<ConvexClustering<NORM, Scalar> >;
+template <class NORM, typename Scalar> using ConvexBiClusteringADMM_VIZ = BackTrackingADMMPolicy<ConvexBiClustering<NORM, Scalar> >;
+template <class NORM, typename Scalar> using UserGridConvexClusteringADMM = UserGridADMMPolicy<ConvexClustering<NORM, Scalar> >;
+template <class NORM, typename Scalar> using UserGridConvexBiClusteringADMM = UserGridADMMPolicy<ConvexBiClustering<NORM, Scalar> >;
+
+// Run the appropriate CARP variant on a (convex clustering) problem and return its
+// path as a plain (R-free) object, so this can also be used from worker threads
+// (see carp_batch.cpp)
+template <class PROBLEM_TYPE>
+typename PROBLEM_TYPE::PathType clustering_path(const PROBLEM_TYPE& problem,
+                                                double epsilon,
+                                                double t,
+                                                double thresh,
+                                                int max_iter,
+                                                int max_inner_iter,
+                                                int burn_in,
+                                                double back,
+                                                int keep,
+                                                int viz_max_inner_iter,
+                                                double viz_initial_step,
+                                                double viz_small_step,
+                                                bool back_track,
+                                                bool exact){
+  if(exact){
+    if(back_track){
+      BackTrackingADMMPolicy<PROBLEM_TYPE> admm_viz(problem,
+                                                    epsilon,
+                                                    thresh,
+                                                    max_iter,
+                                                    max_inner_iter,
+                                                    burn_in,
+                                                    back,
+                                                    viz_max_inner_iter,
+                                                    viz_initial_step,
+                                                    viz_small_step);
+
+      return admm_viz.extract_path();
+    } else {
+      ADMMPolicy<PROBLEM_TYPE> admm(problem, epsilon, t, thresh, max_iter, max_inner_iter);
+      return admm.extract_path();
+    }
+  } else {
+    if(back_track){
+      AlgorithmicRegularizationBacktrackingPolicy<PROBLEM_TYPE> carp_viz(problem,
+                                                                        epsilon,
+                                                                        max_iter,
+                                                                        burn_in,
+                                                                        back,
+                                                                        keep,
+                                                                        viz_max_inner_iter,
+                                                                        viz_initial_step,
+                                                                        viz_small_step);
+
+      return carp_viz.extract_path();
+    }
+
+    AlgorithmicRegularizationFixedStepSizePolicy<PROBLEM_TYPE> carp(problem, epsilon, t, max_iter, burn_in, keep);
+    return carp.extract_path();
+  }
+}
+
+template <class NORM, typename Scalar>
+ClusteringPath<Scalar> CARP_path(const MatrixXs<Scalar>& X,
+                                 const ArrayXXs<Scalar>& M,
+                                 const SpMatrixXs<Scalar>& D,
+                                 const VectorXs<Scalar>& weights,
+                                 double epsilon,
+                                 double t,
+                                 double rho,
+                                 double thresh,
+                                 int max_iter,
+                                 int max_inner_iter,
+                                 int burn_in,
+                                 double back,
+                                 int keep,
+                                 int viz_max_inner_iter,
+                                 double viz_initial_step,
+                                 double viz_small_step,
+                                 bool show_progress,
+                                 bool back_track,
+                                 bool exact,
+                                 int trace_length,
+                                 int screen_interval){
+
+  ConvexClustering<NORM, Scalar> problem(X, M, D, weights, rho, show_progress);
+  problem.trace = SolverTrace(trace_length);
+  problem.set_screen_interval(screen_interval);
+
+  return clustering_path(problem, epsilon, t, thresh, max_iter, max_inner_iter, burn_in, back, keep,
+                         viz_max_inner_iter, viz_initial_step, viz_small_step, back_track, exact);
+}
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef CLUSTRVIZ_HOOKS_H
+#define CLUSTRVIZ_HOOKS_H 1
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+// Host environment hooks
+//
+// The solvers never talk to their host directly: console output, conditions
+// (messages, warnings and errors) and interrupt checks all go through these
+// hooks. The defaults are suitable for a standalone C++ program (output to
+// stderr, errors thrown as ClustRVizError, no interrupts); the R package
+// replaces them with calls into R when it is loaded (see clustRviz_logging.cpp)
+//
+// Hooks are never called inside OpenMP parallel regions. Unless thread_safe is
+// set, they are only called from the thread running the solver; otherwise the
+// progress printer may also call print, console_width and check_interrupt from
+// its monitor thread (see status.h).
+class ClustRVizError : public std::runtime_error {
+public:
+  explicit ClustRVizError(const std::string& msg): std::runtime_error(msg) {}
+};
+
+struct ClustRVizHooks {
+  typedef void (*MessageHook)(const std::string&);
+  typedef int (*WidthHook)();
+  typedef void (*InterruptHook)();
+
+  std::ostream* log_stream;       // Destination for INFO and DEBUG log lines
+  MessageHook message;            // Report a MESSAGES level condition
+  MessageHook warning;            // Report a WARNING level condition
+  MessageHook error;              // Report an ERRORS level condition -- must not return
+  MessageHook print;              // Raw console output (progress printing)
+  WidthHook console_width;        // Width of the console, in characters
+  InterruptHook check_interrupt;  // Abort (by throwing) if the user asked us to stop -- NULL if there are no interrupts
+  bool thread_safe;               // May the hooks be called from any thread?
+
+  ClustRVizHooks():
+    log_stream(&std::cerr),
+    message(default_message),
+    warning(default_warning),
+    error(default_error),
+    print(default_print),
+    console_width(default_console_width),
+    check_interrupt(NULL),
+    thread_safe(true) {}
+
+private:
+  static void default_message(const std::string& msg){
+    std::cerr << msg;
+  }
+
+  static void default_warning(const std::string& msg){
+    std::cerr << "Warning: " << msg;
+  }
+
+  static void default_error(const std::string& msg){
+    throw ClustRVizError(msg);
+  }
+
+  static void default_print(const std::string& str){
+    std::cerr << str << std::flush;
+  }
+
+  static int default_console_width(){
+    return 80;
+  }
+};
+
+inline ClustRVizHooks& clustRviz_hooks(){
+  static ClustRVizHooks hooks;
+  return hooks;
+}
+
+#endif
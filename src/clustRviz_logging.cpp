@@ -1,5 +1,52 @@
 #include "clustRviz.h"
 
+// R implementations of the host hooks (see clustRviz_hooks.h)
+//
+// Conditions are signalled "quietly" (without the C++ call), as in
+// http://gallery.rcpp.org/articles/quiet-stop-and-warning/
+static void r_message(const std::string& msg){
+    Rcpp::Function print_msg("message");
+    print_msg(msg, Rcpp::Named("appendLF", false));
+}
+
+static void r_warning(const std::string& msg){
+    Rf_warningcall(R_NilValue, "%s", msg.c_str());
+}
+
+static void r_error(const std::string& msg){
+    throw Rcpp::exception(msg.c_str(), false);
+}
+
+static void r_print(const std::string& str){
+    Rprintf("%s", str.c_str());
+}
+
+static int r_console_width(){
+    return Rf_GetOptionWidth();
+}
+
+static void r_check_interrupt(){
+    Rcpp::checkUserInterrupt();
+}
+
+// Installed when the package's shared library is loaded
+static bool install_r_hooks(){
+    ClustRVizHooks& hooks = clustRviz_hooks();
+
+    hooks.log_stream      = &Rcpp::Rcout;
+    hooks.message         = r_message;
+    hooks.warning         = r_warning;
+    hooks.error           = r_error;
+    hooks.print           = r_print;
+    hooks.console_width   = r_console_width;
+    hooks.check_interrupt = r_check_interrupt;
+    hooks.thread_safe     = false; // The R API may only be used from the main thread
+
+    return true;
+}
+
+static const bool r_hooks_installed = install_r_hooks();
+
 // [[Rcpp::export(rng = false)]]
 void clustRviz_set_logger_level_cpp(int level){
     auto logger_level = static_cast<ClustRVizLoggerLevel>(level);
@@ -1,6 +1,15 @@
 #ifndef CLUSTRVIZ_LOGGING_H
 #define CLUSTRVIZ_LOGGING_H 1
 
+#include "clustRviz_base.h"
+#include "clustRviz_hooks.h"
+#include <chrono>
+#include <ctime>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <string>
+
 // Logging levels similar to Python -- see
 // https://docs.python.org/3.6/library/logging.html#levels
 // but changed ERROR ==> ERRORS to appease compiler and
@@ -18,27 +27,20 @@ enum class ClustRVizLoggerLevel {
     DEBUG     = 0
 };
 
-// See http://gallery.rcpp.org/articles/quiet-stop-and-warning/
-inline void warningNoCall(const std::string& s) {
-    Rf_warningcall(R_NilValue, s.c_str());
-}
-
-inline void NORET stopNoCall(const std::string& s) {
-    throw Rcpp::exception(s.c_str(), false);
-}
-
 // Logger structure loosely based on https://github.com/PennEcon/RcppLogger
 class ClustRVizLoggerMessage {
 public:
     ClustRVizLoggerMessage(const char *header,
                            ClustRVizLoggerLevel msg_level,
                            ClustRVizLoggerLevel logger_level,
-                           std::ostream& logger_ostream){
+                           std::ostream& logger_ostream):
+        logger_ostream(logger_ostream) {
 
-        this->msg_level = msg_level;
-        this->logger_level = logger_level;
+        // The log stream may write through the host (e.g., R), so we can't log from worker threads
+        this->msg_level = in_parallel_region() ? ClustRVizLoggerLevel::DEBUG : msg_level;
+        this->logger_level = in_parallel_region() ? ClustRVizLoggerLevel::ERRORS : logger_level;
 
-        if(msg_level >= logger_level){
+        if(this->msg_level >= this->logger_level){
             logger_ostream << header << " -- ";
 
 // Test for a reasonable compiler which supports std::put_time and similar...
@@ -72,48 +74,55 @@ public:
 private:
     ClustRVizLoggerLevel msg_level;
     ClustRVizLoggerLevel logger_level;
-    std::ostream& logger_ostream = Rcpp::Rcout;
+    std::ostream& logger_ostream;
 };
 
-// Special LoggerMessage for things we want to have
-// handled via R's condition handling mechanisms
+// Special LoggerMessage for things we want to have handled via the host's
+// condition handling mechanisms (e.g., R's message(), warning() and stop())
 class RHandleClustRVizLoggerMessage {
 public:
     RHandleClustRVizLoggerMessage(const char *header,
                                   ClustRVizLoggerLevel msg_level,
-                                  ClustRVizLoggerLevel logger_level){
-
-        this->msg_level = msg_level;
-        this->logger_level = logger_level;
-        this->log_msg = new std::stringstream();
-    }
+                                  ClustRVizLoggerLevel logger_level):
+        msg_level(msg_level),
+        logger_level(logger_level),
+        log_msg(new std::ostringstream()) {}
+
+    // Errors are reported by throwing (from the error hook), so this destructor
+    // must be allowed to throw
+    ~RHandleClustRVizLoggerMessage() noexcept(false) {
+        if(!log_msg){
+            return; // Moved from
+        }
 
-    ~RHandleClustRVizLoggerMessage() {
         if(msg_level >= logger_level){
             (*log_msg) << std::endl;
         }
 
-        const std::string& log_msg_s = (*log_msg).str();
-        delete log_msg;
+        const std::string log_msg_s = log_msg->str();
+        log_msg.reset();
 
-        // Need an extra call to BEGIN_RCPP and VOID_END_RCPP
-        // to handle exceptions thrown below
-        // (they seem to interact badly with destructors otherwise)
-        BEGIN_RCPP
+        // Conditions can only be signalled from the main thread, so messages
+        // raised on worker threads are dropped -- except for errors, which are
+        // thrown as ClustRVizError, to be caught on the worker thread (an exception
+        // must not escape the parallel region) and reported from the main thread
+        if(in_parallel_region()){
+            if(msg_level >= ClustRVizLoggerLevel::ERRORS){
+                throw ClustRVizError(log_msg_s);
+            }
+            return;
+        }
 
         if(msg_level >= logger_level){
-            // Report to R (else: ignore)
+            // Report to the host (else: ignore)
             if(msg_level >= ClustRVizLoggerLevel::ERRORS){
-                stopNoCall(log_msg_s.c_str());
+                clustRviz_hooks().error(log_msg_s);
             } else if(msg_level >= ClustRVizLoggerLevel::WARNING){
-                warningNoCall(log_msg_s.c_str());
+                clustRviz_hooks().warning(log_msg_s);
             } else if(msg_level >= ClustRVizLoggerLevel::MESSAGES){
-                Rcpp::Function print_msg("message");
-                print_msg(log_msg_s, Rcpp::Named("appendLF", false));
+                clustRviz_hooks().message(log_msg_s);
             }
         }
-
-        VOID_END_RCPP
     }
 
     template<typename T>
@@ -130,7 +139,7 @@ public:
 private:
     ClustRVizLoggerLevel msg_level;
     ClustRVizLoggerLevel logger_level;
-    std::stringstream* log_msg;
+    std::unique_ptr<std::ostringstream> log_msg;
 };
 
 // Singleton pattern loosely based on https://stackoverflow.com/a/1008289/967712
@@ -210,14 +219,13 @@ public:
     }
 
     static std::ostream& get_ostream(){
-        return ClustRVizLogger::getInstance().logger_ostream;
+        return *clustRviz_hooks().log_stream;
     }
 
 private:
     ClustRVizLoggerLevel logger_level = ClustRVizLoggerLevel::MESSAGES;
-    std::ostream& logger_ostream = Rcpp::Rcout;
 
-    // Default constructor ==> logger level = MESSAGES, output = Rcpp::Rcout
+    // Default constructor ==> logger level = MESSAGES, output = the log stream hook
 
     // MESSAGES are things that the user should know, but doesn't need to
     // be concerned about => show them by default. Power users can suppress
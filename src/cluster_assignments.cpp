@@ -0,0 +1,209 @@
+#include "clustRviz_core.h"
+#include <algorithm>
+#include <utility>
+
+// Cluster assignments from fusion indicators
+//
+// Given the edge set (zero-based) used for clustering and an indicator of which
+// edges are fused at one point of the path, the clusters are the connected
+// components of the fused edges. Clusters are labelled 0, 1, ... in order of their
+// smallest member.
+ClusterAssignment get_cluster_assignments_impl(const Eigen::MatrixXi& E,
+                                               const Eigen::VectorXi& edge_ind,
+                                               int n){
+
+  // We use a simple (depth-first?) search to determine the connected components
+  // of the graphs. Since we frequently need to check if a vertex is in a component,
+  // we represent each component as a std::set<int>, and we store the components
+  // in a std::vector
+  std::vector<std::set<int> > components;
+  std::set<int> all_vertices_seen;
+
+  // Iterate over all possible edges - this big loop is a no-op where edge_ind == 0
+  for(unsigned int i = 0; i < edge_ind.size(); i++){
+
+    if(edge_ind(i) != 0){ // If the edge is present
+      int edge_begin = E(i, 0);
+      int edge_end   = E(i, 1);
+
+      // We begin by looking for the first vertex (here called "begin") in each component
+      bool found_component_begin = false;
+
+      for(unsigned int j = 0; j < components.size(); j++){
+        std::set<int>& component_j = components[j];
+
+        if(contains(component_j, edge_begin)){
+          // Once we found a component containing the "begin" vertex, let's see if
+          // it contains the "end" vertex.
+          found_component_begin = true;
+          bool found_component_end = false;
+
+          // If begin and end are already in the same component, we don't need
+          // to do anything.
+          if(contains(component_j, edge_end)){
+            found_component_end = true;
+            break; // Continue to next edge
+          }
+
+          // Now check other components
+          for(unsigned int k = 0; k < components.size(); k++){
+            if(k != j){ // We handled k == j above
+
+              std::set<int>& component_k = components[k];
+
+              if(contains(component_k, edge_end)){
+                found_component_end = true;
+                // This implies components j and k are connected, but weren't already
+                //
+                // First we copy all the elements of component_k into component_j
+                component_j.insert(component_k.begin(), component_k.end());
+                // Now we drop component k
+                components.erase(components.begin() + k);
+                break; // No need to check other components
+              }
+            }
+          }
+
+          // If we never found `edge_end` in any component, we add it to component J
+          // since it is connected to `edge_begin.`
+          if(!found_component_end){
+            component_j.insert(edge_end);
+            all_vertices_seen.insert(edge_end);
+          }
+
+          break; // No need to check other components,
+                 // since edge_begin can only be in one component
+        }
+      }
+
+      // If we didnt' find edge_begin in any component, we first check for edge_begin
+      if(!found_component_begin){
+
+        // First check if edge_end is anywhere:
+        // If it is, then we add edge_begin to the same component
+        bool found_component_end_inner = false;
+
+        for(unsigned int j = 0; j < components.size(); j++){
+          std::set<int>& component_j = components[j];
+          if(contains(component_j, edge_end)){
+            // We didn't find edge_begin, but we do have edge_end, so let's add
+            // edge_begin to the same component
+            component_j.insert(edge_begin);
+            all_vertices_seen.insert(edge_begin);
+            found_component_end_inner = true;
+            break;
+          }
+        }
+
+        // If we can't find edge_begin or edge_end anywhere, they are both new
+        // and get there own new component
+        if(!found_component_end_inner){
+          std::set<int> new_component{edge_begin, edge_end};
+          all_vertices_seen.insert(edge_begin);
+          all_vertices_seen.insert(edge_end);
+          components.push_back(new_component);
+        }
+      }
+    }
+  }
+
+  // Sort components in decreasing size order
+
+  // Add singleton components for isolated vertices
+  for(int i = 0; i < n; i++){
+    if(!contains(all_vertices_seen, i)){
+      std::set<int> new_component{i};
+      components.push_back(new_component);
+    }
+  }
+
+  // Sort components by smallest vertex index
+  // This is independent of the order of the edge set / algorithm used
+  std::sort(components.begin(),
+            components.end(),
+            [](const std::set<int>& left, const std::set<int>& right){
+              return *left.begin() < *right.begin();
+            });
+
+  ClusterAssignment result;
+  result.num_clusters = components.size();
+  result.sizes.setOnes(result.num_clusters);
+  result.membership.setConstant(n, -1);
+
+  // Assign labels - loop over components and then elements within components
+  // Requires irregular access to membership, but it's O(1) (=O(n) total) instead
+  // of searching through all the sets repeatedly
+  for(unsigned int i = 0; i < components.size(); i++){
+    std::set<int>& component_i = components[i];
+    result.sizes(i) = component_i.size();
+
+    for(int j : component_i){
+      result.membership(j) = i;
+    }
+  }
+
+  return result;
+}
+
+// Dendrogram from fusion indicators
+//
+// Given the edge set (zero-based), the fusion indicators at each point of the path
+// (one column per iterate) and the corresponding gammas, replays the fusions in order
+// with a union-find structure. Once two clusters have merged they stay merged (as in
+// the dendrograms drawn from R), so this is a single pass over the path.
+Dendrogram dendrogram_impl(const Eigen::MatrixXi& E,
+                           const Eigen::MatrixXi& v_zero_inds,
+                           const Eigen::VectorXd& gamma_path,
+                           int n){
+  std::vector<int> parent(n);
+  std::vector<int> label(n); // hclust label of the cluster rooted at each vertex
+  for(int i = 0; i < n; i++){
+    parent[i] = i;
+    label[i]  = -(i + 1);
+  }
+
+  auto find = [&parent](int i){
+    while(parent[i] != i){
+      parent[i] = parent[parent[i]];
+      i = parent[i];
+    }
+    return i;
+  };
+
+  std::vector<std::pair<int, int> > merges;
+  std::vector<double> heights;
+
+  for(Eigen::Index k = 0; (k < v_zero_inds.cols()) && (static_cast<int>(merges.size()) < n - 1); k++){
+    for(Eigen::Index e = 0; e < v_zero_inds.rows(); e++){
+      if(v_zero_inds(e, k) == 0){
+        continue;
+      }
+
+      int root_begin = find(E(e, 0));
+      int root_end   = find(E(e, 1));
+      if(root_begin == root_end){
+        continue;
+      }
+
+      // Same ordering within each row as the dendrograms built in R (see cvxhc)
+      int left  = std::min(label[root_begin], label[root_end]);
+      int right = std::max(label[root_begin], label[root_end]);
+      merges.push_back(std::make_pair(left, right));
+      heights.push_back(gamma_path(k));
+
+      parent[root_begin] = root_end;
+      label[root_end]    = merges.size();
+    }
+  }
+
+  Dendrogram result;
+  result.merge.resize(merges.size(), 2);
+  result.height.resize(merges.size());
+  for(std::size_t j = 0; j < merges.size(); j++){
+    result.merge(j, 0) = merges[j].first;
+    result.merge(j, 1) = merges[j].second;
+    result.height(j)   = heights[j];
+  }
+
+  return result;
+}
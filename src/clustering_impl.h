@@ -4,27 +4,59 @@
 #include "clustRviz_base.h"
 #include "clustRviz_logging.h"
 #include "status.h"
+#include "norm_policies.h"
+#include "path_store.h"
+#include "profile.h"
+#include "trace.h"
+#include "screening.h"
+#include "u_solvers.h"
+
+// Solution path for convex clustering, stored as plain Eigen objects so that it
+// can be built without touching R (e.g., from a worker thread) -- see r_adapter.h
+// for the conversion to an R list
+template <typename Scalar>
+struct ClusteringPath {
+  Eigen::Index n;          // Dimensions of each (vectorized) iterate in u_path
+  Eigen::Index p;
+  MatrixXs<Scalar> u_path; // (Empty if the U path was written to a path file instead)
+  MatrixXs<Scalar> v_path;
+  Eigen::MatrixXi v_zero_inds;
+  Eigen::VectorXd gamma_path;
+  SolverProfile profile;
+  SolverTrace trace;
+  bool on_disk;
+
+  ClusteringPath(): n(0), p(0), on_disk(false) {}
+};
 
+template <class NORM, typename Scalar>
 class ConvexClustering {
 public:
+  typedef ClusteringPath<Scalar> PathType;
+
   double gamma; // Current regularization level - need to be able to manipulate this externally
+  SolverProfile profile; // Per-phase timings and counters (see profile.h) - updated by the policies too
+  SolverTrace trace;     // Iteration trace (see trace.h) - recorded by the policies
 
-  ConvexClustering(const Eigen::MatrixXd& X_,
-                   const Eigen::ArrayXXd& M_,
-                   const Eigen::MatrixXd& D_,
-                   const Eigen::VectorXd& weights_,
+  ConvexClustering(const MatrixXs<Scalar>& X_,
+                   const ArrayXXs<Scalar>& M_,
+                   const SpMatrixXs<Scalar>& D_,
+                   const VectorXs<Scalar>& weights_,
                    const double rho_,
-                   const bool l1_,
-                   const bool show_progress_):
+                   const bool show_progress_,
+                   const std::string& path_file = std::string(),
+                   const VectorXs<Scalar>& multiplicity_ = VectorXs<Scalar>()):
   X(X_),
-  M(M_),
+  missing(M_),
   D(D_),
   weights(weights_),
+  multiplicity(multiplicity_),
   rho(rho_),
-  l1(l1_),
   n(X_.rows()),
   p(X_.cols()),
   num_edges(D_.rows()),
+  row_prox(select_row_prox_kernel<NORM, Scalar>(X_.cols())),
+  screen(D_, weights_, !missing.empty() || (multiplicity_.size() > 0)),
   sp(show_progress_, D_.rows()) {
 
     // Set initial values for optimization variables
@@ -33,13 +65,23 @@ public:
     Z = V;
     v_zeros = Eigen::ArrayXi::Zero(num_edges);
     gamma = 0;
+    last_u_change = TRACE_NO_CHANGE;
 
     sp.set_v_norm_init(V.squaredNorm());
 
     // Initialize storage buffers
+    //
+    // If a path file is given, the U path is streamed to disk instead of kept in
+    // memory, and the V path (which is only used for CARP post-processing) is dropped
     buffer_size = 1.5 * n;
-    UPath.resize(n * p, buffer_size);
-    VPath.resize(p * num_edges, buffer_size);
+    if(path_file.empty()){
+      UPath.resize(n * p, buffer_size);
+      VPath.resize(p * num_edges, buffer_size);
+    } else {
+      path_store = std::make_shared<PathStoreWriter>(path_file, n, p, num_edges);
+      UPath.resize(0, buffer_size);
+      VPath.resize(0, buffer_size);
+    }
     gamma_path.resize(buffer_size);
     v_zeros_path.resize(num_edges, buffer_size);
 
@@ -48,9 +90,9 @@ public:
     storage_index = 0;
     store_values();
 
-    // PreCompute chol(I + rho D^TD) for easy inversions in the U update step
-    Eigen::MatrixXd IDTD = rho * D.transpose() * D + Eigen::MatrixXd::Identity(n, n);
-    u_step_solver.compute(IDTD);
+    // Pre-compute a solver for I + rho D^TD (or diag(m) + rho D^TD; specialized to
+    // the graph's structure, see u_solvers.h) for easy inversions in the U update step
+    u_step_solver.compute(D, rho, multiplicity.template cast<double>());
   };
 
   bool is_interesting_iter(){
@@ -69,31 +111,45 @@ public:
   }
 
   void admm_step(){
-    // U-update
-    Eigen::MatrixXd X_imputed = M * X.array() + (1.0 - M) * U.array();
-    U = u_step_solver.solve(X_imputed + rho * D.transpose() * (V - Z));
-    Eigen::MatrixXd DU = D * U;
-    ClustRVizLogger::debug("U = ") << U;
+    CLUSTRVIZ_PROFILE_TIMER(profile);
 
-    // V-update
-    Eigen::MatrixXd DUZ = DU + Z;
-    V = MatrixRowProx(DUZ, gamma / rho, weights, l1);
-    ClustRVizLogger::debug("V = ") << V;
+    // U-update
+    const MatrixXs<Scalar>& X_imputed = missing.impute(X, U, imputation_buffer);
+    if(multiplicity.size() == 0){
+      U = u_step_solver.solve(X_imputed + rho * D.transpose() * (V - Z));
+    } else {
+      U = u_step_solver.solve(multiplicity.asDiagonal() * X_imputed + rho * D.transpose() * (V - Z));
+    }
+    MatrixXs<Scalar> DU = D * U;
+    CLUSTRVIZ_PROFILE_LAP(PROFILE_U_SOLVE);
+
+    // V-update (also identifies cluster fusions, i.e., rows of V which have gone to zero)
+    if(screen.enabled()){
+      nzeros = screen.prox(row_prox, DU, Z, gamma / rho, weights, V, v_zeros);
+    } else {
+      MatrixXs<Scalar> DUZ = DU + Z;
+      nzeros = row_prox(DUZ, gamma / rho, weights, V, v_zeros);
+    }
+    CLUSTRVIZ_PROFILE_LAP(PROFILE_PROX);
 
     // Z-update
     Z += DU - V;
-    ClustRVizLogger::debug("Z = ") << Z;
+    CLUSTRVIZ_PROFILE_LAP(PROFILE_DUAL_UPDATE);
+  }
 
-    // Identify cluster fusions (rows of V which have gone to zero)
-    Eigen::VectorXd v_norms = V.rowwise().squaredNorm();
+  // Gap-safe edge screening every `interval` ADMM steps of the exact policies (see
+  // screening.h) -- 0, the default, turns it off; it is never used with missing data
+  // or multiplicity weights
+  void set_screen_interval(int interval){
+    screen = EdgeScreen<NORM, Scalar>(D, weights, !missing.empty() || (multiplicity.size() > 0), interval);
+  }
 
-    for(Eigen::Index i = 0; i < num_edges; i++){
-      v_zeros(i) = v_norms(i) == 0;
+  // Called by the exact (ADMM) policies before each step, with the number of steps
+  // taken at the current gamma (see screening.h)
+  void screen_edges(int inner_iter){
+    if(screen.enabled()){
+      screen.update(inner_iter, gamma, rho, X, U, Z, V, v_zeros, profile);
     }
-
-    nzeros = v_zeros.sum();
-
-    ClustRVizLogger::debug("Number of fusions identified ") << nzeros;
   }
 
   void save_fusions(){
@@ -111,6 +167,7 @@ public:
     U = U_old;
     V = V_old;
     Z = Z_old;
+    screen.reset(); // Pinned rows of V may have been overwritten
   }
 
   void load_old_fusions(){
@@ -121,13 +178,30 @@ public:
     return nzeros > 0;
   }
 
+  int num_fusions() const {
+    return nzeros;
+  }
+
+  // Change in U at the last convergence check (for the trace)
+  double u_change() const {
+    return last_u_change;
+  }
+
   bool admm_converged(double thresh = CLUSTRVIZ_DEFAULT_STOP_PRECISION){
-    return (scaled_squared_norm(U - U_old) < thresh) &&
-           (scaled_squared_norm(V - V_old) < thresh) &&
-           (scaled_squared_norm(Z - Z_old) < thresh);
+    CLUSTRVIZ_PROFILE_TIMER(profile);
+
+    last_u_change = scaled_squared_norm(U - U_old);
+    const bool converged = (last_u_change < thresh) &&
+                           (scaled_squared_norm(V - V_old) < thresh) &&
+                           (scaled_squared_norm(Z - Z_old) < thresh);
+
+    CLUSTRVIZ_PROFILE_LAP(PROFILE_CONVERGENCE_CHECK);
+    return converged;
   }
 
   void store_values(){
+    CLUSTRVIZ_PROFILE_TIMER(profile);
+
     if(storage_index >= buffer_size){
       ClustRVizLogger::info("Resizing storage from ") << buffer_size << " to " << 2 * buffer_size << " iterations.";
       buffer_size *= 2; // Double our buffer sizes
@@ -138,75 +212,104 @@ public:
     }
 
     // Store values
-    UPath.col(storage_index)        = Eigen::Map<Eigen::VectorXd>(U.data(), n * p);
-    VPath.col(storage_index)        = Eigen::Map<Eigen::VectorXd>(V.data(), p * num_edges);
+    if(path_store){
+      path_store->append(U);
+    } else {
+      UPath.col(storage_index)      = Eigen::Map<VectorXs<Scalar> >(U.data(), n * p);
+      VPath.col(storage_index)      = Eigen::Map<VectorXs<Scalar> >(V.data(), p * num_edges);
+    }
     gamma_path(storage_index)       = gamma;
     v_zeros_path.col(storage_index) = v_zeros;
 
     storage_index++;
+    CLUSTRVIZ_PROFILE_LAP(PROFILE_STORE_VALUES);
   }
 
-  Rcpp::List build_return_object(){
+  PathType extract_path(){
+    sp.finish(); // Stop progress printing
+
     // When we are done, we can "drop" unused buffer space before returning to R
     //
     // storage_index is the zero-based index of the next column we would use for storage,
     // but it is also the (one-based) _number_ of columns we want to save so no need
     // to adjust. (NB: conservativeResize takes the target size, not the columns to keep
-    // as an argument)
-    UPath.conservativeResize(UPath.rows(), storage_index);
-    VPath.conservativeResize(VPath.rows(), storage_index);
+    // as an argument.) Since we only drop trailing columns, this shrinks the column-major
+    // buffers in place and the buffers are then handed off to the path without copying
+    UPath.conservativeResize(Eigen::NoChange, storage_index);
+    VPath.conservativeResize(Eigen::NoChange, storage_index);
     gamma_path.conservativeResize(storage_index);
-    v_zeros_path.conservativeResize(v_zeros_path.rows(), storage_index);
+    v_zeros_path.conservativeResize(Eigen::NoChange, storage_index);
 
-    return Rcpp::List::create(Rcpp::Named("u_path")      = UPath,
-                              Rcpp::Named("v_path")      = VPath,
-                              Rcpp::Named("v_zero_inds") = v_zeros_path,
-                              Rcpp::Named("gamma_path")  = gamma_path);
+    if(path_store){
+      path_store->finalize(gamma_path, v_zeros_path);
+    }
+
+    PathType path;
+    path.n = n;
+    path.p = p;
+    path.on_disk = static_cast<bool>(path_store);
+    path.u_path.swap(UPath);
+    path.v_path.swap(VPath);
+    path.v_zero_inds.swap(v_zeros_path);
+    path.gamma_path.swap(gamma_path);
+    path.profile = profile;
+    path.trace = trace;
+
+    return path;
   }
 
   void tick(unsigned int iter){
-    sp.update(nzeros, V.squaredNorm(), iter, gamma);
+    if(sp.needs_v_norm()){
+      sp.set_v_norm(V.squaredNorm());
+    }
+    sp.update(nzeros, iter, gamma);
   }
 
 private:
   // Fixed (non-data-dependent) problem details
-  const Eigen::MatrixXd& X; // Data matrix (to be clustered)
-  const Eigen::ArrayXXd& M; // Missing data mask
-  const Eigen::MatrixXd& D; // Edge (differencing) matrix
-  const Eigen::VectorXd& weights; // Clustering weights
-  const double rho; // ADMM relaxation parameter -- TODO: Factor this out?
+  const MatrixXs<Scalar>& X; // Data matrix (to be clustered)
+  const MissingMask<Scalar> missing; // Missing data mask
+  const SpMatrixXs<Scalar>& D; // Edge (differencing) matrix
+  const VectorXs<Scalar>& weights; // Clustering weights
+  const VectorXs<Scalar> multiplicity; // Rows of the original data represented by each row of X
+                                       // (the loss is sum_i m_i ||x_i - u_i||^2 / 2; empty if all ones)
+  const Scalar rho; // ADMM relaxation parameter -- TODO: Factor this out?
                     // Theoretically, it's part of the algorithm, not the problem
                     // but we need it in the steps...
-  bool  l1;         // Is the L1 (true) or L2 (false) norm being used?
   const int n;      // Problem dimensions
   const int p;
   const int num_edges;
-  Eigen::LLT<Eigen::MatrixXd> u_step_solver; // Cached factorization for u-update
+  const RowProxKernel<Scalar> row_prox; // Prox for the fusion penalty, specialized to p
+  EdgeScreen<NORM, Scalar> screen;      // Edges certified to fuse at the current gamma (if screening)
+  LaplacianSolver<Scalar> u_step_solver; // Cached solver for u-update
 
   // Progress printer
   StatusPrinter sp;
 
   // Current copies of ADMM variables
-  Eigen::MatrixXd U; // Primal variable
-  Eigen::MatrixXd V; // Split variable
-  Eigen::MatrixXd Z; // Dual variable
+  MatrixXs<Scalar> U; // Primal variable
+  MatrixXs<Scalar> V; // Split variable
+  MatrixXs<Scalar> Z; // Dual variable
+  MatrixXs<Scalar> imputation_buffer; // X with missing cells imputed (only used if X has missing values)
   Eigen::ArrayXi v_zeros; // Fusion indicators
   Eigen::Index nzeros; // Number of fusions
 
   // Old versions (used for back-tracking and fusion counting)
   Eigen::Index nzeros_old;
-  Eigen::MatrixXd U_old;
-  Eigen::MatrixXd V_old;
-  Eigen::MatrixXd Z_old;
+  double last_u_change; // Scaled squared change in U at the last convergence check
+  MatrixXs<Scalar> U_old;
+  MatrixXs<Scalar> V_old;
+  MatrixXs<Scalar> Z_old;
   Eigen::ArrayXi  v_zeros_old;
 
   // Internal storage buffers
   Eigen::Index buffer_size;
   Eigen::Index storage_index;
-  Eigen::MatrixXd UPath;
-  Eigen::MatrixXd VPath;
+  MatrixXs<Scalar> UPath;
+  MatrixXs<Scalar> VPath;
   Eigen::VectorXd gamma_path;
   Eigen::MatrixXi v_zeros_path;
+  std::shared_ptr<PathStoreWriter> path_store; // On-disk U path (if used; shared by copies of the problem)
 };
 
 #endif
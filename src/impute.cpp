@@ -0,0 +1,266 @@
+#include "clustRviz.h"
+#include <algorithm>
+#include <random>
+
+// Missing data imputation
+//
+// Fast alternatives to missForest for filling in missing values before clustering.
+// The solvers only need a reasonable starting point here -- the missing cells are
+// re-imputed from the current centroids at every ADMM step (see MissingMask) -- so
+// we use simple, well-understood imputers which scale to large matrices:
+//
+//  - Soft-Impute (Mazumder, Hastie and Tibshirani, 2010): the missing cells are
+//    repeatedly replaced by a soft-thresholded, rank-capped SVD of the current
+//    (filled-in) matrix. The SVDs are computed by randomized subspace iteration
+//    (Halko, Martinsson and Tropp, 2011), warm-started from the previous iteration,
+//    so each iteration is a handful of matrix products.
+//  - kNN imputation: each missing cell is the mean of that column over the k nearest
+//    rows which observe it, with (mean squared) distances computed over the columns
+//    both rows observe. Distances are computed in blocks of rows as matrix products,
+//    as for the sparse kNN weights (see weights.cpp).
+//
+// Missing values are passed in from R as NA / NaN.
+
+// Coordinates of the missing cells of X, in column-major order
+static void find_missing(const Eigen::MatrixXd& X,
+                         std::vector<Eigen::Index>& rows,
+                         std::vector<Eigen::Index>& cols){
+  for(Eigen::Index j = 0; j < X.cols(); j++){
+    for(Eigen::Index i = 0; i < X.rows(); i++){
+      if(std::isnan(X(i, j))){
+        rows.push_back(i);
+        cols.push_back(j);
+      }
+    }
+  }
+}
+
+// Means of the observed entries of each column (zero if a column is entirely missing)
+static Eigen::VectorXd observed_column_means(const Eigen::MatrixXd& X){
+  Eigen::VectorXd means(X.cols());
+  for(Eigen::Index j = 0; j < X.cols(); j++){
+    double total = 0;
+    Eigen::Index count = 0;
+    for(Eigen::Index i = 0; i < X.rows(); i++){
+      if(!std::isnan(X(i, j))){
+        total += X(i, j);
+        count++;
+      }
+    }
+    means(j) = (count > 0) ? total / count : 0;
+  }
+  return means;
+}
+
+// Orthonormal basis for the column space of Y (thin Q factor)
+static Eigen::MatrixXd orthonormal_basis(const Eigen::MatrixXd& Y){
+  Eigen::HouseholderQR<Eigen::MatrixXd> qr(Y);
+  return qr.householderQ() * Eigen::MatrixXd::Identity(Y.rows(), Y.cols());
+}
+
+// Truncated SVD A ~= U diag(d) V^T by randomized subspace iteration. Omega (p-by-l)
+// spans the starting subspace and is replaced by the right singular vectors found,
+// so that it can be used to warm-start the next call.
+static void randomized_svd(const Eigen::MatrixXd& A,
+                           Eigen::MatrixXd& Omega,
+                           int power_iter,
+                           Eigen::MatrixXd& U,
+                           Eigen::VectorXd& d,
+                           Eigen::MatrixXd& V){
+  Eigen::MatrixXd Q = orthonormal_basis(A * Omega);
+  for(int iter = 0; iter < power_iter; iter++){
+    Q = orthonormal_basis(A * orthonormal_basis(A.transpose() * Q));
+  }
+
+  Eigen::MatrixXd B = Q.transpose() * A;
+  Eigen::JacobiSVD<Eigen::MatrixXd> svd(B, Eigen::ComputeThinU | Eigen::ComputeThinV);
+
+  U     = Q * svd.matrixU();
+  d     = svd.singularValues();
+  V     = svd.matrixV();
+  Omega = V;
+}
+
+// [[Rcpp::export(rng = false)]]
+Eigen::MatrixXd soft_impute_matrix(const Eigen::MatrixXd& X,
+                                   int rank,
+                                   double lambda   = -1,
+                                   int max_iter    = 100,
+                                   double tol      = 1e-5,
+                                   int power_iter  = 2){
+  const Eigen::Index n = X.rows();
+  const Eigen::Index p = X.cols();
+
+  std::vector<Eigen::Index> rows, cols;
+  find_missing(X, rows, cols);
+
+  if(rows.empty()){
+    return X;
+  }
+
+  // Work with column-centered data (so the low-rank fit isn't spent on the column
+  // means), starting with the missing cells at their column means
+  const Eigen::VectorXd means = observed_column_means(X);
+  Eigen::MatrixXd Z = X.rowwise() - means.transpose();
+  for(std::size_t k = 0; k < rows.size(); k++){
+    Z(rows[k], cols[k]) = 0;
+  }
+
+  const Eigen::Index max_rank = std::min(n, p);
+  rank = std::max(1, std::min<int>(rank, max_rank));
+  const Eigen::Index subspace_dim = std::min<Eigen::Index>(rank + 10, max_rank);
+
+  // Fixed seed, so imputation (and hence clustering) is reproducible
+  std::mt19937 rng(1234);
+  std::normal_distribution<double> standard_normal(0, 1);
+  Eigen::MatrixXd Omega(p, subspace_dim);
+  for(Eigen::Index j = 0; j < subspace_dim; j++){
+    for(Eigen::Index i = 0; i < p; i++){
+      Omega(i, j) = standard_normal(rng);
+    }
+  }
+
+  Eigen::MatrixXd U, V;
+  Eigen::VectorXd d;
+
+  for(int iter = 0; iter < max_iter; iter++){
+    Rcpp::checkUserInterrupt();
+
+    randomized_svd(Z, Omega, power_iter, U, d, V);
+
+    // Default penalty: a small fraction of the largest singular value of the
+    // initial (mean-imputed) data
+    if(lambda < 0){
+      lambda = 0.01 * d(0);
+    }
+
+    Eigen::VectorXd d_shrunk = (d.head(rank).array() - lambda).max(0).matrix();
+    Eigen::MatrixXd UD       = U.leftCols(rank) * d_shrunk.asDiagonal();
+
+    // Only the missing cells change, so only they need the low-rank fit
+    double change = 0;
+    double norm   = 0;
+    for(std::size_t k = 0; k < rows.size(); k++){
+      const Eigen::Index i = rows[k];
+      const Eigen::Index j = cols[k];
+      const double z_new = UD.row(i).dot(V.row(j).head(rank));
+
+      change += (z_new - Z(i, j)) * (z_new - Z(i, j));
+      norm   += Z(i, j) * Z(i, j);
+      Z(i, j) = z_new;
+    }
+
+    ClustRVizLogger::debug("Soft-Impute iteration ") << iter << ": relative change " << change / std::max(norm, 1e-300);
+
+    if(change <= tol * std::max(norm, 1e-300)){
+      break;
+    }
+  }
+
+  // Copy the observed cells as-is (rather than un-centering them)
+  Eigen::MatrixXd X_imputed = X;
+  for(std::size_t k = 0; k < rows.size(); k++){
+    X_imputed(rows[k], cols[k]) = Z(rows[k], cols[k]) + means(cols[k]);
+  }
+
+  return X_imputed;
+}
+
+// [[Rcpp::export(rng = false)]]
+Eigen::MatrixXd knn_impute_matrix(const Eigen::MatrixXd& X, int k = 10){
+  const Eigen::Index n = X.rows();
+  const Eigen::Index p = X.cols();
+
+  if(k <= 0){
+    ClustRVizLogger::error("k must be positive.");
+  }
+
+  // Zero-filled data and observation indicators (so that sums over co-observed
+  // columns become matrix products)
+  Eigen::MatrixXd O  = Eigen::MatrixXd::Zero(n, p);
+  Eigen::MatrixXd X0 = Eigen::MatrixXd::Zero(n, p);
+  std::vector<Eigen::Index> missing_rows;
+
+  for(Eigen::Index i = 0; i < n; i++){
+    bool has_missing = false;
+    for(Eigen::Index j = 0; j < p; j++){
+      if(std::isnan(X(i, j))){
+        has_missing = true;
+      } else {
+        O(i, j)  = 1;
+        X0(i, j) = X(i, j);
+      }
+    }
+    if(has_missing){
+      missing_rows.push_back(i);
+    }
+  }
+
+  if(missing_rows.empty()){
+    return X;
+  }
+
+  const Eigen::VectorXd means = observed_column_means(X);
+  const Eigen::MatrixXd X0sq  = X0.array().square().matrix();
+
+  Eigen::MatrixXd X_imputed = X;
+
+  const Eigen::Index num_missing_rows = missing_rows.size();
+  const Eigen::Index block_size       = CLUSTRVIZ_DISTANCE_BLOCK_SIZE;
+
+  for(Eigen::Index block_start = 0; block_start < num_missing_rows; block_start += block_size){
+    Rcpp::checkUserInterrupt();
+
+    const Eigen::Index b = std::min(block_size, num_missing_rows - block_start);
+
+    Eigen::MatrixXd O_b(b, p), X0_b(b, p), X0sq_b(b, p);
+    for(Eigen::Index r = 0; r < b; r++){
+      const Eigen::Index i = missing_rows[block_start + r];
+      O_b.row(r)    = O.row(i);
+      X0_b.row(r)   = X0.row(i);
+      X0sq_b.row(r) = X0sq.row(i);
+    }
+
+    // Squared distances and number of co-observed columns for each pair
+    const Eigen::MatrixXd sq_dists = X0sq_b * O.transpose() + O_b * X0sq.transpose() - 2 * X0_b * X0.transpose();
+    const Eigen::MatrixXd counts   = O_b * O.transpose();
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+    for(Eigen::Index r = 0; r < b; r++){
+      const Eigen::Index i = missing_rows[block_start + r];
+
+      std::vector<std::pair<double, Eigen::Index> > neighbors;
+      neighbors.reserve(n);
+      for(Eigen::Index j = 0; j < n; j++){
+        if((j != i) && (counts(r, j) > 0)){
+          neighbors.push_back(std::make_pair(std::max(sq_dists(r, j), 0.0) / counts(r, j), j));
+        }
+      }
+      std::sort(neighbors.begin(), neighbors.end());
+
+      // Average over the k nearest rows which observe each missing column,
+      // falling back to the column mean if there are none
+      for(Eigen::Index c = 0; c < p; c++){
+        if(O(i, c) != 0){
+          continue;
+        }
+
+        double total = 0;
+        int found    = 0;
+        for(std::size_t m = 0; (m < neighbors.size()) && (found < k); m++){
+          const Eigen::Index j = neighbors[m].second;
+          if(O(j, c) != 0){
+            total += X(j, c);
+            found++;
+          }
+        }
+
+        X_imputed(i, c) = (found > 0) ? total / found : means(c);
+      }
+    }
+  }
+
+  return X_imputed;
+}
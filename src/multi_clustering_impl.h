@@ -0,0 +1,294 @@
+#ifndef CLUSTRVIZ_MULTI_CLUSTERING_H
+#define CLUSTRVIZ_MULTI_CLUSTERING_H 1
+
+#include "clustRviz_base.h"
+#include "clustRviz_logging.h"
+#include "status.h"
+#include "norm_policies.h"
+#include "clustering_impl.h"
+#include "u_solvers.h"
+
+// Convex clustering of several data sets which share observations and a weight graph
+//
+// The data sets X_1, ..., X_K (each n-by-p_k) are stacked column-wise into a single
+// n-by-(p_1 + ... + p_K) matrix. Since the U-update system matrix I + rho D^TD only
+// depends on the graph, it is factorized once and each U-update is a single (wide)
+// solve for all data sets. The V-update is applied block-by-block, so fusions are
+// tracked separately for each data set: the combined problem is exactly K separate
+// convex clustering problems, run along a common gamma path.
+//
+// A path point is "interesting" (and hence recorded) if any data set has a new
+// fusion, and the problem is complete once every data set is fully fused.
+
+// Solution paths for each data set, sharing a common gamma path
+template <typename Scalar>
+struct MultiClusteringPath {
+  std::vector<ClusteringPath<Scalar> > paths;
+};
+
+template <class NORM, typename Scalar>
+class ConvexClusteringMulti {
+public:
+  typedef MultiClusteringPath<Scalar> PathType;
+
+  double gamma; // Current regularization level - need to be able to manipulate this externally
+  SolverProfile profile; // Per-phase timings and counters (see profile.h) - updated by the policies too
+  SolverTrace trace;     // Iteration trace (see trace.h) - recorded by the policies
+
+  ConvexClusteringMulti(const MatrixXs<Scalar>& X_,
+                        const ArrayXXs<Scalar>& M_,
+                        const SpMatrixXs<Scalar>& D_,
+                        const VectorXs<Scalar>& weights_,
+                        const Eigen::VectorXi& block_sizes_,
+                        const double rho_,
+                        const bool show_progress_):
+  X(X_),
+  missing(M_),
+  D(D_),
+  weights(weights_),
+  rho(rho_),
+  n(X_.rows()),
+  p(X_.cols()),
+  num_edges(D_.rows()),
+  num_blocks(block_sizes_.size()),
+  block_sizes(block_sizes_),
+  block_starts(block_sizes_.size()),
+  row_prox(block_sizes_.size()),
+  sp(show_progress_, D_.rows() * block_sizes_.size()) {
+
+    if(block_sizes.sum() != p){
+      ClustRVizLogger::error("Block sizes must sum to the number of columns of X.");
+    }
+
+    // Column offsets of each data set and the prox kernel specialized to its width
+    Eigen::Index start = 0;
+    for(Eigen::Index k = 0; k < num_blocks; k++){
+      block_starts(k) = start;
+      row_prox[k]     = select_row_prox_kernel<NORM, Scalar>(block_sizes(k));
+      start          += block_sizes(k);
+    }
+
+    // Set initial values for optimization variables
+    U = X;
+    V = D * U;
+    Z = V;
+    v_zeros = Eigen::ArrayXXi::Zero(num_edges, num_blocks);
+    nzeros = Eigen::ArrayXi::Zero(num_blocks);
+    nzeros_old = nzeros;
+    gamma = 0;
+    last_u_change = TRACE_NO_CHANGE;
+
+    sp.set_v_norm_init(V.squaredNorm());
+
+    // Initialize storage buffers
+    buffer_size = 1.5 * n;
+    UPath.resize(n * p, buffer_size);
+    VPath.resize(p * num_edges, buffer_size);
+    gamma_path.resize(buffer_size);
+    v_zeros_path.resize(num_edges * num_blocks, buffer_size);
+
+    // Store initial values
+    storage_index = 0;
+    store_values();
+
+    // Pre-compute a solver for I + rho D^TD (see u_solvers.h) once for all data sets
+    u_step_solver.compute(D, rho);
+  };
+
+  bool is_interesting_iter(){
+    return (nzeros != nzeros_old).any();
+  }
+
+  bool multiple_fusions(){
+    return (nzeros > nzeros_old + 1).any();
+  }
+
+  bool is_complete(){
+    return (nzeros == num_edges).all();
+  }
+
+  void admm_step(){
+    CLUSTRVIZ_PROFILE_TIMER(profile);
+
+    // U-update (one solve for all data sets)
+    const MatrixXs<Scalar>& X_imputed = missing.impute(X, U, imputation_buffer);
+    U = u_step_solver.solve(X_imputed + rho * D.transpose() * (V - Z));
+    MatrixXs<Scalar> DU = D * U;
+    CLUSTRVIZ_PROFILE_LAP(PROFILE_U_SOLVE);
+
+    // V-update (separately for each data set, so each has its own fusions)
+    MatrixXs<Scalar> DUZ = DU + Z;
+    for(Eigen::Index k = 0; k < num_blocks; k++){
+      nzeros(k) = row_prox[k](DUZ.middleCols(block_starts(k), block_sizes(k)),
+                              gamma / rho,
+                              weights,
+                              V.middleCols(block_starts(k), block_sizes(k)),
+                              v_zeros.col(k));
+    }
+    CLUSTRVIZ_PROFILE_LAP(PROFILE_PROX);
+
+    // Z-update
+    Z += DU - V;
+    CLUSTRVIZ_PROFILE_LAP(PROFILE_DUAL_UPDATE);
+  }
+
+  // Edge screening (see screening.h) is only implemented for single data sets
+  void screen_edges(int){}
+
+  void save_fusions(){
+    nzeros_old = nzeros;
+  }
+
+  void save_old_values(){
+    U_old = U;
+    V_old = V;
+    Z_old = Z;
+    v_zeros_old = v_zeros;
+  }
+
+  void load_old_variables(){
+    U = U_old;
+    V = V_old;
+    Z = Z_old;
+  }
+
+  void load_old_fusions(){
+    v_zeros = v_zeros_old;
+  }
+
+  bool has_fusions(){
+    return (nzeros > 0).any();
+  }
+
+  int num_fusions() const {
+    return nzeros.sum();
+  }
+
+  // Largest change in U (over the data sets checked) at the last convergence check,
+  // for the trace
+  double u_change() const {
+    return last_u_change;
+  }
+
+  // Converged only if every data set has converged (so that small-scale data sets
+  // are held to the same standard as if they had been solved on their own)
+  bool admm_converged(double thresh = CLUSTRVIZ_DEFAULT_STOP_PRECISION){
+    CLUSTRVIZ_PROFILE_TIMER(profile);
+
+    bool converged = true;
+    last_u_change = 0;
+    for(Eigen::Index k = 0; (k < num_blocks) && converged; k++){
+      const Eigen::Index start = block_starts(k);
+      const Eigen::Index width = block_sizes(k);
+
+      const double u_change_k = scaled_squared_norm(U.middleCols(start, width) - U_old.middleCols(start, width));
+      last_u_change = std::max(last_u_change, u_change_k);
+
+      converged = (u_change_k < thresh) &&
+                  (scaled_squared_norm(V.middleCols(start, width) - V_old.middleCols(start, width)) < thresh) &&
+                  (scaled_squared_norm(Z.middleCols(start, width) - Z_old.middleCols(start, width)) < thresh);
+    }
+
+    CLUSTRVIZ_PROFILE_LAP(PROFILE_CONVERGENCE_CHECK);
+    return converged;
+  }
+
+  void store_values(){
+    CLUSTRVIZ_PROFILE_TIMER(profile);
+
+    if(storage_index >= buffer_size){
+      ClustRVizLogger::info("Resizing storage from ") << buffer_size << " to " << 2 * buffer_size << " iterations.";
+      buffer_size *= 2; // Double our buffer sizes
+      UPath.conservativeResize(UPath.rows(), buffer_size);
+      VPath.conservativeResize(VPath.rows(), buffer_size);
+      gamma_path.conservativeResize(buffer_size);
+      v_zeros_path.conservativeResize(v_zeros_path.rows(), buffer_size);
+    }
+
+    // Store values
+    UPath.col(storage_index)        = Eigen::Map<VectorXs<Scalar> >(U.data(), n * p);
+    VPath.col(storage_index)        = Eigen::Map<VectorXs<Scalar> >(V.data(), p * num_edges);
+    gamma_path(storage_index)       = gamma;
+    v_zeros_path.col(storage_index) = Eigen::Map<Eigen::VectorXi>(v_zeros.data(), num_edges * num_blocks);
+
+    storage_index++;
+    CLUSTRVIZ_PROFILE_LAP(PROFILE_STORE_VALUES);
+  }
+
+  PathType extract_path(){
+    sp.finish(); // Stop progress printing
+
+    // Since U and V are column-major, the columns belonging to data set k are
+    // a contiguous run of rows in the stored (vectorized) path
+    PathType path;
+    path.paths.resize(num_blocks);
+
+    for(Eigen::Index k = 0; k < num_blocks; k++){
+      const Eigen::Index start = block_starts(k);
+      const Eigen::Index width = block_sizes(k);
+
+      path.paths[k].n           = n;
+      path.paths[k].p           = width;
+      path.paths[k].u_path      = UPath.block(n * start, 0, n * width, storage_index);
+      path.paths[k].v_path      = VPath.block(num_edges * start, 0, num_edges * width, storage_index);
+      path.paths[k].v_zero_inds = v_zeros_path.block(num_edges * k, 0, num_edges, storage_index);
+      path.paths[k].gamma_path  = gamma_path.head(storage_index);
+      path.paths[k].profile     = profile; // Shared by all data sets
+      path.paths[k].trace       = trace;
+    }
+
+    return path;
+  }
+
+  void tick(unsigned int iter){
+    if(sp.needs_v_norm()){
+      sp.set_v_norm(V.squaredNorm());
+    }
+    sp.update(nzeros.sum(), iter, gamma);
+  }
+
+private:
+  // Fixed (non-data-dependent) problem details
+  const MatrixXs<Scalar>& X; // Data matrices (stacked column-wise)
+  const MissingMask<Scalar> missing; // Missing data masks (stacked column-wise)
+  const SpMatrixXs<Scalar>& D; // Edge (differencing) matrix
+  const VectorXs<Scalar>& weights; // Clustering weights
+  const Scalar rho; // ADMM relaxation parameter
+  const int n;      // Problem dimensions
+  const int p;      // (Total number of columns)
+  const int num_edges;
+  const Eigen::Index num_blocks;   // Number of data sets
+  const Eigen::VectorXi block_sizes; // Number of columns in each data set
+  Eigen::VectorXi block_starts;      // First column of each data set
+  std::vector<RowProxKernel<Scalar> > row_prox; // Prox for the fusion penalty, specialized to each p_k
+  LaplacianSolver<Scalar> u_step_solver; // Cached solver for u-update
+
+  // Progress printer
+  StatusPrinter sp;
+
+  // Current copies of ADMM variables
+  MatrixXs<Scalar> U; // Primal variable
+  MatrixXs<Scalar> V; // Split variable
+  MatrixXs<Scalar> Z; // Dual variable
+  MatrixXs<Scalar> imputation_buffer; // X with missing cells imputed (only used if X has missing values)
+  Eigen::ArrayXXi v_zeros; // Fusion indicators (one column per data set)
+  Eigen::ArrayXi nzeros;   // Number of fusions (per data set)
+
+  // Old versions (used for back-tracking and fusion counting)
+  Eigen::ArrayXi nzeros_old;
+  double last_u_change; // Largest scaled squared change in U at the last convergence check
+  MatrixXs<Scalar> U_old;
+  MatrixXs<Scalar> V_old;
+  MatrixXs<Scalar> Z_old;
+  Eigen::ArrayXXi v_zeros_old;
+
+  // Internal storage buffers
+  Eigen::Index buffer_size;
+  Eigen::Index storage_index;
+  MatrixXs<Scalar> UPath;
+  MatrixXs<Scalar> VPath;
+  Eigen::VectorXd gamma_path;
+  Eigen::MatrixXi v_zeros_path;
+};
+
+#endif
@@ -0,0 +1,201 @@
+#ifndef CLUSTRVIZ_NORM_POLICIES_H
+#define CLUSTRVIZ_NORM_POLICIES_H 1
+
+#include "clustRviz_base.h"
+
+// Norm policies for the fusion penalty
+//
+// Each policy supplies the (weighted) proximal operators used in the V-update(s)
+// and the penalty values used for objective reporting. The problem classes are
+// templated on the policy, so the choice of norm is resolved at compile time
+// rather than being re-checked inside every prox call.
+//
+// Row-wise prox operators are further templated on the number of columns P of
+// their argument so that, for the low-dimensional problems which dominate in
+// practice, the inner loops are fully unrolled. The appropriate instantiation is
+// chosen once, when a problem is constructed, by select_row_prox_kernel() below.
+//
+// The prox operators write their result into V and, at the same time, record
+// which rows (or columns) were shrunk all the way to zero in `zeros`, returning
+// the number of such fusions. This saves a second pass over V to identify fusions.
+//
+// Everything is templated on the scalar type; in single precision, differences
+// which have been shrunk to within NumericTraits<float>::fusion_tol() (relative)
+// of zero are treated as fused.
+
+template <typename Scalar>
+using RowProxKernel = Eigen::Index (*)(const Eigen::Ref<const MatrixXs<Scalar> >&,
+                                       Scalar,
+                                       const VectorXs<Scalar>&,
+                                       Eigen::Ref<MatrixXs<Scalar> >,
+                                       Eigen::Ref<Eigen::ArrayXi>);
+
+struct L1Norm {
+  // Element-wise soft-thresholding, with the threshold for row i given by lambda * weights(i)
+  template <typename Scalar, int P>
+  static Eigen::Index row_prox(const Eigen::Ref<const MatrixXs<Scalar> >& X,
+                               Scalar lambda,
+                               const VectorXs<Scalar>& weights,
+                               Eigen::Ref<MatrixXs<Scalar> > V,
+                               Eigen::Ref<Eigen::ArrayXi> zeros){
+    const Eigen::Index n = X.rows();
+    const Eigen::Index p = (P == Eigen::Dynamic) ? X.cols() : P;
+    const Eigen::Array<Scalar, Eigen::Dynamic, 1> thresh = lambda * weights.array();
+    const Scalar fused_scale = 1 + NumericTraits<Scalar>::fusion_tol();
+
+    // Soft-thresholding is x - clamp(x, -thresh, thresh); working down columns
+    // keeps memory access contiguous and lets Eigen vectorize across rows
+    for(Eigen::Index j = 0; j < p; j++){
+      V.col(j).array() = X.col(j).array() - X.col(j).array().max(-thresh).min(thresh);
+    }
+
+    // A row is fused if every element is (within fusion_tol()) shrunk to zero
+    Eigen::Index nzeros = 0;
+    for(Eigen::Index i = 0; i < n; i++){
+      zeros(i) = (X.template block<1, P>(i, 0, 1, p).array().abs() <= thresh(i) * fused_scale).all();
+      if(zeros(i)){
+        V.template block<1, P>(i, 0, 1, p).setZero();
+        nzeros++;
+      }
+    }
+
+    return nzeros;
+  }
+
+  template <typename Scalar>
+  static Eigen::Index col_prox(const Eigen::Ref<const MatrixXs<Scalar> >& X,
+                               Scalar lambda,
+                               const VectorXs<Scalar>& weights,
+                               Eigen::Ref<MatrixXs<Scalar> > V,
+                               Eigen::Ref<Eigen::ArrayXi> zeros){
+    const Eigen::Index p = X.cols();
+
+    Eigen::Index nzeros = 0;
+    for(Eigen::Index j = 0; j < p; j++){
+      const Scalar thresh = lambda * weights(j);
+      zeros(j) = (X.col(j).array().abs() <= thresh * (1 + NumericTraits<Scalar>::fusion_tol())).all();
+
+      if(zeros(j)){
+        V.col(j).setZero();
+        nzeros++;
+      } else {
+        V.col(j).array() = X.col(j).array() - X.col(j).array().max(-thresh).min(thresh);
+      }
+    }
+
+    return nzeros;
+  }
+
+  template <typename Scalar>
+  static Scalar row_penalty(const MatrixXs<Scalar>& V, const VectorXs<Scalar>& weights){
+    return V.cwiseAbs().rowwise().sum().dot(weights);
+  }
+
+  template <typename Scalar>
+  static Scalar col_penalty(const MatrixXs<Scalar>& V, const VectorXs<Scalar>& weights){
+    return V.cwiseAbs().colwise().sum().dot(weights);
+  }
+
+  // Dual (l-infinity) norm, used for edge screening (see screening.h)
+  template <typename Derived>
+  static double dual_norm(const Eigen::MatrixBase<Derived>& x){
+    return x.cwiseAbs().maxCoeff();
+  }
+};
+
+struct L2Norm {
+  // Group soft-thresholding of each row, with threshold lambda * weights(i)
+  template <typename Scalar, int P>
+  static Eigen::Index row_prox(const Eigen::Ref<const MatrixXs<Scalar> >& X,
+                               Scalar lambda,
+                               const VectorXs<Scalar>& weights,
+                               Eigen::Ref<MatrixXs<Scalar> > V,
+                               Eigen::Ref<Eigen::ArrayXi> zeros){
+    const Eigen::Index n = X.rows();
+    const Eigen::Index p = X.cols();
+
+    Eigen::Index nzeros = 0;
+    for(Eigen::Index i = 0; i < n; i++){
+      Scalar scale_factor = 1 - lambda * weights(i) / X.template block<1, P>(i, 0, 1, p).norm();
+
+      if(scale_factor > NumericTraits<Scalar>::fusion_tol()){
+        V.template block<1, P>(i, 0, 1, p) = X.template block<1, P>(i, 0, 1, p) * scale_factor;
+        zeros(i) = 0;
+      } else {
+        V.template block<1, P>(i, 0, 1, p).setZero();
+        zeros(i) = 1;
+        nzeros++;
+      }
+    }
+
+    return nzeros;
+  }
+
+  template <typename Scalar>
+  static Eigen::Index col_prox(const Eigen::Ref<const MatrixXs<Scalar> >& X,
+                               Scalar lambda,
+                               const VectorXs<Scalar>& weights,
+                               Eigen::Ref<MatrixXs<Scalar> > V,
+                               Eigen::Ref<Eigen::ArrayXi> zeros){
+    const Eigen::Index p = X.cols();
+
+    Eigen::Index nzeros = 0;
+    for(Eigen::Index j = 0; j < p; j++){
+      Scalar scale_factor = 1 - lambda * weights(j) / X.col(j).norm();
+
+      if(scale_factor > NumericTraits<Scalar>::fusion_tol()){
+        V.col(j) = X.col(j) * scale_factor;
+        zeros(j) = 0;
+      } else {
+        V.col(j).setZero();
+        zeros(j) = 1;
+        nzeros++;
+      }
+    }
+
+    return nzeros;
+  }
+
+  template <typename Scalar>
+  static Scalar row_penalty(const MatrixXs<Scalar>& V, const VectorXs<Scalar>& weights){
+    return V.rowwise().norm().dot(weights);
+  }
+
+  template <typename Scalar>
+  static Scalar col_penalty(const MatrixXs<Scalar>& V, const VectorXs<Scalar>& weights){
+    return V.colwise().norm().dot(weights);
+  }
+
+  // Dual (l2) norm, used for edge screening (see screening.h)
+  template <typename Derived>
+  static double dual_norm(const Eigen::MatrixBase<Derived>& x){
+    return x.norm();
+  }
+};
+
+// Pick the row-prox kernel specialized for p columns, falling back to the
+// dynamically-sized kernel for p > 16
+template <class NORM, typename Scalar>
+RowProxKernel<Scalar> select_row_prox_kernel(Eigen::Index p){
+  switch(p){
+    case 1:  return &NORM::template row_prox<Scalar, 1>;
+    case 2:  return &NORM::template row_prox<Scalar, 2>;
+    case 3:  return &NORM::template row_prox<Scalar, 3>;
+    case 4:  return &NORM::template row_prox<Scalar, 4>;
+    case 5:  return &NORM::template row_prox<Scalar, 5>;
+    case 6:  return &NORM::template row_prox<Scalar, 6>;
+    case 7:  return &NORM::template row_prox<Scalar, 7>;
+    case 8:  return &NORM::template row_prox<Scalar, 8>;
+    case 9:  return &NORM::template row_prox<Scalar, 9>;
+    case 10: return &NORM::template row_prox<Scalar, 10>;
+    case 11: return &NORM::template row_prox<Scalar, 11>;
+    case 12: return &NORM::template row_prox<Scalar, 12>;
+    case 13: return &NORM::template row_prox<Scalar, 13>;
+    case 14: return &NORM::template row_prox<Scalar, 14>;
+    case 15: return &NORM::template row_prox<Scalar, 15>;
+    case 16: return &NORM::template row_prox<Scalar, 16>;
+    default: return &NORM::template row_prox<Scalar, Eigen::Dynamic>;
+  }
+}
+
+#endif
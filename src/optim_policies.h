@@ -3,6 +3,8 @@
 
 #include "clustRviz_base.h"
 #include "clustRviz_logging.h"
+#include "profile.h"
+#include "trace.h"
 
 template <class PROBLEM_TYPE>
 class ADMMPolicy {
@@ -33,13 +35,15 @@ public:
     problem.gamma = epsilon;
 
     while( (iter < max_iter) & (!problem.is_complete()) ){
-      ClustRVizLogger::info("Starting ADMM with gamma = ") << problem.gamma;
-
       int k = 0;
+      CLUSTRVIZ_PROFILE_NEW_GAMMA(problem.profile);
 
+      bool converged = false;
       do {
+        problem.screen_edges(k);
         problem.save_old_values();
         problem.admm_step();
+        CLUSTRVIZ_PROFILE_INNER_ITERATION(problem.profile);
         iter++; k++;
 
         // problem.tick() will check for interrupts
@@ -51,9 +55,11 @@ public:
           break; // Avoid infinite loops on a single gamma...
         }
 
-      } while (!problem.admm_converged(thresh));
+        converged = problem.admm_converged(thresh);
+        CLUSTRVIZ_TRACE(problem, TRACE_STEP, iter, k, problem.u_change());
+      } while (!converged);
 
-      ClustRVizLogger::info("ADMM converged with gamma = ") << problem.gamma << " after " << iter << " total iterations.";
+      CLUSTRVIZ_TRACE(problem, converged ? TRACE_CONVERGED : TRACE_NOT_CONVERGED, iter, k, problem.u_change());
 
       problem.store_values();
       problem.gamma *= t;
@@ -66,10 +72,10 @@ public:
     solved = true;
   }
 
-  Rcpp::List build_return_object(){
+  typename PROBLEM_TYPE::PathType extract_path(){
     if(!solved) solve();
 
-    return problem.build_return_object();
+    return problem.extract_path();
   }
 private:
   PROBLEM_TYPE problem;
@@ -111,13 +117,15 @@ public:
     for(double lambda : lambda_grid){
       problem.gamma = lambda;
 
-      ClustRVizLogger::info("Starting ADMM with gamma = ") << problem.gamma;
-
       int k = 0;
+      CLUSTRVIZ_PROFILE_NEW_GAMMA(problem.profile);
 
+      bool converged = false;
       do {
+        problem.screen_edges(k);
         problem.save_old_values();
         problem.admm_step();
+        CLUSTRVIZ_PROFILE_INNER_ITERATION(problem.profile);
         iter++; k++;
 
         // problem.tick() will check for interrupts
@@ -129,9 +137,11 @@ public:
           break; // Avoid infinite loops on a single lambda...
         }
 
-      } while (!problem.admm_converged(thresh));
+        converged = problem.admm_converged(thresh);
+        CLUSTRVIZ_TRACE(problem, TRACE_STEP, iter, k, problem.u_change());
+      } while (!converged);
 
-      ClustRVizLogger::info("ADMM converged with gamma = ") << problem.gamma << " after " << iter << " total iterations.";
+      CLUSTRVIZ_TRACE(problem, converged ? TRACE_CONVERGED : TRACE_NOT_CONVERGED, iter, k, problem.u_change());
 
       problem.store_values();
 
@@ -143,10 +153,10 @@ public:
       solved = true;
   }
 
-  Rcpp::List build_return_object(){
+  typename PROBLEM_TYPE::PathType extract_path(){
     if(!solved) solve();
 
-    return problem.build_return_object();
+    return problem.extract_path();
   }
 private:
   PROBLEM_TYPE problem;
@@ -197,10 +207,8 @@ public:
     t = viz_initial_step;
 
     while( (iter < max_iter) & (!problem.is_complete()) ){
-      ClustRVizLogger::info("Beginning iteration k = ") << iter + 1;
-      ClustRVizLogger::info("gamma = ") << problem.gamma;
-
       int k = 0;
+      CLUSTRVIZ_PROFILE_NEW_GAMMA(problem.profile);
 
       // Save fusions to determine if we need to back-track
       problem.save_fusions();
@@ -215,9 +223,12 @@ public:
         // Run ADMM till convergence
         // Before running the ADMM, we need to reset the auxiliary variables each time.
         problem.gamma = gamma;
+        bool converged = false;
         do {
+          problem.screen_edges(k);
           problem.save_old_values();
           problem.admm_step();
+          CLUSTRVIZ_PROFILE_INNER_ITERATION(problem.profile);
           iter++; k++;
 
           // problem.tick() will check for interrupts
@@ -229,9 +240,11 @@ public:
             break; // Avoid infinite loops on a single lambda...
           }
 
-        } while (!problem.admm_converged(thresh));
+          converged = problem.admm_converged(thresh);
+          CLUSTRVIZ_TRACE(problem, TRACE_STEP, iter, k, problem.u_change());
+        } while (!converged);
 
-        ClustRVizLogger::info("ADMM converged with gamma = ") << problem.gamma << " after " << iter << " total iterations.";
+        CLUSTRVIZ_TRACE(problem, converged ? TRACE_CONVERGED : TRACE_NOT_CONVERGED, iter, k, problem.u_change());
 
         try_iter++;
         if(try_iter > viz_max_inner_iter){
@@ -248,7 +261,7 @@ public:
           // no need to back-track (we didn't miss any fusions) so we can go immediately
           // to the next iteration.
           rep_iter = false;
-          ClustRVizLogger::info("No fusions identified -- continuing to next step.");
+          CLUSTRVIZ_TRACE(problem, TRACE_NO_FUSIONS, iter, try_iter, problem.u_change());
         } else if(problem.multiple_fusions()){
           // If we see two (or more) new fusions, we need to back-track and figure
           // out which one occured first
@@ -259,19 +272,21 @@ public:
             gamma_upper = gamma;
             gamma = 0.5 * (gamma_lower + gamma_upper);
           }
-          ClustRVizLogger::info("Too many fusions -- backtracking.");
+          CLUSTRVIZ_PROFILE_BACKTRACK_RETRY(problem.profile);
+          CLUSTRVIZ_TRACE(problem, TRACE_BACKTRACK, iter, try_iter, problem.u_change());
         } else if(!problem.is_interesting_iter()){
           // If we don't observe any new fusions, we move our regularization level
           // up to try to find one
           problem.load_old_fusions();
           gamma_lower = gamma;
           gamma = 0.5 * (gamma_lower + gamma_upper);
-          ClustRVizLogger::info("Fusion not isolated -- moving forward.");
+          CLUSTRVIZ_PROFILE_BACKTRACK_RETRY(problem.profile);
+          CLUSTRVIZ_TRACE(problem, TRACE_FORWARD, iter, try_iter, problem.u_change());
         } else {
           // If we see exactly one new fusion, we have a good step size and exit
           // the inner back-tracking loop
           rep_iter = false;
-          ClustRVizLogger::info("Good iteration - continuing to next step.");
+          CLUSTRVIZ_TRACE(problem, TRACE_ACCEPT, iter, try_iter, problem.u_change());
         }
       }
 
@@ -296,10 +311,10 @@ public:
     solved = true;
   }
 
-  Rcpp::List build_return_object(){
+  typename PROBLEM_TYPE::PathType extract_path(){
     if(!solved) solve();
 
-    return problem.build_return_object();
+    return problem.extract_path();
   }
 private:
   PROBLEM_TYPE problem;
@@ -0,0 +1,33 @@
+#include "clustRviz.h"
+
+// Readers for path files written by the solvers (see path_store.h)
+
+// Dimensions, gamma path and fusion indicators of a path file (everything but U)
+// [[Rcpp::export(rng = false)]]
+Rcpp::List path_store_info(std::string path_file){
+  PathStoreReader reader(path_file);
+
+  return Rcpp::List::create(Rcpp::Named("n")           = static_cast<double>(reader.header.n),
+                            Rcpp::Named("p")           = static_cast<double>(reader.header.p),
+                            Rcpp::Named("num_edges")   = static_cast<double>(reader.header.num_edges),
+                            Rcpp::Named("num_iters")   = static_cast<double>(reader.header.num_iters),
+                            Rcpp::Named("gamma_path")  = reader.read_gamma_path(),
+                            Rcpp::Named("v_zero_inds") = reader.read_v_zero_inds());
+}
+
+// Read selected iterates (one-based indices) of the U path as an n-by-p-by-length(indices)
+// array: only the requested iterates are read from disk
+// [[Rcpp::export(rng = false)]]
+Rcpp::NumericVector path_store_read(std::string path_file, const Eigen::VectorXi& indices){
+  PathStoreReader reader(path_file);
+
+  const int64_t n = reader.header.n;
+  const int64_t p = reader.header.p;
+
+  Rcpp::NumericVector result(Rcpp::Dimension(n, p, indices.size()));
+  for(Eigen::Index k = 0; k < indices.size(); k++){
+    reader.read_iterate(indices(k) - 1, result.begin() + k * n * p);
+  }
+
+  return result;
+}
@@ -0,0 +1,197 @@
+#ifndef CLUSTRVIZ_PATH_STORE_H
+#define CLUSTRVIZ_PATH_STORE_H 1
+
+#include "clustRviz_base.h"
+#include "clustRviz_logging.h"
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// On-disk storage for U paths
+//
+// For large n * p, the U path of a long run may not fit in memory, so the solvers can
+// instead stream each stored iterate to an append-only binary file, from which R code
+// later reads individual iterates as needed. The file layout is
+//
+//   - a fixed-size header (PathStoreHeader) giving the problem dimensions, the number
+//     of stored iterates (K) and the offset of the trailer;
+//   - K "chunks", each holding one n-by-p iterate of U as n * p doubles (column-major,
+//     as in R), in the order they were stored;
+//   - a trailer holding the K gamma values (doubles) and the num_edges-by-K fusion
+//     indicators (32-bit ints, column-major).
+//
+// The header is written with K = 0 when the file is created and re-written once the
+// path is complete (see PathStoreWriter::finalize), so an incomplete file (e.g., from
+// an interrupted run) is detected when it is opened for reading. Values are stored in
+// native byte order: path files are scratch space for a single analysis, not an
+// interchange format.
+
+#define CLUSTRVIZ_PATH_STORE_MAGIC "CRVPATH1"
+
+struct PathStoreHeader {
+  char magic[8];
+  int64_t n;
+  int64_t p;
+  int64_t num_edges;
+  int64_t num_iters;
+  int64_t trailer_offset;
+};
+
+// Path file errors. The error hook must not return, but we can't carry on with a
+// missing or broken file if it somehow does, so these always throw
+[[noreturn]] inline void path_store_error(const std::string& msg){
+  ClustRVizLogger::error(msg);
+  throw ClustRVizError(msg);
+}
+
+// 64-bit safe seek (a long is only 32 bits on Windows)
+inline bool path_store_seek(std::FILE* f, int64_t offset){
+#ifdef _WIN32
+  return _fseeki64(f, offset, SEEK_SET) == 0;
+#else
+  return fseeko(f, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+}
+
+// Offset of the k-th (zero-based) iterate in a path file
+inline int64_t path_store_chunk_offset(const PathStoreHeader& header, int64_t k){
+  return static_cast<int64_t>(sizeof(PathStoreHeader)) + k * header.n * header.p * static_cast<int64_t>(sizeof(double));
+}
+
+// Appends iterates to a new path file
+//
+// The problem classes hold this by shared_ptr (since the solver policies take
+// copies of the problem), so the file is closed once the last copy goes away
+class PathStoreWriter {
+public:
+  PathStoreWriter(const std::string& file_name, Eigen::Index n, Eigen::Index p, Eigen::Index num_edges):
+  file(std::fopen(file_name.c_str(), "wb")),
+  buffer(n * p) {
+    if(!file){
+      path_store_error("Could not open path file " + file_name + " for writing.");
+    }
+
+    std::memcpy(header.magic, CLUSTRVIZ_PATH_STORE_MAGIC, sizeof(header.magic));
+    header.n              = n;
+    header.p              = p;
+    header.num_edges      = num_edges;
+    header.num_iters      = 0;
+    header.trailer_offset = 0;
+
+    write_header();
+  }
+
+  ~PathStoreWriter(){
+    if(file){
+      std::fclose(file);
+    }
+  }
+
+  template <typename Derived>
+  void append(const Eigen::MatrixBase<Derived>& U){
+    // Always store doubles, so the file doesn't depend on the solver precision
+    Eigen::Map<Eigen::MatrixXd>(buffer.data(), U.rows(), U.cols()) = U.template cast<double>();
+    write(buffer.data(), sizeof(double), buffer.size());
+    header.num_iters++;
+  }
+
+  void finalize(const Eigen::VectorXd& gamma_path, const Eigen::MatrixXi& v_zero_inds){
+    header.trailer_offset = path_store_chunk_offset(header, header.num_iters);
+
+    const Eigen::Matrix<int32_t, Eigen::Dynamic, Eigen::Dynamic> v_zero_inds_32 = v_zero_inds.cast<int32_t>();
+    write(gamma_path.data(), sizeof(double), gamma_path.size());
+    write(v_zero_inds_32.data(), sizeof(int32_t), v_zero_inds_32.size());
+
+    // Now that the path is complete, record its length and where to find the trailer
+    if(!path_store_seek(file, 0)){
+      path_store_error("Could not finalize path file.");
+    }
+    write_header();
+    std::fflush(file);
+  }
+
+private:
+  std::FILE* file;
+  PathStoreHeader header;
+  std::vector<double> buffer; // Conversion buffer for single precision iterates
+
+  void write(const void* data, std::size_t size, std::size_t count){
+    if(std::fwrite(data, size, count, file) != count){
+      path_store_error("Could not write to path file (is the disk full?)");
+    }
+  }
+
+  void write_header(){
+    write(&header, sizeof(PathStoreHeader), 1);
+  }
+
+  // Not copyable (we own the file handle)
+  PathStoreWriter(const PathStoreWriter&);
+  PathStoreWriter& operator=(const PathStoreWriter&);
+};
+
+// Reads (parts of) a completed path file
+class PathStoreReader {
+public:
+  PathStoreHeader header;
+
+  PathStoreReader(const std::string& file_name):
+  file(std::fopen(file_name.c_str(), "rb")) {
+    if(!file){
+      path_store_error("Could not open path file " + file_name + " for reading.");
+    }
+
+    if((std::fread(&header, sizeof(PathStoreHeader), 1, file) != 1) ||
+       (std::memcmp(header.magic, CLUSTRVIZ_PATH_STORE_MAGIC, sizeof(header.magic)) != 0)){
+      std::fclose(file);
+      path_store_error(file_name + " is not a clustRviz path file.");
+    }
+
+    if(header.trailer_offset == 0){
+      std::fclose(file);
+      path_store_error(file_name + " is incomplete (was the solver interrupted?)");
+    }
+  }
+
+  ~PathStoreReader(){
+    std::fclose(file);
+  }
+
+  // Read the k-th (zero-based) iterate into out (which must hold n * p doubles)
+  void read_iterate(int64_t k, double* out){
+    if((k < 0) || (k >= header.num_iters)){
+      path_store_error("Path index out of range.");
+    }
+    read(path_store_chunk_offset(header, k), out, sizeof(double), header.n * header.p);
+  }
+
+  Eigen::VectorXd read_gamma_path(){
+    Eigen::VectorXd gamma_path(header.num_iters);
+    read(header.trailer_offset, gamma_path.data(), sizeof(double), header.num_iters);
+    return gamma_path;
+  }
+
+  Eigen::MatrixXi read_v_zero_inds(){
+    Eigen::Matrix<int32_t, Eigen::Dynamic, Eigen::Dynamic> v_zero_inds_32(header.num_edges, header.num_iters);
+    read(header.trailer_offset + header.num_iters * static_cast<int64_t>(sizeof(double)),
+         v_zero_inds_32.data(), sizeof(int32_t), v_zero_inds_32.size());
+    return v_zero_inds_32.cast<int>();
+  }
+
+private:
+  std::FILE* file;
+
+  void read(int64_t offset, void* data, std::size_t size, std::size_t count){
+    if(!path_store_seek(file, offset) || (std::fread(data, size, count, file) != count)){
+      path_store_error("Could not read from path file (was it truncated?)");
+    }
+  }
+
+  // Not copyable (we own the file handle)
+  PathStoreReader(const PathStoreReader&);
+  PathStoreReader& operator=(const PathStoreReader&);
+};
+
+#endif
@@ -0,0 +1,163 @@
+#ifndef CLUSTRVIZ_PROFILE_H
+#define CLUSTRVIZ_PROFILE_H 1
+
+#include "clustRviz_base.h"
+
+// Hot-path profiling
+//
+// The problem classes time each phase of their ADMM steps (and storage) with a
+// steady clock, and the solver policies count inner iterations and back-tracking
+// retries (and edge screening, see screening.h, its certificates), all in a
+// SolverProfile which is carried along with the solution path (and returned to R
+// as its `profile` element, see r_adapter.h).
+//
+// This is on by default (a handful of clock reads per ADMM step is negligible next to
+// the step itself), but compiling with -DCLUSTRVIZ_PROFILE=0 (e.g., in PKG_CPPFLAGS)
+// removes it entirely: the macros below expand to nothing, SolverProfile is empty
+// (enabled() is false) and the `profile` element is NULL.
+#ifndef CLUSTRVIZ_PROFILE
+#define CLUSTRVIZ_PROFILE 1
+#endif
+
+#if CLUSTRVIZ_PROFILE
+#include <chrono>
+#endif
+
+enum ProfilePhase {
+  PROFILE_U_SOLVE = 0,
+  PROFILE_PROX,
+  PROFILE_DUAL_UPDATE,
+  PROFILE_CONVERGENCE_CHECK,
+  PROFILE_STORE_VALUES,
+  PROFILE_NUM_PHASES
+};
+
+#if CLUSTRVIZ_PROFILE
+
+class SolverProfile {
+public:
+  SolverProfile(): backtrack_retries(0), screen_checks(0), screened_fused(0), screened_nonzero(0), screened_edges(0) {
+    for(int k = 0; k < PROFILE_NUM_PHASES; k++){
+      seconds[k] = 0;
+      calls[k]   = 0;
+    }
+  }
+
+  void add_time(ProfilePhase phase, double elapsed){
+    seconds[phase] += elapsed;
+    calls[phase]++;
+  }
+
+  // Called by the policies at the start of each new gamma and after each ADMM step
+  void new_gamma(){
+    inner_iterations.push_back(0);
+  }
+
+  void inner_iteration(){
+    if(inner_iterations.empty()){
+      new_gamma();
+    }
+    inner_iterations.back()++;
+  }
+
+  void backtrack_retry(){
+    backtrack_retries++;
+  }
+
+  // Called by edge screening (see screening.h) after each check
+  void edge_screen(long long fused, long long nonzero, long long edges){
+    screen_checks++;
+    screened_fused   += fused;
+    screened_nonzero += nonzero;
+    screened_edges   += edges;
+  }
+
+  static bool enabled(){
+    return true;
+  }
+
+  double phase_seconds(ProfilePhase phase) const {
+    return seconds[phase];
+  }
+
+  long long phase_calls(ProfilePhase phase) const {
+    return calls[phase];
+  }
+
+  long long num_backtrack_retries() const {
+    return backtrack_retries;
+  }
+
+  const std::vector<int>& inner_iterations_per_gamma() const {
+    return inner_iterations;
+  }
+
+  long long num_screen_checks() const {
+    return screen_checks;
+  }
+
+  // Fraction of edges certified to fuse (or to stay nonzero), averaged over screening checks
+  double screened_fused_fraction() const {
+    return (screened_edges > 0) ? static_cast<double>(screened_fused) / screened_edges : 0;
+  }
+
+  double screened_nonzero_fraction() const {
+    return (screened_edges > 0) ? static_cast<double>(screened_nonzero) / screened_edges : 0;
+  }
+
+private:
+  double seconds[PROFILE_NUM_PHASES];
+  long long calls[PROFILE_NUM_PHASES];
+  long long backtrack_retries;
+  long long screen_checks;
+  long long screened_fused;
+  long long screened_nonzero;
+  long long screened_edges;
+  std::vector<int> inner_iterations; // ADMM steps taken at each outer iteration (including back-tracking)
+};
+
+// Charges the time since it was created (or last charged) to a phase, so that
+// consecutive phases of a step can be timed with one clock read each
+class ProfileTimer {
+public:
+  ProfileTimer(SolverProfile& profile_):
+  profile(profile_),
+  start(std::chrono::steady_clock::now()) {}
+
+  void lap(ProfilePhase phase){
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    profile.add_time(phase, std::chrono::duration<double>(now - start).count());
+    start = now;
+  }
+
+private:
+  SolverProfile& profile;
+  std::chrono::steady_clock::time_point start;
+};
+
+#define CLUSTRVIZ_PROFILE_TIMER(profile) ProfileTimer clustrviz_profile_timer(profile)
+#define CLUSTRVIZ_PROFILE_LAP(phase) clustrviz_profile_timer.lap(phase)
+#define CLUSTRVIZ_PROFILE_NEW_GAMMA(profile) (profile).new_gamma()
+#define CLUSTRVIZ_PROFILE_INNER_ITERATION(profile) (profile).inner_iteration()
+#define CLUSTRVIZ_PROFILE_BACKTRACK_RETRY(profile) (profile).backtrack_retry()
+#define CLUSTRVIZ_PROFILE_SCREEN(profile, fused, nonzero, edges) (profile).edge_screen(fused, nonzero, edges)
+
+#else
+
+class SolverProfile {
+public:
+  static bool enabled(){
+    return false;
+  }
+};
+
+#define CLUSTRVIZ_PROFILE_TIMER(profile)
+#define CLUSTRVIZ_PROFILE_LAP(phase)
+#define CLUSTRVIZ_PROFILE_NEW_GAMMA(profile)
+#define CLUSTRVIZ_PROFILE_INNER_ITERATION(profile)
+#define CLUSTRVIZ_PROFILE_BACKTRACK_RETRY(profile)
+#define CLUSTRVIZ_PROFILE_SCREEN(profile, fused, nonzero, edges)
+
+#endif
+
+#endif
@@ -0,0 +1,138 @@
+#ifndef CLUSTRVIZ_R_ADAPTER_H
+#define CLUSTRVIZ_R_ADAPTER_H 1
+
+#include <RcppEigen.h>
+#include "clustRviz_core.h"
+
+// Conversion of solver results to R objects
+//
+// The solver core returns plain Eigen / STL objects (see clustRviz_core.h); these
+// helpers build the lists the R code expects from them. They may only be called
+// from the main R thread.
+
+// Copy a stored U path (one vectorized n-by-p iterate per column) into a newly
+// allocated n-by-p-by-K R array
+//
+// This is the only copy made when returning the path to R: the solvers store
+// their path buffers in place (see extract_path), and the result already carries
+// its dim attribute, so R code does not need to reshape it with array()
+template <typename Scalar>
+Rcpp::NumericVector u_path_to_r_array(const MatrixXs<Scalar>& u_path, Eigen::Index n, Eigen::Index p){
+  Rcpp::NumericVector result(Rcpp::Dimension(n, p, u_path.cols()));
+  Eigen::Map<Eigen::MatrixXd>(result.begin(), u_path.rows(), u_path.cols()) = u_path.template cast<double>();
+  return result;
+}
+
+#if CLUSTRVIZ_PROFILE
+
+template <typename T>
+Rcpp::NumericVector profile_by_phase(T (SolverProfile::*value)(ProfilePhase) const, const SolverProfile& profile){
+  return Rcpp::NumericVector::create(Rcpp::Named("u_solve")           = static_cast<double>((profile.*value)(PROFILE_U_SOLVE)),
+                                     Rcpp::Named("prox")              = static_cast<double>((profile.*value)(PROFILE_PROX)),
+                                     Rcpp::Named("dual_update")       = static_cast<double>((profile.*value)(PROFILE_DUAL_UPDATE)),
+                                     Rcpp::Named("convergence_check") = static_cast<double>((profile.*value)(PROFILE_CONVERGENCE_CHECK)),
+                                     Rcpp::Named("store_values")      = static_cast<double>((profile.*value)(PROFILE_STORE_VALUES)));
+}
+
+inline Rcpp::RObject to_r(const SolverProfile& profile){
+  return Rcpp::List::create(Rcpp::Named("seconds")           = profile_by_phase(&SolverProfile::phase_seconds, profile),
+                            Rcpp::Named("calls")             = profile_by_phase(&SolverProfile::phase_calls, profile),
+                            Rcpp::Named("backtrack_retries") = static_cast<double>(profile.num_backtrack_retries()),
+                            Rcpp::Named("inner_iterations")  = Rcpp::wrap(profile.inner_iterations_per_gamma()),
+                            Rcpp::Named("screening")         = Rcpp::NumericVector::create(
+                              Rcpp::Named("checks")           = static_cast<double>(profile.num_screen_checks()),
+                              Rcpp::Named("fused_fraction")   = profile.screened_fused_fraction(),
+                              Rcpp::Named("nonzero_fraction") = profile.screened_nonzero_fraction()));
+}
+
+#else
+
+inline Rcpp::RObject to_r(const SolverProfile&){
+  return Rcpp::RObject(); // NULL
+}
+
+#endif
+
+// One row per traced event (oldest first), with the number of events dropped from
+// the ring buffer as its "dropped" attribute -- NULL if tracing was off
+inline Rcpp::RObject to_r(const SolverTrace& trace){
+  if(!trace.enabled()){
+    return Rcpp::RObject(); // NULL
+  }
+
+  std::vector<TraceEvent> events = trace.events_in_order();
+  const std::size_t num_events = events.size();
+
+  Rcpp::CharacterVector event(num_events);
+  Rcpp::IntegerVector iteration(num_events);
+  Rcpp::IntegerVector inner_iteration(num_events);
+  Rcpp::NumericVector gamma(num_events);
+  Rcpp::IntegerVector fusions(num_events);
+  Rcpp::NumericVector u_change(num_events);
+
+  for(std::size_t i = 0; i < num_events; i++){
+    event[i]           = trace_event_name(events[i].type);
+    iteration[i]       = events[i].iteration;
+    inner_iteration[i] = events[i].inner_iteration;
+    gamma[i]           = events[i].gamma;
+    fusions[i]         = events[i].fusions;
+    u_change[i]        = std::isnan(events[i].u_change) ? NA_REAL : events[i].u_change;
+  }
+
+  Rcpp::DataFrame result = Rcpp::DataFrame::create(Rcpp::Named("event")           = event,
+                                                   Rcpp::Named("iteration")       = iteration,
+                                                   Rcpp::Named("inner_iteration") = inner_iteration,
+                                                   Rcpp::Named("gamma")           = gamma,
+                                                   Rcpp::Named("fusions")         = fusions,
+                                                   Rcpp::Named("u_change")        = u_change,
+                                                   Rcpp::Named("stringsAsFactors") = false);
+  result.attr("dropped") = static_cast<double>(trace.num_dropped());
+  return result;
+}
+
+template <typename Scalar>
+Rcpp::List to_r(const ClusteringPath<Scalar>& path){
+  Rcpp::RObject u_path_r; // NULL if on disk: R code reads the path file directly
+  if(!path.on_disk){
+    u_path_r = u_path_to_r_array(path.u_path, path.n, path.p);
+  }
+
+  return Rcpp::List::create(Rcpp::Named("u_path")      = u_path_r,
+                            Rcpp::Named("v_path")      = path.v_path,
+                            Rcpp::Named("v_zero_inds") = path.v_zero_inds,
+                            Rcpp::Named("gamma_path")  = path.gamma_path,
+                            Rcpp::Named("profile")     = to_r(path.profile),
+                            Rcpp::Named("trace")       = to_r(path.trace));
+}
+
+template <typename Scalar>
+Rcpp::List to_r(const BiClusteringPath<Scalar>& path){
+  return Rcpp::List::create(Rcpp::Named("u_path")          = u_path_to_r_array(path.u_path, path.n, path.p),
+                            Rcpp::Named("v_row_path")      = path.v_row_path,
+                            Rcpp::Named("v_col_path")      = path.v_col_path,
+                            Rcpp::Named("v_row_zero_inds") = path.v_row_zero_inds,
+                            Rcpp::Named("v_col_zero_inds") = path.v_col_zero_inds,
+                            Rcpp::Named("gamma_path")      = path.gamma_path,
+                            Rcpp::Named("profile")         = to_r(path.profile),
+                            Rcpp::Named("trace")           = to_r(path.trace));
+}
+
+template <typename Scalar>
+Rcpp::List to_r(const MultiClusteringPath<Scalar>& path){
+  Rcpp::List result(path.paths.size());
+  for(std::size_t k = 0; k < path.paths.size(); k++){
+    result[k] = to_r(path.paths[k]);
+  }
+  return result;
+}
+
+// Cluster assignments, with R's (1-based) cluster labels
+inline Rcpp::List to_r(const ClusterAssignment& assignment){
+  Eigen::VectorXi membership = assignment.membership.array() + 1;
+
+  return Rcpp::List::create(Rcpp::Named("membership") = membership,
+                            Rcpp::Named("csize")      = assignment.sizes,
+                            Rcpp::Named("no")         = assignment.num_clusters);
+}
+
+#endif
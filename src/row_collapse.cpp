@@ -0,0 +1,120 @@
+#include "clustRviz_core.h"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+// Grouping rows by hashing (see row_collapse.h)
+//
+// Each row is reduced to a key -- the bit patterns of its values for exact
+// duplicates, or the indices of its grid cell -- and rows are looked up by a hash
+// of their key; rows with the same hash are compared key by key, so collisions
+// only cost time. This is a single O(np) pass over X.
+
+// Key of one entry of a row
+static inline int64_t entry_key(double x, double tol){
+  if(tol > 0){
+    return static_cast<int64_t>(std::floor(x / tol));
+  }
+  if(x == 0){
+    x = 0; // -0.0 and 0.0 are the same value
+  }
+  int64_t bits;
+  std::memcpy(&bits, &x, sizeof(bits));
+  return bits;
+}
+
+static bool same_key(const Eigen::MatrixXd& X, Eigen::Index i, Eigen::Index j, double tol){
+  for(Eigen::Index col = 0; col < X.cols(); col++){
+    if(entry_key(X(i, col), tol) != entry_key(X(j, col), tol)){
+      return false;
+    }
+  }
+  return true;
+}
+
+RowCollapse collapse_rows(const Eigen::MatrixXd& X, double tol){
+  const Eigen::Index n = X.rows();
+  const Eigen::Index p = X.cols();
+
+  if(!(tol >= 0) || !std::isfinite(tol)){
+    ClustRVizLogger::error("The collapsing tolerance must be a non-negative number.");
+  }
+  if(!X.allFinite()){
+    ClustRVizLogger::error("Rows with missing or infinite values cannot be collapsed.");
+  }
+
+  // FNV-1a style hash of each row's key, mixed entry by entry
+  std::vector<uint64_t> hashes(n, 1469598103934665603ULL);
+  for(Eigen::Index col = 0; col < p; col++){
+    for(Eigen::Index i = 0; i < n; i++){
+      uint64_t key = static_cast<uint64_t>(entry_key(X(i, col), tol));
+      key ^= key >> 33;
+      key *= 0xff51afd7ed558ccdULL;
+      key ^= key >> 33;
+      hashes[i] = (hashes[i] ^ key) * 1099511628211ULL;
+    }
+  }
+
+  // Groups (by first row) with each hash
+  std::unordered_map<uint64_t, std::vector<int> > groups_by_hash;
+  groups_by_hash.reserve(n);
+  std::vector<int> first_row;
+  Eigen::VectorXi group(n);
+
+  for(Eigen::Index i = 0; i < n; i++){
+    std::vector<int>& candidates = groups_by_hash[hashes[i]];
+    int found = -1;
+    for(std::size_t c = 0; c < candidates.size(); c++){
+      if(same_key(X, first_row[candidates[c]], i, tol)){
+        found = candidates[c];
+        break;
+      }
+    }
+    if(found == -1){
+      found = first_row.size();
+      first_row.push_back(i);
+      candidates.push_back(found);
+    }
+    group(i) = found;
+  }
+
+  return collapse_rows_by_group(X, group);
+}
+
+// Group means and multiplicities, from the (zero-based) group of each row: groups
+// must be numbered in order of their first rows
+RowCollapse collapse_rows_by_group(const Eigen::MatrixXd& X, const Eigen::VectorXi& group){
+  const Eigen::Index n = X.rows();
+
+  if(group.size() != n){
+    ClustRVizLogger::error("There must be one group label for each row.");
+  }
+
+  RowCollapse result;
+  result.group = group;
+
+  int num_groups = 0;
+  std::vector<int> first_row;
+  for(Eigen::Index i = 0; i < n; i++){
+    if((group(i) < 0) || (group(i) > num_groups)){
+      ClustRVizLogger::error("Groups must be numbered 0, 1, ... in order of their first rows.");
+    }
+    if(group(i) == num_groups){
+      first_row.push_back(i);
+      num_groups++;
+    }
+  }
+
+  result.first_row = Eigen::Map<Eigen::VectorXi>(first_row.data(), num_groups);
+  result.multiplicity.setZero(num_groups);
+  result.X.setZero(num_groups, X.cols());
+  for(Eigen::Index i = 0; i < n; i++){
+    result.X.row(group(i)) += X.row(i);
+    result.multiplicity(group(i)) += 1;
+  }
+  result.X.array().colwise() /= result.multiplicity.array();
+
+  return result;
+}
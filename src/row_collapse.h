@@ -0,0 +1,156 @@
+#ifndef CLUSTRVIZ_ROW_COLLAPSE_H
+#define CLUSTRVIZ_ROW_COLLAPSE_H 1
+
+#include "clustRviz_base.h"
+#include "clustering_impl.h"
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+// Collapsing duplicate (and near-duplicate) rows
+//
+// Repeated rows of X add rows to U, edges to D and fusion events which the solvers
+// have to find one at a time, although identical rows are fused from the start of
+// the path. Instead, rows are grouped by hashing -- exact duplicates, or (with
+// tol > 0) rows falling in the same cell of a grid of width tol -- and the problem
+// is solved on one row per group, the mean of its members, with the loss weighted
+// by the group sizes (multiplicities) m:
+//
+//   sum_i m_i ||xbar_i - u_i||^2 / 2 + gamma * sum_l w_l ||(DU)_l||
+//
+// which is the original loss of rows constrained to share a centroid, up to a
+// constant, if w_l is the sum of the weights between the members of the two groups
+// (as CARP does for a user-supplied weight matrix). Identical rows with identical
+// weights are fused from the start, so the path is then that of the original rows.
+// Weights computed on the collapsed rows instead (weight functions, and the default
+// RBF weights of the CLI) give one weight per pair of groups, so the path is that
+// of the distinct rows weighted by their multiplicities.
+//
+// The path is then expanded back to the original rows (expand_clustering_path), so
+// memberships and the dendrogram are computed as usual: the group members are joined
+// by edges from the first row of each group which are fused from the second (gamma
+// = 0) iterate on, after an extra first iterate of the original, unfused, data.
+struct RowCollapse {
+  Eigen::MatrixXd X;            // Group means, one row per group
+  Eigen::VectorXd multiplicity; // Number of rows in each group
+  Eigen::VectorXi group;        // Group of each row (zero-based, in order of first appearance)
+  Eigen::VectorXi first_row;    // First row of each group
+
+  Eigen::Index num_groups() const {
+    return X.rows();
+  }
+};
+
+// Prototypes - row_collapse.cpp
+RowCollapse collapse_rows(const Eigen::MatrixXd&, double);
+
+RowCollapse collapse_rows_by_group(const Eigen::MatrixXd&, const Eigen::VectorXi&);
+
+// Edges of the expanded graph (in lexicographic order), from the edges between
+// groups (joining their first rows, in the same orientation, since the first rows
+// are in the same order as the groups) and the edges from the first row of each
+// group to its other members: source(e) is the edge of the collapsed graph for the
+// former and -1 for the latter
+inline Eigen::MatrixXi expanded_edge_list(const RowCollapse& collapse,
+                                          const Eigen::MatrixXi& edge_list,
+                                          Eigen::VectorXi& source){
+  const Eigen::Index n = collapse.group.size();
+  typedef std::pair<std::pair<int, int>, int> SourcedEdge;
+  std::vector<SourcedEdge> edges;
+  edges.reserve(edge_list.rows() + n - collapse.num_groups());
+
+  for(Eigen::Index l = 0; l < edge_list.rows(); l++){
+    edges.push_back(SourcedEdge(std::make_pair(collapse.first_row(edge_list(l, 0)),
+                                               collapse.first_row(edge_list(l, 1))), l));
+  }
+  for(Eigen::Index i = 0; i < n; i++){
+    const int first = collapse.first_row(collapse.group(i));
+    if(first != i){
+      edges.push_back(SourcedEdge(std::make_pair(first, static_cast<int>(i)), -1));
+    }
+  }
+  std::sort(edges.begin(), edges.end());
+
+  Eigen::MatrixXi result(edges.size(), 2);
+  source.resize(edges.size());
+  for(std::size_t e = 0; e < edges.size(); e++){
+    result(e, 0) = edges[e].first.first;
+    result(e, 1) = edges[e].first.second;
+    source(e)    = edges[e].second;
+  }
+
+  return result;
+}
+
+// Solution path of the collapsed problem, expanded to the original rows X (with the
+// edges given by expanded_edge_list)
+template <typename Scalar>
+ClusteringPath<Scalar> expand_clustering_path(const ClusteringPath<Scalar>& path,
+                                              const RowCollapse& collapse,
+                                              const MatrixXs<Scalar>& X,
+                                              const Eigen::MatrixXi& edge_list,
+                                              const Eigen::VectorXi& source){
+  const Eigen::Index n = X.rows();
+  const Eigen::Index p = X.cols();
+  const Eigen::Index n_groups = collapse.num_groups();
+  const Eigen::Index num_edges = edge_list.rows();
+  const Eigen::Index num_group_edges = path.v_zero_inds.rows();
+  const Eigen::Index num_iters = path.gamma_path.size() + 1;
+
+  ClusteringPath<Scalar> result;
+  result.n = n;
+  result.p = p;
+  result.on_disk = path.on_disk;
+  result.profile = path.profile;
+  result.trace = path.trace;
+
+  result.gamma_path.resize(num_iters);
+  result.gamma_path(0) = 0;
+  result.gamma_path.tail(num_iters - 1) = path.gamma_path;
+
+  // First iterate: the original data, with nothing fused
+  result.v_zero_inds.resize(num_edges, num_iters);
+  result.v_zero_inds.col(0).setZero();
+  for(Eigen::Index e = 0; e < num_edges; e++){
+    if(source(e) >= 0){
+      result.v_zero_inds.row(e).tail(num_iters - 1) = path.v_zero_inds.row(source(e));
+    } else {
+      result.v_zero_inds.row(e).tail(num_iters - 1).setOnes();
+    }
+  }
+
+  if(path.u_path.size() > 0){
+    result.u_path.resize(n * p, num_iters);
+    result.u_path.col(0) = Eigen::Map<const VectorXs<Scalar> >(X.data(), n * p);
+    for(Eigen::Index k = 1; k < num_iters; k++){
+      Eigen::Map<const MatrixXs<Scalar> > U(path.u_path.col(k - 1).data(), n_groups, p);
+      Eigen::Map<MatrixXs<Scalar> > U_expanded(result.u_path.col(k).data(), n, p);
+      for(Eigen::Index i = 0; i < n; i++){
+        U_expanded.row(i) = U.row(collapse.group(i));
+      }
+    }
+  }
+
+  if(path.v_path.size() > 0){
+    result.v_path.resize(num_edges * p, num_iters);
+    Eigen::Map<MatrixXs<Scalar> > V_first(result.v_path.col(0).data(), num_edges, p);
+    for(Eigen::Index e = 0; e < num_edges; e++){
+      V_first.row(e) = X.row(edge_list(e, 0)) - X.row(edge_list(e, 1));
+    }
+    for(Eigen::Index k = 1; k < num_iters; k++){
+      Eigen::Map<const MatrixXs<Scalar> > V(path.v_path.col(k - 1).data(), num_group_edges, p);
+      Eigen::Map<MatrixXs<Scalar> > V_expanded(result.v_path.col(k).data(), num_edges, p);
+      for(Eigen::Index e = 0; e < num_edges; e++){
+        if(source(e) >= 0){
+          V_expanded.row(e) = V.row(source(e));
+        } else {
+          V_expanded.row(e).setZero();
+        }
+      }
+    }
+  }
+
+  return result;
+}
+
+#endif
@@ -0,0 +1,263 @@
+#ifndef CLUSTRVIZ_SCREENING_H
+#define CLUSTRVIZ_SCREENING_H 1
+
+#include "clustRviz_base.h"
+#include "norm_policies.h"
+#include "profile.h"
+#include <algorithm>
+#include <numeric>
+#include <utility>
+
+// Gap-safe edge screening for the exact (ADMM) convex clustering solvers
+//
+// At a fixed gamma, the convex clustering problem
+//
+//   P(U) = 1/2 ||X - U||^2 + gamma * sum_l w_l ||(DU)_l||
+//
+// has dual D(L) = <D^T L, X> - 1/2 ||D^T L||^2 over L with ||L_l||_* <= gamma * w_l
+// (||.||_* the dual norm), and rho * Z (projected onto that set) is always a dual
+// feasible point. Every few ADMM steps, the duality gap G = P(U) - D(rho * Z) gives
+//
+//  - a ball around U holding the optimum U* (P is 1-strongly convex): ||U - U*|| <= sqrt(2G),
+//    so edges with ||(DU)_l|| > 2 sqrt(G) are certified to stay nonzero at this gamma;
+//  - a ball around D^T (rho * Z) holding D^T L* (D is 1-strongly concave in D^T L),
+//    also of radius sqrt(2G). If the graph is a forest, L_l is the sum of D^T L over
+//    either side of edge l, so with s_l the size of the smaller side,
+//    ||L*_l - L_l|| <= sqrt(s_l) sqrt(2G), and edges with
+//    ||L_l||_* + sqrt(s_l) sqrt(2G) < gamma * w_l are certified to fuse.
+//
+// Certified-fused edges have V_l pinned to zero, which does not change the optimum (it
+// already satisfies the constraint), so the prox and fusion count only run on the
+// remaining edges until gamma changes. Certificates are only valid at the gamma they
+// were computed for, and are recomputed every `interval` steps (0 turns screening off,
+// the default); it is not used with missing data, where P is not strongly convex, or
+// with multiplicity weights on the loss (see row_collapse.h), which change the dual.
+
+template <class NORM, typename Scalar>
+class EdgeScreen {
+public:
+  // interval is the number of steps between checks -- 0 turns screening off
+  EdgeScreen(const SpMatrixXs<Scalar>& D, const VectorXs<Scalar>& weights, bool unsupported, int interval_ = 0):
+  interval(unsupported ? 0 : std::max(interval_, 0)),
+  num_edges(D.rows()),
+  certified_gamma(-1),
+  num_fused(0) {
+    if(interval > 0){
+      D_double = D.template cast<double>();
+      weights_double = weights.template cast<double>();
+      fused_factors = forest_edge_factors(D);
+    }
+  }
+
+  bool enabled() const {
+    return interval > 0;
+  }
+
+  // Drop all certificates (e.g., if V is reset)
+  void reset(){
+    certified_gamma = -1;
+    num_fused = 0;
+    uncertain.clear();
+  }
+
+  // Called by the policies before each ADMM step (inner_iter = steps taken at this gamma)
+  template <class PROFILE_TYPE>
+  void update(int inner_iter,
+              double gamma,
+              double rho,
+              const MatrixXs<Scalar>& X,
+              const MatrixXs<Scalar>& U,
+              const MatrixXs<Scalar>& Z,
+              MatrixXs<Scalar>& V,
+              Eigen::ArrayXi& v_zeros,
+              PROFILE_TYPE& profile){
+    if(gamma != certified_gamma){
+      reset();
+      certified_gamma = gamma;
+    }
+
+    if((inner_iter == 0) || (inner_iter % interval != 0)){
+      return;
+    }
+
+    const Eigen::MatrixXd Ud = U.template cast<double>();
+    const Eigen::MatrixXd Xd = X.template cast<double>();
+    const Eigen::MatrixXd DU = D_double * Ud;
+
+    // Dual feasible point: rho * Z, scaled into the dual norm ball of each edge
+    Eigen::MatrixXd L = rho * Z.template cast<double>();
+    Eigen::VectorXd L_norm(num_edges);
+    for(Eigen::Index l = 0; l < num_edges; l++){
+      const double radius = gamma * weights_double(l);
+      L_norm(l) = NORM::dual_norm(L.row(l));
+      if(L_norm(l) > radius){
+        L.row(l) *= radius / L_norm(l);
+        L_norm(l) = radius;
+      }
+    }
+    const Eigen::MatrixXd DtL = D_double.transpose() * L;
+
+    const double primal = 0.5 * (Xd - Ud).squaredNorm() + gamma * NORM::row_penalty(DU, weights_double);
+    const double dual   = DtL.cwiseProduct(Xd).sum() - 0.5 * DtL.squaredNorm();
+    const double gap    = std::max(primal - dual, 0.0);
+
+    const double nonzero_radius = 2 * std::sqrt(gap);
+    const double dual_radius    = std::sqrt(2 * gap);
+    const bool can_fuse         = (fused_factors.size() == num_edges);
+
+    uncertain.clear();
+    num_fused = 0;
+    Eigen::Index num_nonzero = 0;
+    for(Eigen::Index l = 0; l < num_edges; l++){
+      if(can_fuse && (L_norm(l) + fused_factors(l) * dual_radius < gamma * weights_double(l))){
+        V.row(l).setZero();
+        v_zeros(l) = 1;
+        num_fused++;
+      } else {
+        uncertain.push_back(l);
+        num_nonzero += (DU.row(l).norm() > nonzero_radius);
+      }
+    }
+
+    CLUSTRVIZ_PROFILE_SCREEN(profile, num_fused, num_nonzero, num_edges);
+  }
+
+  // V-update: the prox on DU + Z for edges not certified to fuse, returning the number
+  // of fusions (including the certified ones)
+  Eigen::Index prox(RowProxKernel<Scalar> row_prox,
+                    const MatrixXs<Scalar>& DU,
+                    const MatrixXs<Scalar>& Z,
+                    Scalar lambda,
+                    const VectorXs<Scalar>& weights,
+                    MatrixXs<Scalar>& V,
+                    Eigen::ArrayXi& v_zeros){
+    if(num_fused == 0){
+      MatrixXs<Scalar> DUZ = DU + Z;
+      return row_prox(DUZ, lambda, weights, V, v_zeros);
+    }
+
+    const Eigen::Index k = uncertain.size();
+    const Eigen::Index p = DU.cols();
+    DUZ_buffer.resize(k, p);
+    V_buffer.resize(k, p);
+    weights_buffer.resize(k);
+    zeros_buffer.resize(k);
+
+    for(Eigen::Index r = 0; r < k; r++){
+      const Eigen::Index l = uncertain[r];
+      DUZ_buffer.row(r)  = DU.row(l) + Z.row(l);
+      weights_buffer(r) = weights(l);
+    }
+
+    const Eigen::Index nzeros = row_prox(DUZ_buffer, lambda, weights_buffer, V_buffer, zeros_buffer);
+
+    for(Eigen::Index r = 0; r < k; r++){
+      const Eigen::Index l = uncertain[r];
+      V.row(l)   = V_buffer.row(r);
+      v_zeros(l) = zeros_buffer(r);
+    }
+
+    return nzeros + num_fused;
+  }
+
+private:
+  int interval;
+  Eigen::Index num_edges;
+  SpMatrixXs<double> D_double;
+  Eigen::VectorXd weights_double;
+  Eigen::VectorXd fused_factors; // sqrt(s_l) for each edge (empty if D has cycles)
+
+  // Current certificates
+  double certified_gamma;
+  Eigen::Index num_fused;
+  std::vector<Eigen::Index> uncertain; // Edges not certified to fuse
+
+  // Work space for the prox on the uncertain edges
+  MatrixXs<Scalar> DUZ_buffer;
+  MatrixXs<Scalar> V_buffer;
+  VectorXs<Scalar> weights_buffer;
+  Eigen::ArrayXi zeros_buffer;
+
+  // If the edges of D form a forest, sqrt(size of the smaller side) of each edge,
+  // otherwise an empty vector
+  static Eigen::VectorXd forest_edge_factors(const SpMatrixXs<Scalar>& D){
+    const Eigen::Index n = D.cols();
+    const Eigen::Index num_edges = D.rows();
+
+    // Each row of D has its two end points (+1 and -1) as non-zeros
+    const SpMatrixXs<Scalar> Dt = D.transpose();
+    std::vector<Eigen::Index> parent(n);
+    std::iota(parent.begin(), parent.end(), 0);
+    std::vector<std::vector<std::pair<Eigen::Index, Eigen::Index> > > neighbors(n); // (vertex, edge)
+
+    for(Eigen::Index l = 0; l < num_edges; l++){
+      Eigen::Index ends[2];
+      int num_ends = 0;
+      for(typename SpMatrixXs<Scalar>::InnerIterator it(Dt, l); it && (num_ends < 2); ++it){
+        ends[num_ends++] = it.row();
+      }
+      if(num_ends != 2){
+        return Eigen::VectorXd();
+      }
+
+      Eigen::Index root_a = ends[0], root_b = ends[1];
+      while(parent[root_a] != root_a) root_a = parent[root_a] = parent[parent[root_a]];
+      while(parent[root_b] != root_b) root_b = parent[root_b] = parent[parent[root_b]];
+      if(root_a == root_b){
+        return Eigen::VectorXd(); // A cycle (or repeated edge)
+      }
+      parent[root_a] = root_b;
+
+      neighbors[ends[0]].push_back(std::make_pair(ends[1], l));
+      neighbors[ends[1]].push_back(std::make_pair(ends[0], l));
+    }
+
+    // Depth-first order of each tree, then subtree sizes in reverse order
+    std::vector<Eigen::Index> order;
+    std::vector<Eigen::Index> tree_root(n, -1);
+    std::vector<Eigen::Index> parent_edge(n, -1);
+    std::vector<Eigen::Index> parent_vertex(n, -1);
+    order.reserve(n);
+    for(Eigen::Index root = 0; root < n; root++){
+      if(tree_root[root] != -1){
+        continue;
+      }
+      std::vector<Eigen::Index> stack(1, root);
+      tree_root[root] = root;
+      while(!stack.empty()){
+        const Eigen::Index i = stack.back();
+        stack.pop_back();
+        order.push_back(i);
+        for(std::size_t k = 0; k < neighbors[i].size(); k++){
+          const Eigen::Index j = neighbors[i][k].first;
+          if(tree_root[j] == -1){
+            tree_root[j]     = root;
+            parent_vertex[j] = i;
+            parent_edge[j]   = neighbors[i][k].second;
+            stack.push_back(j);
+          }
+        }
+      }
+    }
+
+    std::vector<Eigen::Index> subtree_size(n, 1);
+    for(Eigen::Index k = n - 1; k >= 0; k--){
+      const Eigen::Index i = order[k];
+      if(parent_vertex[i] != -1){
+        subtree_size[parent_vertex[i]] += subtree_size[i];
+      }
+    }
+
+    Eigen::VectorXd factors(num_edges);
+    for(Eigen::Index i = 0; i < n; i++){
+      if(parent_edge[i] != -1){
+        const Eigen::Index tree_size = subtree_size[tree_root[i]];
+        factors(parent_edge[i]) = std::sqrt(static_cast<double>(std::min(subtree_size[i], tree_size - subtree_size[i])));
+      }
+    }
+
+    return factors;
+  }
+};
+
+#endif
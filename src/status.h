@@ -11,208 +11,304 @@
 #define CLUSTRVIZ_STATUS_H 1
 
 #include <unistd.h>
-#include <sys/time.h>
 
 #include <string>
-#include <sstream>
-#include <iomanip>
 #include <cmath>
-#include <cstring>
+#include <cstdio>
 #include <cstdlib>
-#include <ctime>
-
-#include <R.h>
-#include <Rinternals.h>
-#include <R_ext/Print.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 #include "clustRviz_base.h"
+#include "clustRviz_hooks.h"
 
+// Progress printing and interrupt polling
+//
+// The solver only publishes its progress (fusions, iteration and gamma) to relaxed
+// atomics on each tick. If progress is shown, a monitor thread, started on the first
+// tick, wakes every CLUSTRVIZ_STATUS_UPDATE_TIME_SECS of wall-clock time to render the
+// status line and poll for interrupts; a requested interrupt is signalled back to the
+// solver through an atomic flag, and acted on at its next tick.
+//
+// If the host hooks are not thread-safe (e.g., R's), the monitor thread instead
+// flags that a refresh is due, and the solver thread renders and polls itself at
+// its next tick -- so the host is only ever called from the thread running the solver.
+//
+// The (squared) norm of V, used for the percent fusion achieved, is comparatively
+// expensive, so it is only computed when needs_v_norm() says a refresh is coming.
+//
+// If progress is not shown, no thread is started: the solver thread itself reads the
+// clock every CLUSTRVIZ_INTERRUPT_CHECK_TICKS ticks and polls for interrupts (if an
+// interrupt check is installed) at the same wall-clock cadence. Neither is done inside
+// OpenMP parallel regions (see in_parallel_region()).
 class StatusPrinter {
 
 public:
-  StatusPrinter(bool show_progress,
-                unsigned int total_fusions,
-                std::string format = "",
-                int width = Rf_GetOptionWidth() - 2) :
-
+  StatusPrinter(bool show_progress, unsigned int total_fusions) :
   show_progress(show_progress),
-  count(0),
-  output_supported(is_supported()),
-  format(format),
-  width(width),
-  last_tick(std::clock()),
   total_fusions(total_fusions),
-  fusions(0),
-  v_norm_init(0),
-  v_norm(0),
-  iter(0),
-  gamma(0){}
+  v_norm_init(0) {
+    reset();
+  }
 
-  ~StatusPrinter() {
-    this->terminate();
+  // Problem objects are copied into the solver policies before solving, so copies
+  // only carry over configuration: each copy starts its own monitor when first used
+  StatusPrinter(const StatusPrinter& other) :
+  show_progress(other.show_progress),
+  total_fusions(other.total_fusions),
+  v_norm_init(other.v_norm_init) {
+    reset();
   }
 
-  void set_width(int width){
-    this->width = width;
+  StatusPrinter& operator=(const StatusPrinter&) = delete;
+
+  ~StatusPrinter() {
+    finish();
   }
 
   void set_v_norm_init(double v_norm_init){
     this->v_norm_init = v_norm_init;
   }
 
-  void update(int fusions_, double v_norm_, unsigned int iter_, double gamma_) {
-    double time_since_last_tick = (std::clock() - last_tick) / ((double) CLOCKS_PER_SEC);
+  // Hot path: a few relaxed atomic operations (plus starting the monitor on the first
+  // call), or a counter if interrupts are polled on this thread
+  void update(unsigned int fusions_, unsigned int iter_, double gamma_) {
+    fusions.store(fusions_, std::memory_order_relaxed);
+    iter.store(iter_, std::memory_order_relaxed);
+    gamma.store(gamma_, std::memory_order_relaxed);
 
-    if(time_since_last_tick < CLUSTRVIZ_STATUS_UPDATE_TIME_SECS){
-      return; // Don't need to print too frequently
+    if(!started){
+      start();
     }
 
-    force_update(fusions_, v_norm_, iter_, gamma_);
-  }
+    if(poll_inline && (++ticks_since_poll >= CLUSTRVIZ_INTERRUPT_CHECK_TICKS)){
+      poll_interrupt();
+    }
 
-  void force_update(int fusions_, double v_norm_, unsigned int iter_, double gamma_){
-    Rcpp::checkUserInterrupt(); // Check essentially every time we do the progress bar
+    if(refresh_due.load(std::memory_order_relaxed)){
+      refresh();
+    }
 
-    if(!show_progress){
-      return; // Not printing, so return after checking for CTRL-C
+    if(cancelled.load(std::memory_order_relaxed)){
+      finish();
+      clustRviz_hooks().error("Computation interrupted by the user.");
     }
+  }
 
-    // Update internal counters
-    fusions = fusions_;
-    v_norm  = v_norm_;
-    iter    = iter_;
-    gamma   = gamma_;
+  bool needs_v_norm() const {
+    return v_norm_due.load(std::memory_order_relaxed);
+  }
+
+  void set_v_norm(double v_norm_){
+    v_norm.store(v_norm_, std::memory_order_relaxed);
+    v_norm_due.store(false, std::memory_order_relaxed);
+  }
 
-    if( (count % CLUSTRVIZ_STATUS_WIDTH_CHECK) == 0){
-      set_width(Rf_GetOptionWidth() - 2);
-      this->update_format();
+  // Stop the monitor and clear the status line -- called once the path is complete
+  void finish(){
+    if(monitor.joinable()){
+      {
+        std::lock_guard<std::mutex> lock(monitor_mutex);
+        stopping = true;
+      }
+      monitor_cv.notify_all();
+      monitor.join();
     }
 
-    count++;
+    if(!last_draw.empty()){
+      clear_line(width);
+      cursor_to_start();
 
-    if (fusions == total_fusions){
-      this->terminate();
-    } else {
-      this->render();
+      // RStudio appears to not implement \r quite right,
+      // so let's add a new line to be safe
+      if(is_r_studio()){
+        clustRviz_hooks().print("\n");
+      }
+
+      last_draw.clear();
     }
   }
 
 private:
-  const bool show_progress;    // Do we print output?
-  unsigned int count;          // Number of times we have updated the printer
-  const bool output_supported; // Do we support the desired print location?
-  std::string format;          // Bar template -- hard coded above
-  int width;                   // Width of progress bar (used to set template and control print length)
-  std::string last_draw;       // Last progress bar drawn
-  std::clock_t last_tick;      // Time of last PB tick
-
-  // ClustRviz-specific measures of progress
+  const bool show_progress;         // Do we print output?
   const unsigned int total_fusions; // Number of edges that need to be fused before termination
-  unsigned int fusions;             // Number of edges fused so far
   double v_norm_init;               // Initial squared Frobenius norm of V
-  double v_norm;                    // Current squared Frobenius norm of V
-  unsigned int iter;                // What iteration we are on
-  double gamma;                     // Current regularization level
-
-  void update_format(){
-    if(this->width >= 120){
-      this->format = ":spin Iteration :iter. Current Gamma :gamma. Fused :edges / :total edges. Percent fusion achieved :pct%";
-    } else if(this->width >= 80){
-      this->format = ":spin Iteration :iter. Current Gamma :gamma. Fused :edges / :total edges";
-    } else if(this->width >= 40){
-      this->format = ":spin Current Iteration :iter. Current Gamma :gamma";
-    } else if(this->width >= 20){
-      this->format = ":spin Current Iteration :iter";
-    } else if (this->width >= 5){
-      this->format = ":spin";
-    } else {
-      this->format = "";
-    }
+
+  // Published by the solver thread
+  std::atomic<unsigned int> fusions; // Number of edges fused so far
+  std::atomic<unsigned int> iter;    // What iteration we are on
+  std::atomic<double> gamma;         // Current regularization level
+  std::atomic<double> v_norm;        // Current squared Frobenius norm of V (see needs_v_norm())
+
+  // Published by the monitor thread
+  std::atomic<bool> refresh_due;     // Host is not thread-safe: render and poll on the solver thread
+  std::atomic<bool> v_norm_due;      // A render is coming: publish the norm of V
+  std::atomic<bool> cancelled;       // The user asked us to stop
+
+  // Interrupt polling on the solver thread (if progress is not shown)
+  bool poll_inline;
+  unsigned int ticks_since_poll;
+  std::chrono::steady_clock::time_point last_poll;
+
+  // Monitor thread
+  bool started;
+  bool stopping;
+  std::thread monitor;
+  std::mutex monitor_mutex;
+  std::condition_variable monitor_cv;
+
+  // Rendering state -- only touched by whichever thread renders (see above)
+  unsigned int count;          // Number of times we have rendered
+  bool output_supported;       // Do we support the desired print location?
+  int width;                   // Width of the status line (used to pick its format and control print length)
+  std::string last_draw;       // Last status line drawn
+
+  void reset(){
+    fusions.store(0);
+    iter.store(0);
+    gamma.store(0);
+    v_norm.store(v_norm_init);
+    refresh_due.store(false);
+    v_norm_due.store(false);
+    cancelled.store(false);
+    poll_inline      = false;
+    ticks_since_poll = 0;
+    started  = false;
+    stopping = false;
+    count    = 0;
+    output_supported = false;
+    width    = 0;
   }
 
-  void render() {
-    // Update the progress output
-    if (!output_supported){
-      // If we are printing to some weird output location that we don't support, skip
-      return;
+  void start(){
+    started = true;
+
+    if(in_parallel_region()){
+      return; // Neither printing nor interrupt checks are safe off the main thread
     }
 
-    std::string str = format;
-    std::stringstream buffer;
+    if(!show_progress){
+      // Nothing to print: poll for interrupts (if any) from this thread instead
+      poll_inline = (clustRviz_hooks().check_interrupt != NULL);
+      last_poll   = std::chrono::steady_clock::now();
+      return;
+    }
 
-    // Iteration
-    buffer << iter;
-    replace_all(str, ":iter", buffer.str());
-    buffer.str(""); buffer.clear();
+    output_supported = is_supported();
+    width            = clustRviz_hooks().console_width() - 2;
 
-    // Current edges
-    buffer << fusions;
-    replace_all(str, ":edges", buffer.str());
-    buffer.str(""); buffer.clear();
+    monitor = std::thread(&StatusPrinter::monitor_loop, this, clustRviz_hooks().thread_safe);
+  }
 
-    // Max edges
-    buffer << total_fusions;
-    replace_all(str, ":total", buffer.str());
-    buffer.str(""); buffer.clear();
+  void monitor_loop(bool host_thread_safe){
+    const std::chrono::duration<double> interval(CLUSTRVIZ_STATUS_UPDATE_TIME_SECS);
 
-    // Percent fusion achieved
-    double pct_fusion = std::fmax(0, 1.0 - v_norm / v_norm_init) * 100;
-    buffer << std::setw(5) << pct_fusion;
-    replace_all(str, ":pct", buffer.str());
-    buffer.str(""); buffer.clear();
+    std::unique_lock<std::mutex> lock(monitor_mutex);
+    while(!monitor_cv.wait_for(lock, interval, [this]{ return stopping; })){
+      if(host_thread_safe){
+        poll();
+      } else {
+        refresh_due.store(true, std::memory_order_relaxed);
+      }
 
-    // Current gamma
-    buffer << gamma;
-    replace_all(str, ":gamma", buffer.str());
-    buffer.str(""); buffer.clear();
+      if(output_supported){
+        v_norm_due.store(true, std::memory_order_relaxed);
+      }
+    }
+  }
 
-    // spin
-    replace_all(str, ":spin", spin_symbol());
+  // Called on the solver thread every CLUSTRVIZ_INTERRUPT_CHECK_TICKS ticks if progress
+  // is not shown -- may throw, as refresh() does
+  void poll_interrupt(){
+    ticks_since_poll = 0;
 
-    if (last_draw != str) {
-      if (last_draw.length() > str.length()) { clear_line(width); }
-      cursor_to_start();
-      Rprintf(str.c_str());
-      last_draw = str;
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if(now - last_poll >= std::chrono::duration<double>(CLUSTRVIZ_STATUS_UPDATE_TIME_SECS)){
+      last_poll = now;
+      clustRviz_hooks().check_interrupt();
     }
   }
 
-  void terminate() {
-    if (!output_supported){
-      // Never printed -- ok to return w/o doing anything
-      return;
+  // Called on the solver thread when the host is not thread-safe
+  void refresh(){
+    refresh_due.store(false, std::memory_order_relaxed);
+    poll(); // May throw (e.g., R's interrupt check): the monitor is stopped by the destructor
+  }
+
+  // Render the status line and check for interrupts
+  void poll(){
+    ClustRVizHooks& hooks = clustRviz_hooks();
+
+    if(hooks.check_interrupt){
+      if(hooks.thread_safe){
+        try {
+          hooks.check_interrupt();
+        } catch(...) {
+          cancelled.store(true, std::memory_order_relaxed);
+          return;
+        }
+      } else {
+        hooks.check_interrupt();
+      }
     }
 
-    // Clean up and exit
-    clear_line(width);
-    cursor_to_start();
+    if(output_supported){
+      if((count % CLUSTRVIZ_STATUS_WIDTH_CHECK) == 0){
+        width = hooks.console_width() - 2;
+      }
+      count++;
+      render();
+    }
+  }
 
-    // RStudio appears to not implement \r quite right,
-    // so let's add a new line to be safe
-    if(is_r_studio()){
-      Rprintf("\n");
+  void render() {
+    const unsigned int fusions_ = fusions.load(std::memory_order_relaxed);
+    const unsigned int iter_    = iter.load(std::memory_order_relaxed);
+    const double gamma_         = gamma.load(std::memory_order_relaxed);
+    const double pct_fusion     = std::fmax(0, 1.0 - v_norm.load(std::memory_order_relaxed) / v_norm_init) * 100;
+    const char spin             = spin_symbol();
+
+    char buffer[256];
+    if(width >= 120){
+      std::snprintf(buffer, sizeof(buffer), "%c Iteration %u. Current Gamma %g. Fused %u / %u edges. Percent fusion achieved %5g%%",
+                    spin, iter_, gamma_, fusions_, total_fusions, pct_fusion);
+    } else if(width >= 80){
+      std::snprintf(buffer, sizeof(buffer), "%c Iteration %u. Current Gamma %g. Fused %u / %u edges",
+                    spin, iter_, gamma_, fusions_, total_fusions);
+    } else if(width >= 40){
+      std::snprintf(buffer, sizeof(buffer), "%c Current Iteration %u. Current Gamma %g", spin, iter_, gamma_);
+    } else if(width >= 20){
+      std::snprintf(buffer, sizeof(buffer), "%c Current Iteration %u", spin, iter_);
+    } else if(width >= 5){
+      std::snprintf(buffer, sizeof(buffer), "%c", spin);
+    } else {
+      buffer[0] = '\0';
+    }
+
+    std::string str(buffer);
+    if (last_draw != str) {
+      if (last_draw.length() > str.length()) { clear_line(width); }
+      cursor_to_start();
+      clustRviz_hooks().print(str);
+      last_draw = str;
     }
   }
 
-  std::string spin_symbol() {
+  char spin_symbol() const {
     const char symbols[4] = {'-', '\\', '|', '/'};
-    return std::string(1, symbols[(count - 1) % 4]);
+    return symbols[(count - 1) % 4];
   }
 
   void clear_line(int width) {
-
-    char *spaces = (char*) calloc(width + 2, sizeof(char));
-    if (!spaces) Rf_error("Progress bar: out of memory");
-    for (int i = 1; i <= width; i++) spaces[i] = ' ';
-    spaces[0] = '\r';
-    spaces[width + 1] = '\0';
-
-    Rprintf(spaces);
-    free(spaces);
+    clustRviz_hooks().print("\r" + std::string(std::max(width, 0), ' '));
   }
 
   void cursor_to_start() {
-    Rprintf("\r");
+    clustRviz_hooks().print("\r");
   }
 
   bool is_r_app() const {
@@ -230,19 +326,6 @@ private:
   bool is_supported() {
     return (isatty(1) || is_r_studio() || is_r_app());
   }
-
-  static void replace_all(std::string& str, const std::string& from,
-                          const std::string& to) {
-    if (from.empty()) return;
-
-    size_t start_pos = 0;
-
-    while ((start_pos = str.find(from, start_pos)) != std::string::npos) {
-      str.replace(start_pos, from.length(), to);
-      start_pos += to.length();
-    }
-  }
-
 };
 
 #endif
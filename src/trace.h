@@ -0,0 +1,110 @@
+#ifndef CLUSTRVIZ_TRACE_H
+#define CLUSTRVIZ_TRACE_H 1
+
+#include "clustRviz_base.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// Iteration trace
+//
+// The solver policies record a compact binary event for each ADMM step and each
+// decision they make (convergence, back-tracking, ...) in a SolverTrace, which is
+// carried along with the solution path like the profile (see profile.h) and returned
+// to R as its `trace` element, a data frame with one row per event (see r_adapter.h).
+//
+// Events are kept in a fixed-size ring buffer, so only the most recent ones are kept
+// on very long runs (the number dropped is recorded too). The size is given by the
+// entry points (from clustRviz_options(trace_length = ...) in R) and tracing is off
+// (size 0) by default: then CLUSTRVIZ_TRACE costs a single branch and the `trace`
+// element is NULL.
+enum TraceEventType {
+  TRACE_STEP = 0,         // One ADMM step
+  TRACE_CONVERGED,        // ADMM converged at this gamma
+  TRACE_NOT_CONVERGED,    // ADMM stopped at max_inner_iter without converging
+  TRACE_NO_FUSIONS,       // Back-tracking: no new fusions, so continue
+  TRACE_BACKTRACK,        // Back-tracking: too many fusions, so reduce gamma
+  TRACE_FORWARD,          // Back-tracking: fusion not isolated, so increase gamma
+  TRACE_ACCEPT,           // Back-tracking: exactly one new fusion, so continue
+  TRACE_NUM_EVENT_TYPES
+};
+
+inline const char* trace_event_name(int type){
+  static const char* names[TRACE_NUM_EVENT_TYPES] = {
+    "step", "converged", "not_converged", "no_fusions", "backtrack", "forward", "accept"
+  };
+  return names[type];
+}
+
+// u_change of events without a convergence check
+static const double TRACE_NO_CHANGE = std::numeric_limits<double>::quiet_NaN();
+
+struct TraceEvent {
+  double gamma;            // Regularization level
+  double u_change;         // Scaled squared change in U at the last convergence check (NaN for CARP)
+  int32_t iteration;       // Outer (CARP) or total (ADMM) iteration count
+  int32_t inner_iteration; // Step (or back-tracking try) within this gamma
+  int32_t fusions;         // Number of fused edges
+  int32_t type;            // TraceEventType
+};
+
+class SolverTrace {
+public:
+  // capacity is the size of the ring buffer -- 0 turns tracing off
+  explicit SolverTrace(int capacity_ = 0): capacity(std::max(capacity_, 0)), num_recorded(0) {}
+
+  bool enabled() const {
+    return capacity > 0;
+  }
+
+  void record(TraceEventType type, int iteration, int inner_iteration, int fusions, double gamma, double u_change){
+    if(events.empty()){
+      events.resize(capacity); // Allocated on first use, since problems are copied before solving
+    }
+
+    TraceEvent& event = events[num_recorded % capacity];
+    event.gamma           = gamma;
+    event.u_change        = u_change;
+    event.iteration       = iteration;
+    event.inner_iteration = inner_iteration;
+    event.fusions         = fusions;
+    event.type            = type;
+    num_recorded++;
+  }
+
+  // Events still in the buffer, oldest first
+  std::vector<TraceEvent> events_in_order() const {
+    if(num_recorded <= static_cast<uint64_t>(capacity)){
+      return std::vector<TraceEvent>(events.begin(), events.begin() + num_recorded);
+    }
+
+    const std::size_t oldest = num_recorded % capacity;
+    std::vector<TraceEvent> result(events.begin() + oldest, events.end());
+    result.insert(result.end(), events.begin(), events.begin() + oldest);
+    return result;
+  }
+
+  uint64_t num_dropped() const {
+    return (num_recorded > static_cast<uint64_t>(capacity)) ? num_recorded - capacity : 0;
+  }
+
+private:
+  int capacity;
+  uint64_t num_recorded;
+  std::vector<TraceEvent> events;
+};
+
+// Record an event for problem (which must have `trace`, `gamma` and `num_fusions()`)
+//
+// Arguments are only evaluated if tracing is on
+#define CLUSTRVIZ_TRACE(problem, type, iteration, inner_iteration, u_change)                             \
+  do {                                                                                                   \
+    if((problem).trace.enabled()){                                                                       \
+      (problem).trace.record(type, iteration, inner_iteration, (problem).num_fusions(), (problem).gamma, \
+                             u_change);                                                                  \
+    }                                                                                                    \
+  } while(0)
+
+#endif
@@ -0,0 +1,505 @@
+#ifndef CLUSTRVIZ_TREE_PATH_H
+#define CLUSTRVIZ_TREE_PATH_H 1
+
+#include "clustRviz_base.h"
+#include "clustRviz_logging.h"
+#include "clustering_impl.h"
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <utility>
+
+// Exact solution path of L1 convex clustering on a tree
+//
+// With the L1 norm, the problem separates over columns into weighted fused lassos on
+// the weight graph,
+//
+//   min_u 1/2 ||x - u||^2 + gamma * sum_l w_l |u_a(l) - u_b(l)|,
+//
+// and if the graph is a tree, each solution is piecewise linear in gamma: for fixed
+// groups (connected components of the fused edges) and signs of the unfused edges,
+// stationarity summed over a group G gives
+//
+//   u_G(gamma) = (X_G - gamma * B_G) / |G|,
+//
+// with X_G the sum of x over G and B_G = sum of w_l * sign_l * (+1 if G holds a(l),
+// -1 if b(l)) over the unfused edges leaving G. The subgradient of a fused edge l in G
+// is linear over gamma too: removing l splits G into G_a (holding a(l)) and G_b, and
+//
+//   gamma * w_l * tau_l = (X_Ga - |G_a| X_G / |G|) + gamma * (|G_a| B_G / |G| - B_Ga)
+//
+// (B_Ga only counting the unfused edges leaving G from G_a). The path is traced from
+// gamma = 0 by jumping from event to event: an unfused edge fuses when its end points
+// meet, and a fused edge splits when |tau_l| reaches 1 (which can happen with
+// non-uniform weights; it takes the sign of the bound it hit). Only the groups changed
+// by an event have their candidate events recomputed, from a priority queue of
+// candidates stamped per edge so that stale ones are skipped.
+//
+// Columns are traced independently (in parallel with OpenMP), and the path reports
+// the points at which an edge of the tree becomes (or stops being) fused in every
+// column -- the fusions of the clustering problem -- with U and V = DU computed
+// exactly there. No iterations (or tuning parameters) are involved, so this doubles
+// as a reference for benchmarking the approximate CARP paths.
+//
+// Only used without missing data (the loss is then separable), see CARPcpp.
+
+// Fusion (or split) of an edge in one column at gamma
+struct TreePathEvent {
+  double gamma;
+  Eigen::Index edge;
+  bool fused;
+};
+
+// Event-driven homotopy for the weighted fused lasso of one column on a tree
+class TreeFusedLassoPath {
+public:
+  TreeFusedLassoPath(const std::vector<std::pair<Eigen::Index, Eigen::Index> >& edges_,
+                     const Eigen::VectorXd& weights_,
+                     Eigen::Index n_):
+  edges(edges_),
+  weights(weights_),
+  n(n_),
+  num_edges(edges_.size()),
+  neighbors(n_) {
+    for(Eigen::Index l = 0; l < num_edges; l++){
+      neighbors[edges[l].first].push_back(std::make_pair(edges[l].second, l));
+      neighbors[edges[l].second].push_back(std::make_pair(edges[l].first, l));
+    }
+  }
+
+  // Trace the path for column x, calling visit(gamma) before each event at gamma
+  // (with the solution so far still valid up to gamma -- see evaluate()) and
+  // record(event) after it. Returns false if the path did not terminate (which
+  // only happens through round-off)
+  template <class VISIT, class RECORD>
+  bool run(const Eigen::VectorXd& x_, VISIT visit, RECORD record){
+    x = x_;
+    gamma = 0;
+    fused.assign(num_edges, false);
+    sign.assign(num_edges, 0);
+    stamp.assign(num_edges, 0);
+    group_of.assign(n, -1);
+    group_size.clear();
+    group_sum.clear();
+    group_boundary.clear();
+    candidates = EventQueue();
+
+    // Ties in x are fused from the start
+    for(Eigen::Index l = 0; l < num_edges; l++){
+      const double diff = x(edges[l].first) - x(edges[l].second);
+      sign[l]  = (diff > 0) - (diff < 0);
+      fused[l] = (diff == 0);
+    }
+
+    std::vector<Eigen::Index> roots;
+    for(Eigen::Index i = 0; i < n; i++){
+      if(group_of[i] == -1){
+        build_group(i);
+        roots.push_back(i);
+      }
+    }
+    for(std::size_t k = 0; k < roots.size(); k++){
+      update_candidates(roots[k]);
+    }
+    for(Eigen::Index l = 0; l < num_edges; l++){
+      if(fused[l]){
+        TreePathEvent event = {0.0, l, true};
+        record(event);
+      }
+    }
+
+    // Every event is a fusion or a split, and splits only follow fusions, so this is
+    // generous: a non-degenerate path has at most a few events per edge
+    const long long max_events = 16 * static_cast<long long>(num_edges) + 64;
+    long long num_events = 0;
+
+    while(!candidates.empty()){
+      const Candidate next = candidates.top();
+      candidates.pop();
+      if(next.stamp != stamp[next.edge]){
+        continue; // Stale: an end point's group has changed since it was computed
+      }
+
+      visit(next.gamma);
+      gamma = std::max(gamma, next.gamma);
+
+      const Eigen::Index l = next.edge;
+      if(fused[l]){
+        fused[l] = false;
+        sign[l]  = next.sign;
+        build_group(edges[l].first);
+        build_group(edges[l].second);
+        update_candidates(edges[l].first);
+        update_candidates(edges[l].second);
+      } else {
+        fused[l] = true;
+        build_group(edges[l].first);
+        update_candidates(edges[l].first);
+      }
+
+      TreePathEvent event = {gamma, l, fused[l]};
+      record(event);
+
+      if(++num_events > max_events){
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  // Solution at gamma >= the last event visited (within the current pieces)
+  void evaluate(double gamma_, double* u) const {
+    for(Eigen::Index i = 0; i < n; i++){
+      const Eigen::Index g = group_of[i];
+      u[i] = (group_sum[g] - gamma_ * group_boundary[g]) / group_size[g];
+    }
+  }
+
+private:
+  const std::vector<std::pair<Eigen::Index, Eigen::Index> >& edges; // (a, b): row l of D is e_a - e_b
+  const Eigen::VectorXd& weights;
+  const Eigen::Index n;
+  const Eigen::Index num_edges;
+  std::vector<std::vector<std::pair<Eigen::Index, Eigen::Index> > > neighbors; // (vertex, edge)
+
+  struct Candidate {
+    double gamma;
+    Eigen::Index edge;
+    unsigned int stamp;
+    int sign; // Sign of the edge after a split
+
+    bool operator>(const Candidate& other) const {
+      return gamma > other.gamma;
+    }
+  };
+  typedef std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate> > EventQueue;
+
+  // Current state
+  Eigen::VectorXd x;
+  double gamma;
+  std::vector<bool> fused;
+  std::vector<int> sign;             // Sign of u_a - u_b for unfused edges
+  std::vector<unsigned int> stamp;   // Current candidate event of each edge
+  std::vector<Eigen::Index> group_of;
+  std::vector<double> group_size;    // Indexed by group: every change makes a new group
+  std::vector<double> group_sum;
+  std::vector<double> group_boundary;
+  EventQueue candidates;
+
+  // Work space: the last group built, in breadth-first order from its root
+  std::vector<Eigen::Index> order;
+  std::vector<Eigen::Index> parent_edge;
+  std::vector<double> subtree_size;
+  std::vector<double> subtree_sum;
+  std::vector<double> subtree_boundary;
+
+  // Contribution of vertex i to B of its group
+  double vertex_boundary(Eigen::Index i) const {
+    double boundary = 0;
+    for(std::size_t k = 0; k < neighbors[i].size(); k++){
+      const Eigen::Index l = neighbors[i][k].second;
+      if(!fused[l]){
+        boundary += weights(l) * sign[l] * ((edges[l].first == i) ? 1 : -1);
+      }
+    }
+    return boundary;
+  }
+
+  // Label the group of vertex root (through fused edges) as a new group
+  void build_group(Eigen::Index root){
+    const Eigen::Index g = group_size.size();
+    build_group_order(root);
+
+    double sum = 0, boundary = 0;
+    for(std::size_t k = 0; k < order.size(); k++){
+      const Eigen::Index i = order[k];
+      group_of[i] = g;
+      sum        += x(i);
+      boundary   += vertex_boundary(i);
+    }
+    group_size.push_back(order.size());
+    group_sum.push_back(sum);
+    group_boundary.push_back(boundary);
+  }
+
+  void schedule(Eigen::Index l, double event_gamma, int new_sign){
+    stamp[l]++;
+    if(event_gamma < std::numeric_limits<double>::infinity()){
+      Candidate candidate = {std::max(event_gamma, gamma), l, stamp[l], new_sign};
+      candidates.push(candidate);
+    }
+  }
+
+  // Recompute the candidate events of the edges in and around the group of root
+  void update_candidates(Eigen::Index root){
+    const Eigen::Index g = group_of[root];
+    if(order.empty() || order[0] != root){
+      build_group_order(root);
+    }
+
+    const double size = group_size[g], mean = group_sum[g] / size, slope = group_boundary[g] / size;
+    const double inf  = std::numeric_limits<double>::infinity();
+
+    // Fusions of the unfused edges leaving the group: u_a - u_b = p - gamma * q
+    for(std::size_t k = 0; k < order.size(); k++){
+      const Eigen::Index i = order[k];
+      for(std::size_t m = 0; m < neighbors[i].size(); m++){
+        const Eigen::Index l = neighbors[i][m].second;
+        if(fused[l]){
+          continue;
+        }
+        const Eigen::Index a = edges[l].first, b = edges[l].second;
+        const Eigen::Index ga = group_of[a], gb = group_of[b];
+        const double p = group_sum[ga] / group_size[ga] - group_sum[gb] / group_size[gb];
+        const double q = group_boundary[ga] / group_size[ga] - group_boundary[gb] / group_size[gb];
+        // Moving towards each other iff the difference shrinks in the direction of its sign
+        schedule(l, (sign[l] * q > 0) ? p / q : inf, 0);
+      }
+    }
+
+    // Splits of the fused edges inside the group, from subtree sums (leaves first)
+    for(std::size_t k = order.size(); k-- > 0; ){
+      const Eigen::Index i = order[k];
+      subtree_size[i]     = 1;
+      subtree_sum[i]      = x(i);
+      subtree_boundary[i] = vertex_boundary(i);
+    }
+    for(std::size_t k = order.size(); k-- > 1; ){
+      const Eigen::Index i = order[k];
+      const Eigen::Index l = parent_edge[i];
+      const Eigen::Index parent = (edges[l].first == i) ? edges[l].second : edges[l].first;
+      subtree_size[parent]     += subtree_size[i];
+      subtree_sum[parent]      += subtree_sum[i];
+      subtree_boundary[parent] += subtree_boundary[i];
+    }
+    for(std::size_t k = 1; k < order.size(); k++){
+      const Eigen::Index i = order[k];
+      const Eigen::Index l = parent_edge[i];
+
+      // Sums over the side of l holding a(l)
+      double side_size = subtree_size[i], side_sum = subtree_sum[i], side_boundary = subtree_boundary[i];
+      if(edges[l].first != i){
+        side_size     = size - side_size;
+        side_sum      = group_sum[g] - side_sum;
+        side_boundary = group_boundary[g] - side_boundary;
+      }
+
+      // gamma * w * tau = alpha + beta * gamma must stay within +/- gamma * w
+      const double alpha = side_sum - side_size * mean;
+      const double beta  = side_size * slope - side_boundary;
+      const double w     = weights(l);
+
+      double split_gamma = inf;
+      int new_sign = 0;
+      if(beta > w){
+        split_gamma = -alpha / (beta - w);
+        new_sign    = 1;
+      }
+      if((beta < -w) && (-alpha / (beta + w) < split_gamma)){
+        split_gamma = -alpha / (beta + w);
+        new_sign    = -1;
+      }
+      schedule(l, split_gamma, new_sign);
+    }
+  }
+
+  // Breadth-first order of the group of root (through fused edges)
+  void build_group_order(Eigen::Index root){
+    if(parent_edge.empty()){
+      parent_edge.resize(n);
+      subtree_size.resize(n);
+      subtree_sum.resize(n);
+      subtree_boundary.resize(n);
+    }
+
+    order.clear();
+    order.push_back(root);
+    parent_edge[root] = -1;
+    for(std::size_t k = 0; k < order.size(); k++){
+      const Eigen::Index i = order[k];
+      for(std::size_t m = 0; m < neighbors[i].size(); m++){
+        const Eigen::Index j = neighbors[i][m].first;
+        const Eigen::Index l = neighbors[i][m].second;
+        if(fused[l] && (l != parent_edge[i])){
+          parent_edge[j] = l;
+          order.push_back(j);
+        }
+      }
+    }
+  }
+};
+
+// Exact L1 convex clustering path on a tree -- used by CARPcpp in place of the
+// ADMM policies when it applies (exact = TRUE, L1 norm, a tree and no missing data)
+template <typename Scalar>
+class ExactTreePathPolicy {
+public:
+  typedef ClusteringPath<Scalar> PathType;
+
+  ExactTreePathPolicy(const MatrixXs<Scalar>& X_,
+                      const SpMatrixXs<Scalar>& D_,
+                      const VectorXs<Scalar>& weights_):
+  X(X_.template cast<double>()),
+  weights(weights_.template cast<double>()),
+  n(X_.rows()),
+  p(X_.cols()) {
+    edges.resize(D_.rows());
+    if(!tree_edges(D_, edges)){
+      ClustRVizLogger::error("The exact L1 path requires the weights to imply a tree.");
+    }
+  }
+
+  // Is D the edge matrix of a (spanning) tree?
+  static bool is_tree(const SpMatrixXs<Scalar>& D){
+    std::vector<std::pair<Eigen::Index, Eigen::Index> > edges(D.rows());
+    return tree_edges(D, edges);
+  }
+
+  PathType extract_path(){
+    // Pass 1: fusion events of each column
+    std::vector<std::vector<TreePathEvent> > column_events(p);
+    bool terminated = true;
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1) reduction(&&:terminated)
+#endif
+    for(Eigen::Index j = 0; j < p; j++){
+      TreeFusedLassoPath column_path(edges, weights, n);
+      std::vector<TreePathEvent>& events = column_events[j];
+      terminated = column_path.run(X.col(j),
+                                   [](double){},
+                                   [&events](const TreePathEvent& event){ events.push_back(event); }) && terminated;
+    }
+
+    if(!terminated){
+      ClustRVizLogger::error("The exact L1 path did not terminate (numerical difficulties?).");
+    }
+
+    // An edge is fused in the clustering problem once it is fused in every column,
+    // so keep the points where that changes (and gamma = 0)
+    std::vector<TreePathEvent> events;
+    for(Eigen::Index j = 0; j < p; j++){
+      events.insert(events.end(), column_events[j].begin(), column_events[j].end());
+      std::vector<TreePathEvent>().swap(column_events[j]);
+    }
+    std::stable_sort(events.begin(), events.end(),
+                     [](const TreePathEvent& a, const TreePathEvent& b) -> bool { return a.gamma < b.gamma; });
+
+    const Eigen::Index num_edges = edges.size();
+    std::vector<Eigen::Index> fused_columns(num_edges, 0);
+    Eigen::ArrayXi v_zeros = Eigen::ArrayXi::Zero(num_edges);
+    std::vector<double> gammas;
+    std::vector<Eigen::ArrayXi> fusions;
+
+    std::size_t next = 0;
+    while(true){
+      const double gamma = gammas.empty() ? 0 : events[next].gamma;
+      bool changed = gammas.empty();
+      for(; (next < events.size()) && (events[next].gamma == gamma); next++){
+        const Eigen::Index l = events[next].edge;
+        fused_columns[l] += events[next].fused ? 1 : -1;
+        const int fused = (fused_columns[l] == p);
+        changed = changed || (fused != v_zeros(l));
+        v_zeros(l) = fused;
+      }
+      if(changed){
+        gammas.push_back(gamma);
+        fusions.push_back(v_zeros);
+      }
+      if(next == events.size()){
+        break;
+      }
+    }
+
+    // Pass 2: U at those points, replaying each column (the pieces are evaluated
+    // once every event up to each point has been applied, so fused edges are exact)
+    const Eigen::Index num_points = gammas.size();
+    MatrixXs<Scalar> UPath(n * p, num_points);
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+    for(Eigen::Index j = 0; j < p; j++){
+      TreeFusedLassoPath column_path(edges, weights, n);
+      Eigen::VectorXd u(n);
+      Eigen::Index k = 0;
+      auto evaluate_before = [&](double gamma) -> void {
+        for(; (k < num_points) && (gammas[k] < gamma); k++){
+          column_path.evaluate(gammas[k], u.data());
+          UPath.col(k).segment(j * n, n) = u.template cast<Scalar>();
+        }
+      };
+      column_path.run(X.col(j), evaluate_before, [](const TreePathEvent&){});
+      evaluate_before(std::numeric_limits<double>::infinity());
+    }
+
+    PathType path;
+    path.n = n;
+    path.p = p;
+    path.v_path.resize(p * num_edges, num_points);
+    path.v_zero_inds.resize(num_edges, num_points);
+    path.gamma_path.resize(num_points);
+    for(Eigen::Index k = 0; k < num_points; k++){
+      Eigen::Map<const MatrixXs<Scalar> > U(UPath.col(k).data(), n, p);
+      Eigen::Map<MatrixXs<Scalar> > V(path.v_path.col(k).data(), num_edges, p);
+      for(Eigen::Index l = 0; l < num_edges; l++){
+        V.row(l) = U.row(edges[l].first) - U.row(edges[l].second);
+      }
+      path.v_zero_inds.col(k) = fusions[k];
+      path.gamma_path(k)      = gammas[k];
+    }
+    path.u_path.swap(UPath);
+
+    return path;
+  }
+
+private:
+  const Eigen::MatrixXd X;
+  const Eigen::VectorXd weights;
+  const Eigen::Index n;
+  const Eigen::Index p;
+  std::vector<std::pair<Eigen::Index, Eigen::Index> > edges; // (a, b): row l of D is e_a - e_b
+
+  static bool tree_edges(const SpMatrixXs<Scalar>& D,
+                         std::vector<std::pair<Eigen::Index, Eigen::Index> >& edges){
+    const Eigen::Index n = D.cols();
+    if(D.rows() != n - 1){
+      return false;
+    }
+
+    // n - 1 edges without a cycle span all n vertices
+    const SpMatrixXs<Scalar> Dt = D.transpose();
+    std::vector<Eigen::Index> parent(n);
+    for(Eigen::Index i = 0; i < n; i++){
+      parent[i] = i;
+    }
+    for(Eigen::Index l = 0; l < Dt.outerSize(); l++){
+      Eigen::Index a = -1, b = -1;
+      int num_ends = 0;
+      for(typename SpMatrixXs<Scalar>::InnerIterator it(Dt, l); it; ++it){
+        num_ends++;
+        if(it.value() == 1){
+          a = it.row();
+        } else if(it.value() == -1){
+          b = it.row();
+        }
+      }
+      if((num_ends != 2) || (a == -1) || (b == -1)){
+        return false;
+      }
+      edges[l] = std::make_pair(a, b);
+
+      while(parent[a] != a) a = parent[a] = parent[parent[a]];
+      while(parent[b] != b) b = parent[b] = parent[parent[b]];
+      if(a == b){
+        return false;
+      }
+      parent[a] = b;
+    }
+
+    return true;
+  }
+};
+
+#endif
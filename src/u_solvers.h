@@ -0,0 +1,291 @@
+#ifndef CLUSTRVIZ_U_SOLVERS_H
+#define CLUSTRVIZ_U_SOLVERS_H 1
+
+#include "clustRviz_base.h"
+#include <algorithm>
+#include <utility>
+
+// Linear solvers for the U-update, (I + rho D^T D) U = B
+//
+// (With multiplicity weights m on the rows of X -- see row_collapse.h -- the system
+// is (diag(m) + rho D^T D) U = B instead; an empty m stands for all ones.)
+//
+// D^T D is the (unweighted) Laplacian of the weight graph, so the system only
+// depends on the graph's structure, which is detected once when the solver is built:
+//
+//  - FOREST: if the graph has no cycles (e.g., a chain for ordered data or a minimum
+//    spanning tree), Gaussian elimination from the leaves up causes no fill-in, so
+//    the system is solved exactly in O(np) after an O(n) factorization.
+//  - GRID: if the vertices form an r-by-c lattice (vertex i + r * j at row i and
+//    column j, i.e., column-major, with edges to the vertices below and to the right),
+//    the Laplacian is L_c (x) I_r + I_c (x) L_r, whose eigenvectors are products of
+//    DCT-II basis vectors. The solve is a separable transform, a diagonal scaling and
+//    the inverse transform: O(n (r + c) p) using the (dense) DCT matrices. (Only
+//    without multiplicities, which would break the separable structure.)
+//  - GENERAL: otherwise, a cached dense Cholesky factorization, as before.
+//
+// The specialized solvers also avoid forming the n-by-n system matrix at all, which
+// dominates memory use (and set-up time) on large sparse graphs.
+enum LaplacianStructure {
+  LAPLACIAN_GENERAL = 0,
+  LAPLACIAN_FOREST,
+  LAPLACIAN_GRID
+};
+
+template <typename Scalar>
+class LaplacianSolver {
+public:
+  LaplacianSolver(): n(0), kind(LAPLACIAN_GENERAL) {}
+
+  LaplacianSolver(const SpMatrixXs<Scalar>& D, double rho, const Eigen::VectorXd& mass = Eigen::VectorXd()){
+    compute(D, rho, mass);
+  }
+
+  void compute(const SpMatrixXs<Scalar>& D, double rho, const Eigen::VectorXd& mass = Eigen::VectorXd()){
+    n = D.cols();
+
+    std::vector<std::pair<Eigen::Index, Eigen::Index> > edges;
+    if(edge_end_points(D, edges)){
+      if(build_forest(edges, rho, mass)){
+        kind = LAPLACIAN_FOREST;
+        return;
+      }
+      if((mass.size() == 0) && build_grid(edges, rho)){
+        kind = LAPLACIAN_GRID;
+        return;
+      }
+    }
+
+    kind = LAPLACIAN_GENERAL;
+    MatrixXs<Scalar> IDTD = rho * MatrixXs<Scalar>(D.transpose() * D);
+    if(mass.size() == 0){
+      IDTD.diagonal().array() += 1;
+    } else {
+      IDTD.diagonal() += mass.template cast<Scalar>();
+    }
+    llt.compute(IDTD);
+  }
+
+  LaplacianStructure structure() const {
+    return kind;
+  }
+
+  MatrixXs<Scalar> solve(const MatrixXs<Scalar>& B) const {
+    switch(kind){
+      case LAPLACIAN_FOREST: return solve_forest(B);
+      case LAPLACIAN_GRID:   return solve_grid(B);
+      default:               return llt.solve(B);
+    }
+  }
+
+private:
+  Eigen::Index n;
+  LaplacianStructure kind;
+
+  // GENERAL
+  Eigen::LLT<MatrixXs<Scalar> > llt;
+
+  // FOREST: vertices in elimination order (children before parents), with the parent
+  // of each vertex (-1 for roots) and the reciprocal of its pivot
+  std::vector<Eigen::Index> elimination_order;
+  std::vector<Eigen::Index> tree_parent;
+  VectorXs<Scalar> inv_pivot;
+  Scalar off_diagonal; // rho (the system has -rho for each edge)
+
+  // GRID: r-by-c lattice, DCT-II bases (orthonormal columns) and the reciprocal
+  // eigenvalues of the system, as an r-by-c array
+  Eigen::Index grid_rows;
+  Eigen::Index grid_cols;
+  MatrixXs<Scalar> Q_rows;
+  MatrixXs<Scalar> Q_cols;
+  ArrayXXs<Scalar> inv_eigenvalues;
+
+  // End points of each edge, if every row of D is e_i - e_j (or e_j - e_i)
+  static bool edge_end_points(const SpMatrixXs<Scalar>& D,
+                              std::vector<std::pair<Eigen::Index, Eigen::Index> >& edges){
+    const SpMatrixXs<Scalar> Dt = D.transpose();
+    edges.resize(D.rows());
+
+    for(Eigen::Index l = 0; l < Dt.outerSize(); l++){
+      Eigen::Index ends[2];
+      Scalar values[2];
+      int num_ends = 0;
+      for(typename SpMatrixXs<Scalar>::InnerIterator it(Dt, l); it; ++it){
+        if(num_ends == 2){
+          return false;
+        }
+        ends[num_ends]   = it.row();
+        values[num_ends] = it.value();
+        num_ends++;
+      }
+      if((num_ends != 2) || (values[0] + values[1] != 0) || (std::abs(values[0]) != 1)){
+        return false;
+      }
+      edges[l] = std::make_pair(std::min(ends[0], ends[1]), std::max(ends[0], ends[1]));
+    }
+
+    return true;
+  }
+
+  bool build_forest(const std::vector<std::pair<Eigen::Index, Eigen::Index> >& edges, double rho, const Eigen::VectorXd& mass){
+    // A graph on n vertices is a forest iff union-find never sees a cycle
+    std::vector<Eigen::Index> parent(n);
+    for(Eigen::Index i = 0; i < n; i++){
+      parent[i] = i;
+    }
+    std::vector<std::vector<Eigen::Index> > neighbors(n);
+    for(std::size_t l = 0; l < edges.size(); l++){
+      Eigen::Index a = edges[l].first, b = edges[l].second;
+      while(parent[a] != a) a = parent[a] = parent[parent[a]];
+      while(parent[b] != b) b = parent[b] = parent[parent[b]];
+      if(a == b){
+        return false;
+      }
+      parent[a] = b;
+      neighbors[edges[l].first].push_back(edges[l].second);
+      neighbors[edges[l].second].push_back(edges[l].first);
+    }
+
+    // Depth-first order from each root: reversed, every vertex comes before its parent
+    std::vector<Eigen::Index> order;
+    order.reserve(n);
+    tree_parent.assign(n, -1);
+    std::vector<bool> visited(n, false);
+    for(Eigen::Index root = 0; root < n; root++){
+      if(visited[root]){
+        continue;
+      }
+      std::vector<Eigen::Index> stack(1, root);
+      visited[root] = true;
+      while(!stack.empty()){
+        const Eigen::Index i = stack.back();
+        stack.pop_back();
+        order.push_back(i);
+        for(std::size_t k = 0; k < neighbors[i].size(); k++){
+          const Eigen::Index j = neighbors[i][k];
+          if(!visited[j]){
+            visited[j] = true;
+            tree_parent[j] = i;
+            stack.push_back(j);
+          }
+        }
+      }
+    }
+    elimination_order.assign(order.rbegin(), order.rend());
+
+    // Pivots: eliminating a child c from its parent's row subtracts rho^2 / pivot(c)
+    // from the parent's diagonal (m_i + rho * degree)
+    Eigen::VectorXd pivot(n);
+    for(Eigen::Index i = 0; i < n; i++){
+      pivot(i) = ((mass.size() == 0) ? 1.0 : mass(i)) + rho * neighbors[i].size();
+    }
+    for(std::size_t k = 0; k < elimination_order.size(); k++){
+      const Eigen::Index i = elimination_order[k];
+      if(tree_parent[i] != -1){
+        pivot(tree_parent[i]) -= rho * rho / pivot(i);
+      }
+    }
+
+    inv_pivot    = pivot.cwiseInverse().template cast<Scalar>();
+    off_diagonal = rho;
+    return true;
+  }
+
+  MatrixXs<Scalar> solve_forest(const MatrixXs<Scalar>& B) const {
+    MatrixXs<Scalar> U = B;
+
+    // Forward elimination, leaves first
+    for(std::size_t k = 0; k < elimination_order.size(); k++){
+      const Eigen::Index i = elimination_order[k];
+      if(tree_parent[i] != -1){
+        U.row(tree_parent[i]) += (off_diagonal * inv_pivot(i)) * U.row(i);
+      }
+    }
+
+    // Back substitution, roots first
+    for(std::size_t k = elimination_order.size(); k-- > 0; ){
+      const Eigen::Index i = elimination_order[k];
+      if(tree_parent[i] == -1){
+        U.row(i) *= inv_pivot(i);
+      } else {
+        U.row(i) = inv_pivot(i) * (U.row(i) + off_diagonal * U.row(tree_parent[i]));
+      }
+    }
+
+    return U;
+  }
+
+  bool build_grid(const std::vector<std::pair<Eigen::Index, Eigen::Index> >& edges, double rho){
+    // The number of rows is the largest gap between the end points of an edge
+    Eigen::Index r = 1;
+    for(std::size_t l = 0; l < edges.size(); l++){
+      r = std::max(r, edges[l].second - edges[l].first);
+    }
+    if((r < 2) || (n % r != 0) || (n / r < 2)){
+      return false;
+    }
+    const Eigen::Index c = n / r;
+
+    if(static_cast<Eigen::Index>(edges.size()) != (r - 1) * c + r * (c - 1)){
+      return false;
+    }
+
+    // Each vertex has at most one edge down (+1, within its column) and one right (+r)
+    std::vector<bool> down(n, false), right(n, false);
+    for(std::size_t l = 0; l < edges.size(); l++){
+      const Eigen::Index a = edges[l].first;
+      const Eigen::Index gap = edges[l].second - a;
+      if((gap == 1) && (a % r != r - 1) && !down[a]){
+        down[a] = true;
+      } else if((gap == r) && !right[a]){
+        right[a] = true;
+      } else {
+        return false;
+      }
+    }
+
+    grid_rows = r;
+    grid_cols = c;
+    Eigen::VectorXd lambda_rows, lambda_cols;
+    Q_rows = dct_basis(r, lambda_rows);
+    Q_cols = dct_basis(c, lambda_cols);
+
+    inv_eigenvalues.resize(r, c);
+    for(Eigen::Index j = 0; j < c; j++){
+      for(Eigen::Index i = 0; i < r; i++){
+        inv_eigenvalues(i, j) = static_cast<Scalar>(1 / (1 + rho * (lambda_rows(i) + lambda_cols(j))));
+      }
+    }
+    return true;
+  }
+
+  // Orthonormal eigenvectors (DCT-II basis) and eigenvalues of the Laplacian of a path on m vertices
+  static MatrixXs<Scalar> dct_basis(Eigen::Index m, Eigen::VectorXd& eigenvalues){
+    const double pi = 3.14159265358979323846;
+    MatrixXs<Scalar> Q(m, m);
+    eigenvalues.resize(m);
+    for(Eigen::Index k = 0; k < m; k++){
+      const double scale = std::sqrt(((k == 0) ? 1.0 : 2.0) / m);
+      for(Eigen::Index i = 0; i < m; i++){
+        Q(i, k) = static_cast<Scalar>(scale * std::cos(pi * k * (i + 0.5) / m));
+      }
+      eigenvalues(k) = 2 - 2 * std::cos(pi * k / m);
+    }
+    return Q;
+  }
+
+  MatrixXs<Scalar> solve_grid(const MatrixXs<Scalar>& B) const {
+    MatrixXs<Scalar> U(B.rows(), B.cols());
+    for(Eigen::Index j = 0; j < B.cols(); j++){
+      Eigen::Map<const MatrixXs<Scalar> > B_j(B.col(j).data(), grid_rows, grid_cols);
+      Eigen::Map<MatrixXs<Scalar> > U_j(U.col(j).data(), grid_rows, grid_cols);
+
+      MatrixXs<Scalar> coefficients = Q_rows.transpose() * B_j * Q_cols;
+      coefficients.array() *= inv_eigenvalues;
+      U_j.noalias() = Q_rows * coefficients * Q_cols.transpose();
+    }
+    return U;
+  }
+};
+
+#endif
@@ -14,44 +14,22 @@ int sgn(double x){
   return(ret);
 }
 
-double soft_thresh(double x, double lambda){
-  if(std::abs(x) < lambda){
-    return 0;
-  } else if (x > 0){
-    return x - lambda;
-  } else {
-    return x + lambda;
-  }
-}
-
 // Apply a row-wise prox operator (with weights) to a matrix
+//
+// The solvers call the (norm- and dimension-specialized) kernels in norm_policies.h
+// directly; this is a convenience wrapper for use from R and in tests
 // [[Rcpp::export(rng = false)]]
 Eigen::MatrixXd MatrixRowProx(const Eigen::MatrixXd& X,
-                           double lambda,
-                           const Eigen::VectorXd& weights,
-                           bool l1 = true){
-  Eigen::Index n = X.rows();
-  Eigen::Index p = X.cols();
-
-  Eigen::MatrixXd V(n, p);
+                              double lambda,
+                              const Eigen::VectorXd& weights,
+                              bool l1 = true){
+  Eigen::MatrixXd V(X.rows(), X.cols());
+  Eigen::ArrayXi zeros(X.rows());
 
   if(l1){
-    for(Eigen::Index i = 0; i < n; i++){
-      for(Eigen::Index j = 0; j < p; j++){
-        V(i, j) = soft_thresh(X(i, j), lambda * weights(i));
-      }
-    }
+    L1Norm::row_prox<double, Eigen::Dynamic>(X, lambda, weights, V, zeros);
   } else {
-    for(Eigen::Index i = 0; i < n; i++){
-      Eigen::VectorXd X_i = X.row(i);
-      double scale_factor = 1 - lambda * weights(i) / X_i.norm();
-
-      if(scale_factor > 0){
-        V.row(i) = X_i * scale_factor;
-      } else {
-        V.row(i).setZero();
-      }
-    }
+    L2Norm::row_prox<double, Eigen::Dynamic>(X, lambda, weights, V, zeros);
   }
 
   return V;
@@ -63,36 +41,61 @@ Eigen::MatrixXd MatrixColProx(const Eigen::MatrixXd& X,
                               double lambda,
                               const Eigen::VectorXd& weights,
                               bool l1 = true){
-  Eigen::Index n = X.rows();
-  Eigen::Index p = X.cols();
-
-  Eigen::MatrixXd V(n, p);
+  Eigen::MatrixXd V(X.rows(), X.cols());
+  Eigen::ArrayXi zeros(X.cols());
 
   if(l1){
-    for(Eigen::Index i = 0; i < n; i++){
-      for(Eigen::Index j = 0; j < p; j++){
-        V(i, j) = soft_thresh(X(i, j), lambda * weights(j));
-      }
-    }
+    L1Norm::col_prox<double>(X, lambda, weights, V, zeros);
   } else {
-    for(Eigen::Index j = 0; j < p; j++){
-      Eigen::VectorXd X_j = X.col(j);
-      double scale_factor = 1 - lambda * weights(j) / X_j.norm();
-
-      if(scale_factor > 0){
-        V.col(j) = X_j * scale_factor;
-      } else {
-        V.col(j).setZero();
-      }
-    }
+    L2Norm::col_prox<double>(X, lambda, weights, V, zeros);
   }
 
   return V;
 }
 
-double scaled_squared_norm(const Eigen::MatrixXd& mat) {
-  //Squared norm / number of cells gives average squared difference
-  return mat.squaredNorm() / (mat.rows() * mat.cols());
+// Impute the missing cells of X from each of U_list in turn, as the solvers do
+// (re-using one buffer across steps), for use in tests
+// [[Rcpp::export(rng = false)]]
+Rcpp::List MissingMaskImpute(const Eigen::MatrixXd& X,
+                             const Eigen::ArrayXXd& M,
+                             Rcpp::List U_list){
+  const MissingMask<double> missing(M);
+  Eigen::MatrixXd buffer;
+
+  Rcpp::List result(U_list.size());
+  for(R_xlen_t k = 0; k < U_list.size(); k++){
+    const Eigen::MatrixXd U = Rcpp::as<Eigen::MatrixXd>(U_list[k]);
+    result[k] = Rcpp::wrap(missing.impute(X, U, buffer));
+  }
+
+  return result;
+}
+
+// Solve (diag(mass) + rho D^T D) U = B with the U-update solver (see u_solvers.h),
+// returning the solution and the graph structure detected, for use in tests
+// [[Rcpp::export(rng = false)]]
+Rcpp::List LaplacianSolve(const Eigen::SparseMatrix<double>& D,
+                          double rho,
+                          const Eigen::MatrixXd& B,
+                          const Eigen::VectorXd& mass){
+  if(B.rows() != D.cols()){
+    ClustRVizLogger::error("B must have one row per column of D.");
+  }
+  if((mass.size() != 0) && (mass.size() != D.cols())){
+    ClustRVizLogger::error("mass must be empty or have one element per column of D.");
+  }
+
+  const LaplacianSolver<double> solver(D, rho, mass);
+
+  std::string structure;
+  switch(solver.structure()){
+    case LAPLACIAN_FOREST: structure = "forest"; break;
+    case LAPLACIAN_GRID:   structure = "grid";   break;
+    default:               structure = "general";
+  }
+
+  return Rcpp::List::create(Rcpp::Named("U")         = solver.solve(B),
+                            Rcpp::Named("structure") = structure);
 }
 
 // Some basic cheap checks that a weight
@@ -129,10 +132,74 @@ void check_weight_matrix(const Eigen::MatrixXd& weight_matrix){
   }
 }
 
+// Cluster memberships for each slice of a U path
+//
+// Copies the (1-based) cluster IDs from a list produced by get_cluster_assignments()
+// into an N-by-Q matrix, and computes offsets such that the centroids of slice q are
+// rows offsets[q] to offsets[q + 1] - 1 of a stacked centroid matrix. This is done
+// up front so the smoothing loops below don't touch R objects (and can run in parallel)
+static void collect_memberships(const Rcpp::List& cluster_info_list,
+                                int N,
+                                Eigen::MatrixXi& membership,
+                                Eigen::VectorXi& offsets){
+  const int Q = cluster_info_list.size();
+
+  membership.resize(N, Q);
+  offsets.resize(Q + 1);
+  offsets(0) = 0;
+
+  for(int q = 0; q < Q; q++){
+    Rcpp::List cluster_info = cluster_info_list[q];
+    Rcpp::IntegerVector cluster_ids = cluster_info[0];
+    for(int n = 0; n < N; n++){
+      membership(n, q) = cluster_ids[n];
+    }
+    offsets(q + 1) = offsets(q) + Rcpp::as<int>(cluster_info[2]);
+  }
+}
+
+// Per-cluster means of each slice of U (stored as a column-major N-by-P-by-Q array)
+//
+// A single pass over each slice accumulates every row into its cluster's sum. We loop
+// over columns in the outer loop, so each column of U is read contiguously. Slices
+// write to disjoint rows of the centroid matrix, so they are processed in parallel.
+static Eigen::MatrixXd cluster_centroids(const double* U,
+                                         int N,
+                                         int P,
+                                         const Eigen::MatrixXi& membership,
+                                         const Eigen::VectorXi& offsets){
+  const int Q = membership.cols();
+
+  Eigen::MatrixXd centroids = Eigen::MatrixXd::Zero(offsets(Q), P);
+  Eigen::VectorXd counts    = Eigen::VectorXd::Zero(offsets(Q));
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for(int q = 0; q < Q; q++){
+    Eigen::Map<const Eigen::MatrixXd> U_slice(U + static_cast<std::ptrdiff_t>(N) * P * q, N, P);
+    const int offset = offsets(q) - 1; // Cluster IDs are 1-based (per R conventions)
+
+    for(int p = 0; p < P; p++){
+      for(int n = 0; n < N; n++){
+        centroids(offset + membership(n, q), p) += U_slice(n, p);
+      }
+    }
+    for(int n = 0; n < N; n++){
+      counts(offset + membership(n, q)) += 1;
+    }
+  }
+
+  centroids.array().colwise() /= counts.array();
+  return centroids;
+}
+
 // U-smoothing for convex clustering
 //
 // Given cluster memberships, replace rows of U which belong to the same cluster
-// with their mutual mean....
+// with their mutual mean. Each slice takes a single pass to compute its cluster
+// means (see cluster_centroids) and another to write them back, directly into the
+// result (so this is linear in N for each slice, however many clusters there are)
 //
 // [[Rcpp::export(rng = false)]]
 Rcpp::NumericVector smooth_u_clustering(Rcpp::NumericVector U_old, Rcpp::List cluster_info_list){
@@ -151,45 +218,180 @@ Rcpp::NumericVector smooth_u_clustering(Rcpp::NumericVector U_old, Rcpp::List cl
     ClustRVizLogger::error("Dimensions of U and cluster_info do not match");
   }
 
+  Eigen::MatrixXi membership;
+  Eigen::VectorXi offsets;
+  collect_memberships(cluster_info_list, N, membership, offsets);
+
+  const Eigen::MatrixXd centroids = cluster_centroids(U_old.begin(), N, P, membership, offsets);
+
   Rcpp::NumericVector U(N * P * Q);
   U.attr("dim") = U_dims;
   Rcpp::rownames(U) = Rcpp::rownames(U_old);
   Rcpp::colnames(U) = Rcpp::colnames(U_old);
 
+  double* U_data = U.begin();
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
   for(int q = 0; q < Q; q++){
-    Rcpp::List cluster_info = cluster_info_list[q];
-    int n_clusters = Rcpp::as<int>(cluster_info[2]);
+    Eigen::Map<Eigen::MatrixXd> U_slice(U_data + static_cast<std::ptrdiff_t>(N) * P * q, N, P);
+    const int offset = offsets(q) - 1;
 
-    Rcpp::IntegerVector cluster_ids   = cluster_info[0];
-    Rcpp::IntegerVector cluster_sizes = cluster_info[1];
+    for(int p = 0; p < P; p++){
+      for(int n = 0; n < N; n++){
+        U_slice(n, p) = centroids(offset + membership(n, q), p);
+      }
+    }
+  }
 
-    Eigen::MatrixXd U_old_slice = Eigen::Map<Eigen::MatrixXd>(&U_old[N * P * q], N, P);
-    Eigen::MatrixXd U_new(N, P);
+  return U;
+}
 
-    for(int j = 1; j <= n_clusters; j++){ // Cluster IDs are 1-based (per R conventions)
-      Eigen::VectorXd vec = Eigen::VectorXd::Zero(P);
+// Compact representation of the smoothed U path
+//
+// After smoothing, every row of a slice of U is one of that slice's cluster centroids,
+// so the smoothed path is fully determined by the cluster centroids (n_clusters-by-P
+// for each slice) and the cluster memberships. Early in the path there are nearly N
+// clusters, but most of the path has far fewer, so this is typically much smaller than
+// the full N-by-P-by-Q array.
+//
+// Centroids for all slices are stacked into a single matrix: those of slice q are rows
+// offsets[q] to offsets[q + 1] - 1, in order of their (1-based) cluster IDs.
+// [[Rcpp::export(rng = false)]]
+Rcpp::List smooth_u_centroids(Rcpp::NumericVector U_old, Rcpp::List cluster_info_list){
+  Rcpp::IntegerVector U_dims = U_old.attr("dim");
+  if(U_dims.size() != 3){
+    ClustRVizLogger::error("U must be a three rank tensor.");
+  }
+  int N = U_dims(0);
+  int P = U_dims(1);
+  int Q = U_dims(2);
 
-      // Manually work out new mean
-      for(int n = 0; n < N; n++){
-        if(cluster_ids[n] == j){
-          vec += U_old_slice.row(n);
-        }
+  if(cluster_info_list.size() != Q){
+    ClustRVizLogger::error("Dimensions of U and cluster_info do not match");
+  }
+
+  Eigen::MatrixXi membership;
+  Eigen::VectorXi offsets;
+  collect_memberships(cluster_info_list, N, membership, offsets);
+
+  return Rcpp::List::create(Rcpp::Named("centroids")  = cluster_centroids(U_old.begin(), N, P, membership, offsets),
+                            Rcpp::Named("offsets")    = offsets,
+                            Rcpp::Named("membership") = membership);
+}
+
+// Check that (1-based) slice indices are within 1, ..., num_slices
+static void check_slice_indices(const Eigen::VectorXi& slices, Eigen::Index num_slices){
+  if((slices.array() < 1).any() || (slices.array() > num_slices).any()){
+    ClustRVizLogger::error("Slice index out of range.");
+  }
+}
+
+// Materialize slices (and optionally only some columns) of a smoothed U path from its
+// compact representation (see smooth_u_centroids). Slice and column indices are 1-based.
+// [[Rcpp::export(rng = false)]]
+Rcpp::NumericVector centroid_path_slices(const Eigen::MatrixXd& centroids,
+                                         const Eigen::VectorXi& offsets,
+                                         const Eigen::MatrixXi& membership,
+                                         const Eigen::VectorXi& slices,
+                                         const Eigen::VectorXi& cols){
+  check_slice_indices(slices, membership.cols());
+  if((cols.array() < 1).any() || (cols.array() > centroids.cols()).any()){
+    ClustRVizLogger::error("Column index out of range.");
+  }
+
+  const Eigen::Index N = membership.rows();
+  const Eigen::Index J = cols.size();
+  const Eigen::Index S = slices.size();
+
+  Rcpp::NumericVector result(Rcpp::Dimension(N, J, S));
+
+  for(Eigen::Index s = 0; s < S; s++){
+    const int q = slices(s) - 1;
+    Eigen::Map<Eigen::MatrixXd> U_slice(result.begin() + N * J * s, N, J);
+
+    for(Eigen::Index j = 0; j < J; j++){
+      for(Eigen::Index n = 0; n < N; n++){
+        U_slice(n, j) = centroids(offsets(q) + membership(n, q) - 1, cols(j) - 1);
       }
+    }
+  }
+
+  return result;
+}
 
-      vec /= cluster_sizes[j - 1]; // Subtract 1 to adjust to C++ indexing
+// Project slices of a smoothed U path onto the columns of Y (as tensor_projection does for
+// a full array), working with its compact representation: the centroids are projected and
+// the projections are then copied to their cluster members (in parallel across slices).
+// When the whole path is requested, all centroids are projected with a single matrix
+// product; otherwise only those of the requested slices are. Slice indices are 1-based.
+// [[Rcpp::export(rng = false)]]
+Rcpp::NumericVector centroid_path_projection(const Eigen::MatrixXd& centroids,
+                                             const Eigen::VectorXi& offsets,
+                                             const Eigen::MatrixXi& membership,
+                                             const Eigen::MatrixXd& Y,
+                                             const Eigen::VectorXi& slices){
+  if(Y.rows() != centroids.cols()){
+    ClustRVizLogger::error("The dimensions of U and Y do not match -- ") << centroids.cols() << " != " << Y.rows();
+  }
+  check_slice_indices(slices, membership.cols());
 
-      // Assign new mean where needed...
-      for(int n = 0; n < N; n++){
-        if(cluster_ids[n] == j){
-          U_new.row(n) = vec;
-        }
+  const Eigen::Index N = membership.rows();
+  const Eigen::Index K = Y.cols();
+  const Eigen::Index S = slices.size();
+
+  const bool project_all = (S >= membership.cols());
+  const Eigen::MatrixXd projected_all = project_all ? Eigen::MatrixXd(centroids * Y) : Eigen::MatrixXd();
+
+  Rcpp::NumericVector result(Rcpp::Dimension(N, K, S));
+  double* result_data = result.begin();
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for(Eigen::Index s = 0; s < S; s++){
+    const int q = slices(s) - 1;
+    const int num_clusters = offsets(q + 1) - offsets(q);
+    Eigen::Map<Eigen::MatrixXd> result_slice(result_data + N * K * s, N, K);
+
+    if(project_all){
+      for(Eigen::Index n = 0; n < N; n++){
+        result_slice.row(n) = projected_all.row(offsets(q) + membership(n, q) - 1);
+      }
+    } else {
+      const Eigen::MatrixXd projected = centroids.middleRows(offsets(q), num_clusters) * Y;
+      for(Eigen::Index n = 0; n < N; n++){
+        result_slice.row(n) = projected.row(membership(n, q) - 1);
       }
     }
+  }
 
-    Eigen::Map<Eigen::MatrixXd>(&U[N * P * q], N, P) = U_new;
+  return result;
+}
+
+// Out-of-sample assignment to the clusters of one slice of a smoothed U path: each
+// row of X is assigned to the nearest of the slice's centroids (see centroid_index.h),
+// in parallel over the rows. Returns the (1-based) cluster IDs and the distances to
+// the centroids. The slice index is 1-based.
+// [[Rcpp::export(rng = false)]]
+Rcpp::List centroid_path_assign(const Eigen::MatrixXd& centroids,
+                                const Eigen::VectorXi& offsets,
+                                int slice,
+                                const Eigen::MatrixXd& X){
+  if((slice < 1) || (slice >= offsets.size())){
+    ClustRVizLogger::error("Slice index out of range.");
   }
 
-  return U;
+  const int q = slice - 1;
+  const CentroidIndex index(centroids.middleRows(offsets(q), offsets(q + 1) - offsets(q)));
+
+  Eigen::VectorXi cluster;
+  Eigen::VectorXd distance;
+  index.assign(X, cluster, distance);
+
+  return Rcpp::List::create(Rcpp::Named("cluster")  = Eigen::VectorXi(cluster.array() + 1),
+                            Rcpp::Named("distance") = distance);
 }
 
 // Tensor projection along the second mode
@@ -199,9 +401,15 @@ Rcpp::NumericVector smooth_u_clustering(Rcpp::NumericVector U_old, Rcpp::List cl
 // want to get a projected array in R^{n-by-k-by-q} giving the path of the principal
 // components
 //
-// This is straightforward, but "loopy" so we implement it in Rcpp / RcppEigen for speed
+// Each slice of X is mapped in place (no copies) and multiplied by Y directly into
+// the corresponding slice of the result; slices are independent, so they are processed
+// in parallel. If slices (1-based) is non-empty, only those iterations are projected
+// (in the order given) -- e.g., for a single frame of a path movie. (To project onto
+// a subset of the components, pass only those columns of Y.)
 // [[Rcpp::export(rng = false)]]
-Rcpp::NumericVector tensor_projection(Rcpp::NumericVector X, const Eigen::MatrixXd& Y){
+Rcpp::NumericVector tensor_projection(Rcpp::NumericVector X,
+                                      const Eigen::MatrixXd& Y,
+                                      Rcpp::IntegerVector slices = Rcpp::IntegerVector::create()){
 
   // Validate X
   Rcpp::IntegerVector X_dims = X.attr("dim");
@@ -219,15 +427,54 @@ Rcpp::NumericVector tensor_projection(Rcpp::NumericVector X, const Eigen::Matrix
 
   int k = Y.cols();
 
-  Rcpp::NumericVector result(n * k * q);
-  Rcpp::IntegerVector result_dims{n, k, q};
+  // Which slices to project (zero-based)
+  std::vector<int> slice_ids;
+  if(slices.size() == 0){
+    for(int i = 0; i < q; i++){
+      slice_ids.push_back(i);
+    }
+  } else {
+    for(int s = 0; s < slices.size(); s++){
+      if((slices[s] < 1) || (slices[s] > q)){
+        ClustRVizLogger::error("Slice index out of range: ") << slices[s];
+      }
+      slice_ids.push_back(slices[s] - 1);
+    }
+  }
+  const int num_slices = slice_ids.size();
+
+  Rcpp::NumericVector result(n * k * num_slices);
+  Rcpp::IntegerVector result_dims{n, k, num_slices};
   result.attr("dim") = result_dims;
 
-  for(int i = 0; i < q; i++){
-    Eigen::MatrixXd X_slice = Eigen::Map<Eigen::MatrixXd>(&X[n * p * i], n, p);
-    Eigen::MatrixXd X_slice_projected = X_slice * Y;
-    Eigen::Map<Eigen::MatrixXd>(&result[n * k * i], n, k) = X_slice_projected;
+  const double* X_data = X.begin();
+  double* result_data  = result.begin();
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for(int s = 0; s < num_slices; s++){
+    Eigen::Map<const Eigen::MatrixXd> X_slice(X_data + static_cast<std::ptrdiff_t>(n) * p * slice_ids[s], n, p);
+    Eigen::Map<Eigen::MatrixXd> result_slice(result_data + static_cast<std::ptrdiff_t>(n) * k * s, n, k);
+    result_slice.noalias() = X_slice * Y;
   }
 
   return result;
 }
+
+// Group duplicate rows of X (or, with tol > 0, rows in the same grid cell of width
+// tol) -- see row_collapse.h
+//
+// [[Rcpp::export(rng = false)]]
+Rcpp::List collapse_duplicate_rows(const Eigen::MatrixXd& X, double tol = 0){
+  RowCollapse collapse = collapse_rows(X, tol);
+
+  // Convert to R's 1-based indexing
+  Eigen::VectorXi group     = collapse.group.array() + 1;
+  Eigen::VectorXi first_row = collapse.first_row.array() + 1;
+
+  return Rcpp::List::create(Rcpp::Named("X")            = collapse.X,
+                            Rcpp::Named("multiplicity") = collapse.multiplicity,
+                            Rcpp::Named("group")        = group,
+                            Rcpp::Named("first_row")    = first_row);
+}
@@ -0,0 +1,1023 @@
+#include "clustRviz_core.h"
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <random>
+
+// Sparse (kNN) RBF kernel weights
+//
+// Computes the same weights as sparse_rbf_kernel_weights() with Euclidean distances
+// -- w_ij = exp(-phi * ||x_i - x_j||^2), keeping only (symmetrized) k-nearest-neighbor
+// edges -- without ever forming the n-by-n distance or weight matrices:
+//
+//  - Squared distances are computed in blocks of rows as ||x_i||^2 + ||x_j||^2 - 2 X_b X^T,
+//    so the bulk of the work is a matrix product. Each row keeps a sorted list of its
+//    nearest candidates and the block is discarded.
+//  - If phi is to be chosen automatically, the variance of the weights over all pairs
+//    is accumulated for every phi on the grid in the same pass (Welford's algorithm,
+//    so each pair is visited once).
+//  - If k is to be chosen automatically, neighbor ranks are added to a union-find
+//    structure one at a time until the graph is connected.
+//
+// Weights on the final edges are computed from exact differences, rather than the
+// (cancellation-prone) expanded form used for neighbor selection.
+
+// Grid of phi values searched when phi = "auto" -- must match dense_rbf_kernel_weights()
+static const int RBF_PHI_GRID_SIZE = 21;
+
+static double rbf_phi_grid(int m){
+  return std::pow(10.0, m - 10);
+}
+
+// Running mean and variance (Welford's algorithm)
+struct RunningVariance {
+  double count;
+  double mean;
+  double m2;
+
+  RunningVariance(): count(0), mean(0), m2(0) {}
+
+  void push(double x){
+    count++;
+    double delta = x - mean;
+    mean += delta / count;
+    m2   += delta * (x - mean);
+  }
+
+  double variance() const {
+    return (count > 1) ? m2 / (count - 1) : 0;
+  }
+};
+
+// Union-find (with path halving) used to track connectivity as edges are added
+class DisjointSets {
+public:
+  DisjointSets(Eigen::Index n): parent(n), num_sets(n) {
+    std::iota(parent.begin(), parent.end(), 0);
+  }
+
+  Eigen::Index find(Eigen::Index i){
+    while(parent[i] != i){
+      parent[i] = parent[parent[i]];
+      i = parent[i];
+    }
+    return i;
+  }
+
+  void merge(Eigen::Index i, Eigen::Index j){
+    Eigen::Index root_i = find(i);
+    Eigen::Index root_j = find(j);
+    if(root_i != root_j){
+      parent[root_i] = root_j;
+      num_sets--;
+    }
+  }
+
+  bool is_connected() const {
+    return num_sets <= 1;
+  }
+
+private:
+  std::vector<Eigen::Index> parent;
+  Eigen::Index num_sets;
+};
+
+// Sort key (squared distance, or negated weight once phi is known) and index of a neighbor
+typedef std::pair<double, Eigen::Index> Neighbor;
+
+// For each row of X, find its max_neighbors nearest neighbors (sorted by increasing
+// distance) and the squared distance to its nearest neighbor among earlier rows.
+// If phi_variances is non-NULL, also accumulate the variance of the RBF weights
+// over all pairs for each phi on the grid.
+void knn_candidates(const Eigen::MatrixXd& X,
+                    Eigen::Index max_neighbors,
+                    std::vector<std::vector<Neighbor> >& neighbors,
+                    Eigen::VectorXd& min_lower_dist,
+                    std::vector<RunningVariance>* phi_variances){
+  const Eigen::Index n = X.rows();
+  const Eigen::VectorXd sq_norms = X.rowwise().squaredNorm();
+
+  neighbors.assign(n, std::vector<Neighbor>());
+  min_lower_dist.setConstant(n, std::numeric_limits<double>::infinity());
+
+  std::vector<Neighbor> row_dists;
+  row_dists.reserve(n);
+
+  for(Eigen::Index block_start = 0; block_start < n; block_start += CLUSTRVIZ_DISTANCE_BLOCK_SIZE){
+    const Eigen::Index block_rows = std::min<Eigen::Index>(CLUSTRVIZ_DISTANCE_BLOCK_SIZE, n - block_start);
+
+    Eigen::MatrixXd dists = -2 * X.middleRows(block_start, block_rows) * X.transpose();
+    dists.colwise() += sq_norms.segment(block_start, block_rows);
+    dists.rowwise() += sq_norms.transpose();
+
+    for(Eigen::Index b = 0; b < block_rows; b++){
+      const Eigen::Index i = block_start + b;
+      row_dists.clear();
+
+      for(Eigen::Index j = 0; j < n; j++){
+        if(j == i) continue;
+
+        const double d = std::max(dists(b, j), 0.0);
+        row_dists.push_back(Neighbor(d, j));
+
+        if(j < i){
+          min_lower_dist(i) = std::min(min_lower_dist(i), d);
+        } else if(phi_variances){
+          for(int m = 0; m < RBF_PHI_GRID_SIZE; m++){
+            (*phi_variances)[m].push(std::exp(-rbf_phi_grid(m) * d));
+          }
+        }
+      }
+
+      std::vector<Neighbor>::iterator last = row_dists.begin() + max_neighbors;
+      std::partial_sort(row_dists.begin(), last, row_dists.end());
+      neighbors[i].assign(row_dists.begin(), last);
+    }
+
+    if(!in_parallel_region() && clustRviz_hooks().check_interrupt){
+      clustRviz_hooks().check_interrupt();
+    }
+  }
+}
+
+// k <= 0 or phi <= 0 signal that the value should be chosen automatically
+KNNWeightGraph knn_rbf_graph(const Eigen::MatrixXd& X, int k, double phi){
+  const Eigen::Index n = X.rows();
+  const bool auto_k    = (k <= 0);
+  const bool auto_phi  = (phi <= 0);
+
+  if(n < 2){
+    ClustRVizLogger::error("At least two observations are required to compute clustering weights.");
+  }
+
+  if(k >= n){
+    ClustRVizLogger::error("k should be less than the size of the graph");
+  }
+
+  // Candidate lists: if k is known we need exactly k neighbors per row (plus ties,
+  // see below); otherwise start with a small number and grow if the graph is not
+  // yet connected when we run out of candidates
+  Eigen::Index max_neighbors = auto_k ? std::min<Eigen::Index>(n - 1, 8) : k;
+  std::vector<std::vector<Neighbor> > neighbors;
+  Eigen::VectorXd min_lower_dist;
+
+  std::vector<RunningVariance> phi_variances(RBF_PHI_GRID_SIZE);
+  knn_candidates(X, max_neighbors, neighbors, min_lower_dist, auto_phi ? &phi_variances : NULL);
+
+  if(auto_phi){
+    int best_m = 0;
+    for(int m = 1; m < RBF_PHI_GRID_SIZE; m++){
+      if(phi_variances[m].variance() > phi_variances[best_m].variance()){
+        best_m = m;
+      }
+    }
+    phi = rbf_phi_grid(best_m);
+  }
+
+  // Same check as check_weight_matrix(): every observation (after the first)
+  // must have a non-zero weight to an earlier observation
+  for(Eigen::Index i = 1; i < n; i++){
+    if(std::exp(-phi * min_lower_dist(i)) == 0){
+      ClustRVizLogger::error("No neighbor found for observation ") << i + 1 <<
+        " -- convex clustering cannot succeed. You may need to rescale your data.";
+    }
+  }
+
+  // Weights of each row's candidates, sorted in decreasing order (ties broken by index)
+  std::vector<std::vector<double> > candidate_weights(n);
+  auto compute_candidate_weights = [&](){
+    for(Eigen::Index i = 0; i < n; i++){
+      std::vector<Neighbor>& nbrs = neighbors[i];
+      for(std::size_t c = 0; c < nbrs.size(); c++){
+        nbrs[c].first = -std::exp(-phi * (X.row(i) - X.row(nbrs[c].second)).squaredNorm());
+      }
+      std::sort(nbrs.begin(), nbrs.end());
+
+      candidate_weights[i].resize(nbrs.size());
+      for(std::size_t c = 0; c < nbrs.size(); c++){
+        candidate_weights[i][c] = -nbrs[c].first;
+      }
+    }
+  };
+  compute_candidate_weights();
+
+  // Number of candidates of row i which are among its k nearest neighbors: as in
+  // take_k_neighbors(), this includes any neighbors tied with the k-th in weight.
+  // Returns -1 if that cannot be determined from the current candidate list.
+  auto num_in_neighborhood = [&](Eigen::Index i, Eigen::Index k) -> Eigen::Index {
+    const std::vector<double>& w = candidate_weights[i];
+    const Eigen::Index num_candidates = w.size();
+    if(num_candidates < k){
+      return -1;
+    }
+    Eigen::Index count = k;
+    while((count < num_candidates) && (w[count] >= w[k - 1])){
+      count++;
+    }
+    if((count == num_candidates) && (count < n - 1)){
+      return -1;
+    }
+    return count;
+  };
+
+  // Re-compute with more candidates (at most n - 1) per row
+  auto grow_candidates = [&](Eigen::Index num_candidates){
+    max_neighbors = std::min<Eigen::Index>(n - 1, num_candidates);
+    knn_candidates(X, max_neighbors, neighbors, min_lower_dist, NULL);
+    compute_candidate_weights();
+  };
+
+  if(auto_k){
+    // Add neighbors rank by rank until the graph is connected, as the R code
+    // tries k = 1, 2, ..., n - 1 in turn
+    while(true){
+      DisjointSets components(n);
+      std::vector<Eigen::Index> num_added(n, 0);
+      bool out_of_candidates = false;
+
+      for(k = 1; k < n; k++){
+        for(Eigen::Index i = 0; i < n; i++){
+          Eigen::Index num_neighbors = num_in_neighborhood(i, k);
+          if(num_neighbors < 0){
+            out_of_candidates = true;
+            break;
+          }
+          for(; num_added[i] < num_neighbors; num_added[i]++){
+            if(candidate_weights[i][num_added[i]] != 0){
+              components.merge(i, neighbors[i][num_added[i]].second);
+            }
+          }
+        }
+
+        if(out_of_candidates || components.is_connected()){
+          break;
+        }
+      }
+
+      if(!out_of_candidates){
+        break;
+      }
+
+      grow_candidates(2 * max_neighbors);
+    }
+
+    if(k >= n){
+      ClustRVizLogger::error("Cannot find k yielding fully connected graph.");
+    }
+  }
+
+  // Make sure ties with the k-th neighbor are all present in the candidate lists
+  for(Eigen::Index i = 0; i < n; i++){
+    if(num_in_neighborhood(i, k) < 0){
+      grow_candidates(n - 1);
+      break;
+    }
+  }
+
+  // Collect the (symmetrized) edges in lexicographic (i, j) order, as used to
+  // build the edge matrix D in CARP()
+  typedef std::pair<Eigen::Index, Eigen::Index> Edge;
+  std::vector<std::pair<Edge, double> > all_edges;
+  DisjointSets components(n);
+
+  for(Eigen::Index i = 0; i < n; i++){
+    const Eigen::Index num_neighbors = num_in_neighborhood(i, k);
+    for(Eigen::Index c = 0; c < num_neighbors; c++){
+      if(candidate_weights[i][c] != 0){
+        const Eigen::Index j = neighbors[i][c].second;
+        all_edges.push_back(std::make_pair(Edge(std::min(i, j), std::max(i, j)), candidate_weights[i][c]));
+        components.merge(i, j);
+      }
+    }
+  }
+
+  if(!components.is_connected()){
+    ClustRVizLogger::error("k = ") << k << " does not give a fully connected graph. Convex (bi)clustering will not converge.";
+  }
+
+  std::sort(all_edges.begin(), all_edges.end());
+
+  std::vector<Edge> edges;
+  std::vector<double> edge_weights;
+  for(std::size_t e = 0; e < all_edges.size(); e++){
+    if((e > 0) && (all_edges[e].first == all_edges[e - 1].first)){
+      continue;
+    }
+    edges.push_back(all_edges[e].first);
+    edge_weights.push_back(all_edges[e].second);
+  }
+
+  KNNWeightGraph graph;
+  graph.edge_list.resize(edges.size(), 2);
+  graph.weights.resize(edges.size());
+  graph.phi = phi;
+  graph.k   = k;
+
+  for(std::size_t e = 0; e < edges.size(); e++){
+    graph.edge_list(e, 0) = edges[e].first;
+    graph.edge_list(e, 1) = edges[e].second;
+    graph.weights(e)      = edge_weights[e];
+  }
+
+  return graph;
+}
+
+// Approximate kNN RBF weight graphs (NN-descent)
+//
+// For very large n even the blocked exact search above (O(n^2 p)) is too slow, so
+// approx_knn_rbf_graph() finds approximate k-nearest-neighbor lists by NN-descent
+// (Dong, Moses & Li, WWW 2011): starting from lists found in the leaves of a few
+// random projection trees (rows sharing a leaf are compared), each row's neighbors are
+// compared with each other ("a neighbor of my neighbor is likely my neighbor"),
+// using a sample of the not-yet-compared (new) entries and their reverse neighbors
+// in each round. The local joins run in parallel, with the resulting updates
+// applied by target row, so no locks are needed.
+//
+// The recall knob is checked directly: the exact neighbors of a fixed random sample
+// of rows are found up front, and the rounds stop once the estimated recall (the
+// fraction of the approximate neighbors of the sampled rows which are at least as
+// close as their k-th exact neighbor) reaches the target -- or once (almost) no
+// lists change, or after max_iter rounds.
+//
+// The (symmetrized) kNN graph may still have several components: these are bridged
+// with the fewest possible edges (one less than the number of components), along a
+// minimum spanning tree of the component centroids, each joining the pair of rows
+// found by a nearest-point search from one component towards the other.
+//
+// Weights are RBF weights on the exact distances of the final edges; phi = "auto"
+// uses the same grid and criterion as knn_rbf_graph(), over a random sample of pairs.
+
+// Rows of the sample used to estimate recall, and of pairs used to choose phi
+static const Eigen::Index APPROX_KNN_RECALL_SAMPLE = 100;
+static const Eigen::Index APPROX_KNN_PHI_SAMPLE    = 200000;
+
+// Stop once fewer than this fraction of the n * k list entries change in a round
+static const double APPROX_KNN_MIN_UPDATES = 0.001;
+
+// Largest candidate sample (relative to k) used to push recall towards the target
+static const Eigen::Index APPROX_KNN_MAX_CANDIDATES = 4;
+
+// Random projection trees used for the initial lists, and their smallest leaf size
+// (leaves have at least 2k rows)
+static const int APPROX_KNN_RP_TREES = 8;
+static const Eigen::Index APPROX_KNN_MIN_LEAF_SIZE = 10;
+
+// Fixed-size max-heaps of (squared distance, index) for each row, with a flag for
+// entries not yet used in a local join
+class NeighborHeaps {
+public:
+  NeighborHeaps(Eigen::Index n, int k):
+    k(k),
+    indices(n * k, -1),
+    distances(n * k, std::numeric_limits<double>::infinity()),
+    is_new(n * k, 0) {}
+
+  double worst(Eigen::Index i) const {
+    return distances[i * k];
+  }
+
+  Eigen::Index index(Eigen::Index i, int c) const {
+    return indices[i * k + c];
+  }
+
+  double distance(Eigen::Index i, int c) const {
+    return distances[i * k + c];
+  }
+
+  char& flag(Eigen::Index i, int c){
+    return is_new[i * k + c];
+  }
+
+  // Add j to the list of i if it is closer than the current worst (and not already
+  // present); returns true if the list changed
+  bool push(Eigen::Index i, Eigen::Index j, double d){
+    const std::size_t base = i * k;
+    if(d >= distances[base]){
+      return false;
+    }
+    for(int c = 0; c < k; c++){
+      if(indices[base + c] == j){
+        return false;
+      }
+    }
+
+    // Replace the root and sift down
+    std::size_t c = 0;
+    while(true){
+      const std::size_t left = 2 * c + 1, right = left + 1;
+      std::size_t largest = c;
+      double largest_d = d;
+      if((left < static_cast<std::size_t>(k)) && (distances[base + left] > largest_d)){
+        largest = left;
+        largest_d = distances[base + left];
+      }
+      if((right < static_cast<std::size_t>(k)) && (distances[base + right] > largest_d)){
+        largest = right;
+      }
+      if(largest == c){
+        break;
+      }
+      distances[base + c] = distances[base + largest];
+      indices[base + c]   = indices[base + largest];
+      is_new[base + c]    = is_new[base + largest];
+      c = largest;
+    }
+    distances[base + c] = d;
+    indices[base + c]   = j;
+    is_new[base + c]    = 1;
+    return true;
+  }
+
+private:
+  const int k;
+  std::vector<Eigen::Index> indices;
+  std::vector<double> distances;
+  std::vector<char> is_new;
+};
+
+struct NeighborUpdate {
+  Eigen::Index i;
+  Eigen::Index j;
+  double d;
+};
+
+static inline double squared_distance(const Eigen::MatrixXd& Xt, Eigen::Index i, Eigen::Index j){
+  return (Xt.col(i) - Xt.col(j)).squaredNorm();
+}
+
+// Exact squared distance to the k-th nearest neighbor of each sampled row
+static Eigen::VectorXd sample_kth_distances(const Eigen::MatrixXd& Xt,
+                                            const std::vector<Eigen::Index>& sample,
+                                            int k){
+  const Eigen::Index n = Xt.cols();
+  const Eigen::Index num_sampled = sample.size();
+  Eigen::VectorXd kth(num_sampled);
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+  for(Eigen::Index s = 0; s < num_sampled; s++){
+    const Eigen::Index i = sample[s];
+    std::vector<double> dists;
+    dists.reserve(n - 1);
+    for(Eigen::Index j = 0; j < n; j++){
+      if(j != i){
+        dists.push_back(squared_distance(Xt, i, j));
+      }
+    }
+    std::nth_element(dists.begin(), dists.begin() + (k - 1), dists.end());
+    kth(s) = dists[k - 1];
+  }
+
+  return kth;
+}
+
+static double estimated_recall(const NeighborHeaps& heaps,
+                               const std::vector<Eigen::Index>& sample,
+                               const Eigen::VectorXd& kth,
+                               int k){
+  Eigen::Index found = 0;
+  for(std::size_t s = 0; s < sample.size(); s++){
+    for(int c = 0; c < k; c++){
+      found += (heaps.distance(sample[s], c) <= kth(s));
+    }
+  }
+  return static_cast<double>(found) / (sample.size() * k);
+}
+
+// Random projection tree: rows are split recursively by the hyperplane halfway
+// between two random rows, until at most leaf_size remain. The leaves are returned
+// as [begin, end) ranges of `rows`
+static void rp_tree_leaves(const Eigen::MatrixXd& Xt,
+                           Eigen::Index leaf_size,
+                           unsigned int seed,
+                           std::vector<Eigen::Index>& rows,
+                           std::vector<std::pair<Eigen::Index, Eigen::Index> >& leaves){
+  const Eigen::Index n = Xt.cols();
+  std::mt19937 rng(seed);
+  rows.resize(n);
+  std::iota(rows.begin(), rows.end(), 0);
+  leaves.clear();
+
+  std::vector<std::pair<Eigen::Index, Eigen::Index> > stack(1, std::make_pair(Eigen::Index(0), n));
+  while(!stack.empty()){
+    const Eigen::Index begin = stack.back().first, end = stack.back().second;
+    stack.pop_back();
+    if(end - begin <= leaf_size){
+      leaves.push_back(std::make_pair(begin, end));
+      continue;
+    }
+
+    std::uniform_int_distribution<Eigen::Index> pick(begin, end - 2);
+    const Eigen::Index a = rows[pick(rng)];
+    Eigen::Index b = rows[pick(rng)];
+    if(b == a){
+      b = rows[end - 1];
+    }
+    const Eigen::VectorXd normal = Xt.col(a) - Xt.col(b);
+    const double offset = 0.5 * normal.dot(Xt.col(a) + Xt.col(b));
+
+    Eigen::Index middle = std::partition(rows.begin() + begin, rows.begin() + end,
+                                         [&](Eigen::Index i){ return normal.dot(Xt.col(i)) < offset; }) - rows.begin();
+    if((middle == begin) || (middle == end)){
+      middle = begin + (end - begin) / 2; // Tied rows: split arbitrarily
+    }
+    stack.push_back(std::make_pair(begin, middle));
+    stack.push_back(std::make_pair(middle, end));
+  }
+}
+
+// NN-descent: returns the number of rounds used
+static int nn_descent(const Eigen::MatrixXd& Xt,
+                      int k,
+                      double target_recall,
+                      int max_iter,
+                      std::mt19937& rng,
+                      NeighborHeaps& heaps,
+                      double& recall){
+  const Eigen::Index n = Xt.cols();
+
+  // Initial lists from the leaves of a random projection forest; rows left with
+  // gaps (only possible after degenerate splits) are filled at random
+  const Eigen::Index leaf_size = std::max<Eigen::Index>(2 * k, APPROX_KNN_MIN_LEAF_SIZE);
+  std::vector<std::vector<Eigen::Index> > forest(APPROX_KNN_RP_TREES);
+  std::vector<std::vector<std::pair<Eigen::Index, Eigen::Index> > > forest_leaves(APPROX_KNN_RP_TREES);
+  std::vector<unsigned int> tree_seeds(APPROX_KNN_RP_TREES);
+  for(int t = 0; t < APPROX_KNN_RP_TREES; t++){
+    tree_seeds[t] = rng();
+  }
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+  for(int t = 0; t < APPROX_KNN_RP_TREES; t++){
+    rp_tree_leaves(Xt, leaf_size, tree_seeds[t], forest[t], forest_leaves[t]);
+  }
+  for(int t = 0; t < APPROX_KNN_RP_TREES; t++){
+    // The leaves of a tree are disjoint, so can be joined in parallel
+    const std::vector<Eigen::Index>& rows = forest[t];
+    const std::vector<std::pair<Eigen::Index, Eigen::Index> >& leaves = forest_leaves[t];
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 64)
+#endif
+    for(std::size_t l = 0; l < leaves.size(); l++){
+      for(Eigen::Index a = leaves[l].first; a < leaves[l].second; a++){
+        for(Eigen::Index b = a + 1; b < leaves[l].second; b++){
+          const double d = squared_distance(Xt, rows[a], rows[b]);
+          heaps.push(rows[a], rows[b], d);
+          heaps.push(rows[b], rows[a], d);
+        }
+      }
+    }
+  }
+  for(Eigen::Index i = 0; i < n; i++){
+    std::uniform_int_distribution<Eigen::Index> random_row(0, n - 2);
+    for(int tries = 0; (tries < k) && (heaps.worst(i) == std::numeric_limits<double>::infinity()); tries++){
+      Eigen::Index j = random_row(rng);
+      j += (j >= i); // Skip i itself
+      heaps.push(i, j, squared_distance(Xt, i, j));
+    }
+    // (At most n - 1 candidates, so this ends even if distances are not finite)
+    for(Eigen::Index step = 1; (step < n) && (heaps.worst(i) == std::numeric_limits<double>::infinity()); step++){
+      const Eigen::Index j = (i + step) % n;
+      heaps.push(i, j, squared_distance(Xt, i, j));
+    }
+  }
+
+  // Rows used to estimate recall, and their exact k-th neighbor distances
+  std::vector<Eigen::Index> sample;
+  const Eigen::Index num_sampled = std::min<Eigen::Index>(n, APPROX_KNN_RECALL_SAMPLE);
+  {
+    std::vector<Eigen::Index> rows(n);
+    std::iota(rows.begin(), rows.end(), 0);
+    for(Eigen::Index s = 0; s < num_sampled; s++){
+      std::uniform_int_distribution<Eigen::Index> pick(s, n - 1);
+      std::swap(rows[s], rows[pick(rng)]);
+    }
+    sample.assign(rows.begin(), rows.begin() + num_sampled);
+  }
+  const Eigen::VectorXd kth = sample_kth_distances(Xt, sample, k);
+
+  int num_threads = 1;
+#ifdef _OPENMP
+  num_threads = omp_get_max_threads();
+#endif
+
+  std::vector<std::vector<Eigen::Index> > new_candidates(n), old_candidates(n);
+  std::vector<std::vector<NeighborUpdate> > updates(num_threads);
+  std::uniform_real_distribution<double> uniform(0, 1);
+
+  // Candidates sampled per list (and reverse list) and round: if the lists stop
+  // changing short of the target recall, this is doubled and every entry is joined
+  // again, up to APPROX_KNN_MAX_CANDIDATES times k
+  Eigen::Index max_candidates = k;
+
+  recall = estimated_recall(heaps, sample, kth, k);
+  int iter = 0;
+  while((iter < max_iter) && (recall < target_recall)){
+    iter++;
+
+    // Candidates: (a sample of) the new and old entries of each list, and the rows
+    // listing it (reverse neighbors), at most k of each
+    for(Eigen::Index i = 0; i < n; i++){
+      new_candidates[i].clear();
+      old_candidates[i].clear();
+    }
+    auto add_candidate = [&](std::vector<Eigen::Index>& candidates, Eigen::Index j, Eigen::Index& seen) -> void {
+      // Reservoir sampling, so every candidate is kept with equal probability
+      seen++;
+      if(static_cast<Eigen::Index>(candidates.size()) < max_candidates){
+        candidates.push_back(j);
+      } else {
+        const Eigen::Index slot = static_cast<Eigen::Index>(uniform(rng) * seen);
+        if(slot < max_candidates){
+          candidates[slot] = j;
+        }
+      }
+    };
+    std::vector<Eigen::Index> new_seen(n, 0), old_seen(n, 0);
+    for(Eigen::Index i = 0; i < n; i++){
+      for(int c = 0; c < k; c++){
+        const Eigen::Index j = heaps.index(i, c);
+        if(heaps.flag(i, c)){
+          add_candidate(new_candidates[i], j, new_seen[i]);
+          add_candidate(new_candidates[j], i, new_seen[j]);
+        } else {
+          add_candidate(old_candidates[i], j, old_seen[i]);
+          add_candidate(old_candidates[j], i, old_seen[j]);
+        }
+      }
+    }
+    // Entries sampled as new candidates are joined this round
+    for(Eigen::Index i = 0; i < n; i++){
+      for(int c = 0; c < k; c++){
+        if(heaps.flag(i, c) &&
+           (std::find(new_candidates[i].begin(), new_candidates[i].end(), heaps.index(i, c)) != new_candidates[i].end())){
+          heaps.flag(i, c) = 0;
+        }
+      }
+    }
+
+    // Local joins (in parallel), keeping pairs which might improve either list
+    // (compared to the lists at the start of the round). OpenMP may give us fewer
+    // threads than requested, so all lists are cleared up front
+    for(int t = 0; t < num_threads; t++){
+      updates[t].clear();
+    }
+#ifdef _OPENMP
+#pragma omp parallel num_threads(num_threads)
+#endif
+    {
+      int thread = 0;
+#ifdef _OPENMP
+      thread = omp_get_thread_num();
+#endif
+      std::vector<NeighborUpdate>& thread_updates = updates[thread];
+
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 256)
+#endif
+      for(Eigen::Index i = 0; i < n; i++){
+        const std::vector<Eigen::Index>& new_i = new_candidates[i];
+        const std::vector<Eigen::Index>& old_i = old_candidates[i];
+        for(std::size_t a = 0; a < new_i.size(); a++){
+          const Eigen::Index u = new_i[a];
+          for(std::size_t b = a + 1; b < new_i.size() + old_i.size(); b++){
+            const Eigen::Index v = (b < new_i.size()) ? new_i[b] : old_i[b - new_i.size()];
+            if(u == v){
+              continue;
+            }
+            const double d = squared_distance(Xt, u, v);
+            if((d < heaps.worst(u)) || (d < heaps.worst(v))){
+              NeighborUpdate update = {u, v, d};
+              thread_updates.push_back(update);
+            }
+          }
+        }
+      }
+    }
+
+    // Apply the updates, each thread taking the rows i with i % team_size == thread
+    // (team_size is the number of threads we actually got, which may be fewer than
+    // requested)
+    long long num_changed = 0;
+#ifdef _OPENMP
+#pragma omp parallel num_threads(num_threads) reduction(+:num_changed)
+#endif
+    {
+      int thread = 0, team_size = 1;
+#ifdef _OPENMP
+      thread    = omp_get_thread_num();
+      team_size = omp_get_num_threads();
+#endif
+      for(int t = 0; t < num_threads; t++){
+        for(std::size_t m = 0; m < updates[t].size(); m++){
+          const NeighborUpdate& update = updates[t][m];
+          if(update.i % team_size == thread){
+            num_changed += heaps.push(update.i, update.j, update.d);
+          }
+          if(update.j % team_size == thread){
+            num_changed += heaps.push(update.j, update.i, update.d);
+          }
+        }
+      }
+    }
+
+    recall = estimated_recall(heaps, sample, kth, k);
+
+    if(!in_parallel_region() && clustRviz_hooks().check_interrupt){
+      clustRviz_hooks().check_interrupt();
+    }
+
+    if(num_changed <= APPROX_KNN_MIN_UPDATES * n * k){
+      if(max_candidates >= APPROX_KNN_MAX_CANDIDATES * k){
+        break;
+      }
+      max_candidates *= 2;
+      for(Eigen::Index i = 0; i < n; i++){
+        for(int c = 0; c < k; c++){
+          heaps.flag(i, c) = 1;
+        }
+      }
+    }
+  }
+
+  return iter;
+}
+
+// Bridge the components of a graph (given by its union-find structure) with one
+// edge per tree edge of the minimum spanning tree of the component centroids
+static std::vector<std::pair<Eigen::Index, Eigen::Index> > bridge_components(const Eigen::MatrixXd& Xt,
+                                                                             DisjointSets& components){
+  const Eigen::Index n = Xt.cols();
+  const Eigen::Index p = Xt.rows();
+
+  // Component labels, sizes and centroids
+  std::vector<Eigen::Index> label(n, -1), root_label(n, -1);
+  Eigen::Index num_components = 0;
+  for(Eigen::Index i = 0; i < n; i++){
+    const Eigen::Index root = components.find(i);
+    if(root_label[root] == -1){
+      root_label[root] = num_components++;
+    }
+    label[i] = root_label[root];
+  }
+
+  std::vector<std::pair<Eigen::Index, Eigen::Index> > bridges;
+  if(num_components <= 1){
+    return bridges;
+  }
+
+  Eigen::MatrixXd centroids = Eigen::MatrixXd::Zero(p, num_components);
+  Eigen::VectorXd sizes = Eigen::VectorXd::Zero(num_components);
+  for(Eigen::Index i = 0; i < n; i++){
+    centroids.col(label[i]) += Xt.col(i);
+    sizes(label[i]) += 1;
+  }
+  for(Eigen::Index c = 0; c < num_components; c++){
+    centroids.col(c) /= sizes(c);
+  }
+
+  // Prim's algorithm on the (dense) centroid graph
+  std::vector<bool> in_tree(num_components, false);
+  std::vector<double> best(num_components, std::numeric_limits<double>::infinity());
+  std::vector<Eigen::Index> best_from(num_components, -1);
+  best[0] = 0;
+  for(Eigen::Index step = 0; step < num_components; step++){
+    Eigen::Index next = -1;
+    for(Eigen::Index c = 0; c < num_components; c++){
+      if(!in_tree[c] && ((next == -1) || (best[c] < best[next]))){
+        next = c;
+      }
+    }
+    in_tree[next] = true;
+    for(Eigen::Index c = 0; c < num_components; c++){
+      if(!in_tree[c]){
+        const double d = (centroids.col(c) - centroids.col(next)).squaredNorm();
+        if(d < best[c]){
+          best[c]      = d;
+          best_from[c] = next;
+        }
+      }
+    }
+
+    if(best_from[next] == -1){
+      continue;
+    }
+
+    // Row of this component closest to the other centroid, then the row of the
+    // other component closest to that
+    const Eigen::Index from = best_from[next];
+    auto closest_in = [&](Eigen::Index component, const Eigen::VectorXd& target) -> Eigen::Index {
+      Eigen::Index closest = -1;
+      double closest_d = std::numeric_limits<double>::infinity();
+      for(Eigen::Index i = 0; i < n; i++){
+        if(label[i] == component){
+          const double d = (Xt.col(i) - target).squaredNorm();
+          if(d < closest_d){
+            closest   = i;
+            closest_d = d;
+          }
+        }
+      }
+      return closest;
+    };
+    const Eigen::Index a = closest_in(next, centroids.col(from));
+    const Eigen::Index b = closest_in(from, Xt.col(a));
+    bridges.push_back(std::make_pair(std::min(a, b), std::max(a, b)));
+    components.merge(a, b);
+  }
+
+  return bridges;
+}
+
+// phi <= 0 signals that phi should be chosen automatically
+KNNWeightGraph approx_knn_rbf_graph(const Eigen::MatrixXd& X,
+                                    int k,
+                                    double phi,
+                                    double target_recall,
+                                    int max_iter,
+                                    unsigned int seed,
+                                    ApproxKNNStats* stats){
+  const auto tic = std::chrono::steady_clock::now();
+
+  const Eigen::Index n = X.rows();
+  if(n < 2){
+    ClustRVizLogger::error("At least two observations are required to compute clustering weights.");
+  }
+  if((k <= 0) || (k >= n)){
+    ClustRVizLogger::error("k should be positive and less than the size of the graph");
+  }
+  if(!X.allFinite()){
+    ClustRVizLogger::error("All elements of X must be finite to compute clustering weights.");
+  }
+
+  const Eigen::MatrixXd Xt = X.transpose(); // Rows of X as contiguous columns
+  std::mt19937 rng(seed);
+
+  NeighborHeaps heaps(n, k);
+  double recall;
+  const int iterations = nn_descent(Xt, k, target_recall, max_iter, rng, heaps, recall);
+
+  if(phi <= 0){
+    std::vector<RunningVariance> phi_variances(RBF_PHI_GRID_SIZE);
+    std::uniform_int_distribution<Eigen::Index> random_row(0, n - 1);
+    const Eigen::Index num_pairs = std::min<double>(APPROX_KNN_PHI_SAMPLE, 0.5 * n * (n - 1));
+    for(Eigen::Index m = 0; m < num_pairs; m++){
+      const Eigen::Index i = random_row(rng);
+      Eigen::Index j = random_row(rng);
+      if(i == j){
+        j = (j + 1) % n;
+      }
+      const double d = squared_distance(Xt, i, j);
+      for(int g = 0; g < RBF_PHI_GRID_SIZE; g++){
+        phi_variances[g].push(std::exp(-rbf_phi_grid(g) * d));
+      }
+    }
+
+    int best_g = 0;
+    for(int g = 1; g < RBF_PHI_GRID_SIZE; g++){
+      if(phi_variances[g].variance() > phi_variances[best_g].variance()){
+        best_g = g;
+      }
+    }
+    phi = rbf_phi_grid(best_g);
+  }
+
+  // Symmetrized edges with non-zero weights, then bridges between any components
+  typedef std::pair<Eigen::Index, Eigen::Index> Edge;
+  std::vector<Edge> edges;
+  edges.reserve(n * k);
+  DisjointSets components(n);
+  for(Eigen::Index i = 0; i < n; i++){
+    for(int c = 0; c < k; c++){
+      const Eigen::Index j = heaps.index(i, c);
+      if(std::exp(-phi * heaps.distance(i, c)) != 0){
+        edges.push_back(Edge(std::min(i, j), std::max(i, j)));
+        components.merge(i, j);
+      }
+    }
+  }
+
+  Eigen::Index num_components = 0;
+  for(Eigen::Index i = 0; i < n; i++){
+    num_components += (components.find(i) == i);
+  }
+
+  const std::vector<Edge> bridges = bridge_components(Xt, components);
+  edges.insert(edges.end(), bridges.begin(), bridges.end());
+
+  std::sort(edges.begin(), edges.end());
+  edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+  KNNWeightGraph graph;
+  graph.edge_list.resize(edges.size(), 2);
+  graph.weights.resize(edges.size());
+  graph.phi = phi;
+  graph.k   = k;
+
+  for(std::size_t e = 0; e < edges.size(); e++){
+    graph.edge_list(e, 0) = edges[e].first;
+    graph.edge_list(e, 1) = edges[e].second;
+    graph.weights(e)      = std::exp(-phi * (X.row(edges[e].first) - X.row(edges[e].second)).squaredNorm());
+    if(graph.weights(e) == 0){
+      ClustRVizLogger::error("Components of the approximate kNN graph are too far apart to be connected with "
+                             "non-zero weights -- convex clustering cannot succeed. You may need to rescale your data.");
+    }
+  }
+
+  if(stats){
+    stats->seconds        = std::chrono::duration<double>(std::chrono::steady_clock::now() - tic).count();
+    stats->iterations     = iterations;
+    stats->recall         = recall;
+    stats->num_components = num_components;
+    stats->num_bridges    = bridges.size();
+  }
+
+  return graph;
+}
+
+// Edge lists from weight matrices
+//
+// The edges of the graph implied by a (symmetric) weight matrix are the non-zero
+// entries (i, j) of its upper triangle, ordered lexicographically in (i, j). This
+// is the order used for the rows of the edge matrix D, the weight vector and the
+// fusion indicators everywhere else.
+//
+// Entries are found column by column (contiguous for both dense and compressed
+// sparse storage), giving edges ordered by j, and then bucketed by i.
+static void bucket_edges_by_row(Eigen::Index n,
+                                const std::vector<Eigen::Index>& edge_rows,
+                                const std::vector<Eigen::Index>& edge_cols,
+                                const std::vector<double>& edge_weights,
+                                Eigen::MatrixXi& edge_list,
+                                Eigen::VectorXd& weights){
+  const Eigen::Index num_edges = edge_rows.size();
+
+  std::vector<Eigen::Index> row_starts(n + 1, 0);
+  for(Eigen::Index e = 0; e < num_edges; e++){
+    row_starts[edge_rows[e] + 1]++;
+  }
+  std::partial_sum(row_starts.begin(), row_starts.end(), row_starts.begin());
+
+  edge_list.resize(num_edges, 2);
+  weights.resize(num_edges);
+
+  for(Eigen::Index e = 0; e < num_edges; e++){
+    const Eigen::Index position = row_starts[edge_rows[e]]++;
+    edge_list(position, 0) = edge_rows[e];
+    edge_list(position, 1) = edge_cols[e];
+    weights(position)      = edge_weights[e];
+  }
+}
+
+void weight_matrix_edges(const Eigen::MatrixXd& weight_matrix,
+                         Eigen::MatrixXi& edge_list,
+                         Eigen::VectorXd& weights){
+  const Eigen::Index n = weight_matrix.rows();
+
+  std::vector<Eigen::Index> edge_rows, edge_cols;
+  std::vector<double> edge_weights;
+
+  for(Eigen::Index j = 1; j < n; j++){
+    for(Eigen::Index i = 0; i < j; i++){
+      const double w = weight_matrix(i, j);
+      if(w != 0){
+        edge_rows.push_back(i);
+        edge_cols.push_back(j);
+        edge_weights.push_back(w);
+      }
+    }
+  }
+
+  bucket_edges_by_row(n, edge_rows, edge_cols, edge_weights, edge_list, weights);
+}
+
+void sparse_weight_matrix_edges(const Eigen::SparseMatrix<double>& weight_matrix,
+                                Eigen::MatrixXi& edge_list,
+                                Eigen::VectorXd& weights){
+  const Eigen::Index n = weight_matrix.rows();
+
+  std::vector<Eigen::Index> edge_rows, edge_cols;
+  std::vector<double> edge_weights;
+
+  for(Eigen::Index j = 0; j < n; j++){
+    for(Eigen::SparseMatrix<double>::InnerIterator it(weight_matrix, j); it && (it.row() < j); ++it){
+      if(it.value() != 0){
+        edge_rows.push_back(it.row());
+        edge_cols.push_back(j);
+        edge_weights.push_back(it.value());
+      }
+    }
+  }
+
+  bucket_edges_by_row(n, edge_rows, edge_cols, edge_weights, edge_list, weights);
+}
+
+// Check that the edges (zero-based) connect all n vertices
+bool edge_list_is_connected(const Eigen::MatrixXi& edge_list, Eigen::Index n){
+  DisjointSets components(n);
+  for(Eigen::Index e = 0; e < edge_list.rows(); e++){
+    components.merge(edge_list(e, 0), edge_list(e, 1));
+  }
+  return components.is_connected();
+}
@@ -0,0 +1,83 @@
+#include "clustRviz.h"
+
+// R interface to the weight graph constructors in weight_graphs.cpp
+
+// [[Rcpp::export(rng = false)]]
+Rcpp::List knn_rbf_weights(const Eigen::MatrixXd& X,
+                           int k      = 0,
+                           double phi = 0){
+  KNNWeightGraph graph = knn_rbf_graph(X, k, phi);
+
+  // Convert to R's 1-based indexing
+  Eigen::MatrixXi edge_list = graph.edge_list.array() + 1;
+
+  return Rcpp::List::create(Rcpp::Named("edge_list") = edge_list,
+                            Rcpp::Named("weights")   = graph.weights,
+                            Rcpp::Named("phi")       = graph.phi,
+                            Rcpp::Named("k")         = graph.k);
+}
+
+// [[Rcpp::export(rng = false)]]
+Rcpp::List approx_knn_rbf_weights(const Eigen::MatrixXd& X,
+                                  int k,
+                                  double phi    = 0,
+                                  double recall = 0.9,
+                                  int max_iter  = 50,
+                                  int seed      = 0){
+  ApproxKNNStats stats;
+  KNNWeightGraph graph = approx_knn_rbf_graph(X, k, phi, recall, max_iter,
+                                              static_cast<unsigned int>(seed), &stats);
+
+  // Convert to R's 1-based indexing
+  Eigen::MatrixXi edge_list = graph.edge_list.array() + 1;
+
+  return Rcpp::List::create(Rcpp::Named("edge_list") = edge_list,
+                            Rcpp::Named("weights")   = graph.weights,
+                            Rcpp::Named("phi")       = graph.phi,
+                            Rcpp::Named("k")         = graph.k,
+                            Rcpp::Named("stats")     = Rcpp::List::create(
+                              Rcpp::Named("seconds")        = stats.seconds,
+                              Rcpp::Named("iterations")     = stats.iterations,
+                              Rcpp::Named("recall")         = stats.recall,
+                              Rcpp::Named("num_components") = static_cast<double>(stats.num_components),
+                              Rcpp::Named("num_bridges")    = static_cast<double>(stats.num_bridges)));
+}
+
+// [[Rcpp::export(rng = false)]]
+Rcpp::List dense_weight_edges(const Eigen::MatrixXd& weight_matrix){
+  if(weight_matrix.rows() != weight_matrix.cols()){
+    ClustRVizLogger::error("Clustering weight matrix is not square.");
+  }
+
+  Eigen::MatrixXi edge_list;
+  Eigen::VectorXd weights;
+  weight_matrix_edges(weight_matrix, edge_list, weights);
+
+  // Convert to R's 1-based indexing
+  Eigen::MatrixXi r_edge_list = edge_list.array() + 1;
+
+  return Rcpp::List::create(Rcpp::Named("edge_list")  = r_edge_list,
+                            Rcpp::Named("weight_vec") = weights);
+}
+
+// [[Rcpp::export(rng = false)]]
+Rcpp::List sparse_weight_edges(const Eigen::SparseMatrix<double>& weight_matrix){
+  if(weight_matrix.rows() != weight_matrix.cols()){
+    ClustRVizLogger::error("Clustering weight matrix is not square.");
+  }
+
+  Eigen::MatrixXi edge_list;
+  Eigen::VectorXd weights;
+  sparse_weight_matrix_edges(weight_matrix, edge_list, weights);
+
+  // Convert to R's 1-based indexing
+  Eigen::MatrixXi r_edge_list = edge_list.array() + 1;
+
+  return Rcpp::List::create(Rcpp::Named("edge_list")  = r_edge_list,
+                            Rcpp::Named("weight_vec") = weights);
+}
+
+// [[Rcpp::export(rng = false)]]
+bool is_connected_edge_list(const Eigen::MatrixXi& edge_list, int n){
+  return edge_list_is_connected(from_r_edge_list(edge_list), n);
+}